@@ -55,6 +55,11 @@
 #define GOL_DEFAULT_TIME_STEP   0.001f
 #define GOL_DEFAULT_UPDATE_CAP  0.2f
 #define GOL_RESIZE_TIME_LIMIT   0.2f
+#define GOL_TURBO_STEP_BUDGET   0.014f
+#define GOL_DEFAULT_SOUP_DENSITY 0.43f
+#define GOL_SOUP_DENSITY_STEP   0.05f
+#define GOL_CYCLE_SKIP_PER_SEC  1000000.0f
+#define GOL_CYCLE_PUBLISH_TIME  0.033f
 
 typedef uint_fast8_t u8;
 typedef int_fast8_t i8;
@@ -0,0 +1,89 @@
+#ifndef GOL_BENCH_C_
+#define GOL_BENCH_C_
+
+//! `MultiSim --bench [width] [height]` measures the bit-packed kernel without opening a window:
+//! generations per second against the generations per pass of temporal blocking, on a grid
+//! much larger than the caches. Like every universe, the size is rounded up to a multiple of
+//! GOL_SCALE, so the default 32768 x 32768 runs as 32774 x 32774, 256 MiB with both buffers.
+//! Every pass length is checked to end up with the same cells as stepping one at a time.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "universe.c"
+
+#define GOL_BENCH_DEFAULT_SIZE 32768
+#define GOL_BENCH_GENERATIONS 32
+#define GOL_BENCH_SEED 20240601
+
+static const size_t GOL_BENCH_PASSES[] = { 1, 2, 4, 8, 16 };
+#define GOL_BENCH_PASSES_COUNT (sizeof(GOL_BENCH_PASSES) / sizeof(GOL_BENCH_PASSES[0]))
+
+static double gol_bench_now(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+/// A bit-packed soup, without ever allocating the byte buffers of a grid this large.
+static Universe gol_bench_universe(size_t width, size_t height) {
+    Universe uvs = universe_new(GOL_SCALE, GOL_SCALE);
+    universe_set_backend(&uvs, UniverseBackend_Packed);
+    universe_resize(&uvs, width, height);
+    universe_set_threads(&uvs, gol_pool_hardware_threads());
+    uvs.edge = UniverseEdge_Wrap;
+    uvs.counting = false;
+    universe_fill_random(&uvs, GOL_BENCH_SEED, GOL_DEFAULT_SOUP_DENSITY);
+    return uvs;
+}
+
+int gol_bench(int argc, char** argv) {
+    size_t width = (argc > 0) ? strtoull(argv[0], NULL, 10) : GOL_BENCH_DEFAULT_SIZE;
+    size_t height = (argc > 1) ? strtoull(argv[1], NULL, 10) : width;
+    if (width == 0 || height == 0) {
+        fprintf(stderr, "usage: --bench [width] [height], rounded up to a multiple of %d\n", GOL_SCALE);
+        return 1;
+    }
+
+    Universe uvs = gol_bench_universe(width, height);
+    if (paniced) {
+        fprintf(stderr, "%s\n", panic_msg);
+        return 1;
+    }
+    printf(
+        "%zu x %zu cells (asked for %zu x %zu), %zu MiB with both buffers, %zu threads, %d generations each\n",
+        uvs.width, uvs.height, width, height,
+        (uvs.packed.stride * (uvs.packed.capacity_height + 2) * 2 * sizeof(uint64_t)) >> 20,
+        universe_threads(&uvs), GOL_BENCH_GENERATIONS
+    );
+    printf("%-8s %12s %14s %10s %8s\n", "k", "gen/s", "Mcells/s", "speedup", "cells");
+
+    uint64_t expected = 0;
+    double baseline = 0.0;
+    for (size_t p = 0; p < GOL_BENCH_PASSES_COUNT; p++) {
+        const size_t k = GOL_BENCH_PASSES[p];
+        universe_fill_random(&uvs, GOL_BENCH_SEED, GOL_DEFAULT_SOUP_DENSITY);
+
+        double start = gol_bench_now();
+        for (size_t gens = 0; gens < GOL_BENCH_GENERATIONS; gens += k) universe_update_generations(&uvs, k);
+        double gens_per_sec = GOL_BENCH_GENERATIONS / (gol_bench_now() - start);
+
+        uint64_t hash = universe_hash(&uvs);
+        if (p == 0) {
+            expected = hash;
+            baseline = gens_per_sec;
+        }
+        printf(
+            "%-8zu %12.2f %14.0f %9.2fx %8s\n",
+            k, gens_per_sec, gens_per_sec * (double)(uvs.size) / 1e6, gens_per_sec / baseline,
+            (hash == expected) ? "same" : "DIFFER"
+        );
+    }
+
+    universe_deinit(&uvs);
+    return 0;
+}
+
+#endif
@@ -8,10 +8,6 @@ typedef _Bool GolCell;
 #define Alive 1
 #define Dead 0
 
-static inline GolCell cell_next_iteration(GolCell old, int neighbours) {
-    return old?
-        neighbours >= 2 && neighbours <= 3 :
-        neighbours == 3;
-}
+// the rules for the next state of a cell are in rule.c
 
 #endif
\ No newline at end of file
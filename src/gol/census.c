@@ -0,0 +1,847 @@
+#ifndef GOL_CENSUS_C_
+#define GOL_CENSUS_C_
+
+//! Object census: splits the live cells into objects and tells what each of them is. Cells at
+//! most 2 apart either way belong to the same object, as they affect a common neighbour: that
+//! keeps together the spaceships and still lifes whose parts don't touch. The rows are scanned
+//! in parallel bands for runs of live cells, a word at a time, and a union-find over the runs
+//! joins those that are close, within a band first and across the edges between bands after.
+//! Every object gets a hash of its cells that is the same in any position, rotation and
+//! reflection. A shape seen for the first time is stepped on its own to find out whether it
+//! is a still life, an oscillator or a spaceship, and all of its phases are remembered, so
+//! later censuses only look the hash up.
+//! In B3/S23 the common objects are named (block, blinker, glider, ...).
+//! NOTE: an object reaching across a wrapping edge counts as its two halves, and objects a
+//! single dead cell apart count as one larger object (a blinker next to a beehive is a
+//! 9-cell oscillator).
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "packed.c"
+#include "pool.c"
+#include "rule.c"
+#include "universe.c"
+#include "../const.h"
+#include "../panic.h"
+
+// objects larger than this either way are counted, but not classified
+#define CENSUS_MAX_SIDE 64
+// the longest period of an oscillator or spaceship that is recognised
+#define CENSUS_MAX_PERIOD 32
+// a shape is stepped alone on a board with this much room around it, enough for
+// a c/2 spaceship to travel for CENSUS_MAX_PERIOD generations
+#define CENSUS_MARGIN 32
+#define CENSUS_BOARD (CENSUS_MAX_SIDE + 2 * CENSUS_MARGIN)
+// what the hash of a shape that doesn't settle alone maps to
+#define CENSUS_UNSETTLED UINT32_MAX
+
+typedef enum CensusKind {
+    CensusKind_Still = 0,
+    CensusKind_Oscillator,
+    CensusKind_Spaceship,
+    CensusKind_Count,
+} CensusKind;
+
+static const char* CENSUS_KIND_NAMES[] = {
+    [CensusKind_Still] = "still life",
+    [CensusKind_Oscillator] = "oscillator",
+    [CensusKind_Spaceship] = "spaceship",
+};
+
+typedef struct CensusKnown {
+    const char* name;
+    /// one phase, rows split by '/' with 'O' for a live cell
+    const char* cells;
+} CensusKnown;
+
+/// The common objects of B3/S23.
+static const CensusKnown CENSUS_KNOWN[] = {
+    { "block", "OO/OO" },
+    { "beehive", ".OO./O..O/.OO." },
+    { "loaf", ".OO./O..O/.O.O/..O." },
+    { "boat", "OO./O.O/.O." },
+    { "ship", "OO./O.O/.OO" },
+    { "tub", ".O./O.O/.O." },
+    { "pond", ".OO./O..O/O..O/.OO." },
+    { "long boat", "OO../O.O./.O.O/..O." },
+    { "barge", ".O../O.O./.O.O/..O." },
+    { "snake", "OO.O/O.OO" },
+    { "aircraft carrier", "OO../O..O/..OO" },
+    { "eater 1", "OO../O.O./..O./..OO" },
+    { "mango", ".OO../O..O./.O..O/..OO." },
+    { "blinker", "OOO" },
+    { "toad", ".OOO/OOO." },
+    { "beacon", "OO../OO../..OO/..OO" },
+    { "clock", "..O./O.O./.O.O/.O.." },
+    { "traffic light", "..OOO../......./O.....O/O.....O/O.....O/......./..OOO.." },
+    { "pulsar", "..OOO...OOO../............./O....O.O....O/O....O.O....O/O....O.O....O/..OOO...OOO../"
+      "............./..OOO...OOO../O....O.O....O/O....O.O....O/O....O.O....O/............./..OOO...OOO.." },
+    { "pentadecathlon", "..O....O../OO.OOOO.OO/..O....O.." },
+    { "glider", ".O./..O/OOO" },
+    { "lightweight spaceship", ".O..O/O..../O...O/OOOO." },
+    { "middleweight spaceship", "...O../.O...O/O...../O....O/OOOOO." },
+    { "heavyweight spaceship", "...OO../.O....O/O....../O.....O/OOOOOO." },
+};
+#define CENSUS_KNOWN_COUNT (sizeof(CENSUS_KNOWN) / sizeof(CENSUS_KNOWN[0]))
+
+typedef struct CensusClass {
+    /// the smallest hash of its phases
+    uint64_t id;
+    CensusKind kind;
+    uint32_t period;
+    /// cells travelled per period, spaceships only
+    int32_t dx, dy;
+    /// cells of its smallest phase
+    uint32_t cells;
+    /// the name of a common object, NULL otherwise
+    const char* name;
+    /// objects of this class counted since `census_clear`
+    uint64_t count;
+} CensusClass;
+
+/// The live cells [x0, x1] of row y.
+typedef struct CensusRun {
+    uint32_t x0, x1, y;
+} CensusRun;
+
+typedef struct CensusObject {
+    /// its runs in `CensusScan.sorted`
+    uint32_t first_run, run_count;
+    uint32_t cells;
+    uint32_t min_x, min_y, max_x, max_y;
+    /// the same for the object in any position, rotation and reflection, 0 when it is too large
+    uint64_t hash;
+} CensusObject;
+
+typedef struct CensusBand {
+    size_t y0, y1;
+    CensusRun* runs;
+    /// union-find over the runs, indices within the band
+    uint32_t* parent;
+    size_t len, cap;
+    /// where the runs of the first two rows start, and where they end
+    size_t head[3];
+    /// where the runs of the last two rows start, and where they end
+    size_t tail[3];
+    /// where the runs go in `CensusScan.parent`
+    size_t offset;
+    /// the objects whose first run is in the band, and the number of the first of them
+    size_t roots, first_object;
+} CensusBand;
+
+/// Where a census reads the cells from: a bit-packed grid, or a universe through `universe_word`.
+typedef struct CensusSource {
+    const PackedGrid* packed;
+    const Universe* universe;
+    size_t width, height;
+} CensusSource;
+
+/// The scratch of a census, reused from one to the next. One per thread that runs them.
+typedef struct CensusScan {
+    CensusSource src;
+    CensusBand* bands;
+    size_t band_count, band_cap;
+    /// union-find over the runs of all bands, and the object of every run
+    uint32_t* parent;
+    uint32_t* object;
+    /// the runs in the order they were found, then by object
+    CensusRun* runs;
+    CensusRun* sorted;
+    size_t run_count, run_cap;
+    CensusObject* objects;
+    size_t object_count, object_cap;
+} CensusScan;
+
+/// The shapes seen so far and what they are, shared by the threads counting into it.
+typedef struct Census {
+    pthread_mutex_t lock;
+    /// the rule the shapes were stepped with
+    uint16_t birth, survive;
+    /// open addressing from the hash of a shape to its class + 1 or CENSUS_UNSETTLED, 0 is a free slot
+    uint64_t* keys;
+    uint32_t* values;
+    size_t slots, used;
+    CensusClass* classes;
+    size_t class_count, class_cap;
+    /// the ids of the CENSUS_KNOWN objects, once the rule is B3/S23
+    uint64_t known_ids[CENSUS_KNOWN_COUNT];
+    bool known_ready;
+    /// counted since `census_clear`: all objects, those that don't settle alone and those too large to classify
+    uint64_t objects, unsettled, large;
+    /// where shapes are stepped alone
+    PackedGrid board;
+} Census;
+
+/// A random-looking key for every cell (x, y) of a shape, [y][x]
+static uint64_t census_keys[CENSUS_MAX_SIDE][CENSUS_MAX_SIDE];
+static pthread_once_t census_keys_once = PTHREAD_ONCE_INIT;
+
+static void census_keys_init(void) {
+    for (uint64_t i = 0; i < CENSUS_MAX_SIDE * CENSUS_MAX_SIDE; i++) {
+        // splitmix64
+        uint64_t z = (i + 1) * UINT64_C(0x9E3779B97F4A7C15);
+        z = (z ^ (z >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+        z = (z ^ (z >> 27)) * UINT64_C(0x94D049BB133111EB);
+        census_keys[i / CENSUS_MAX_SIDE][i % CENSUS_MAX_SIDE] = z ^ (z >> 31);
+    }
+}
+
+static inline uint64_t census_key(size_t x, size_t y) {
+    return census_keys[y][x];
+}
+
+Census* census_alloc(void) {
+    Census* census = (Census*)calloc(1, sizeof(Census));
+    if (!census) {
+        panic("Allocation of census_alloc failed");
+        return NULL;
+    }
+    pthread_mutex_init(&(census->lock), NULL);
+    pthread_once(&census_keys_once, census_keys_init);
+    census->board = packed_new(CENSUS_BOARD, CENSUS_BOARD);
+    return census;
+}
+
+void census_free(Census* census) {
+    if (!census) return;
+    pthread_mutex_destroy(&(census->lock));
+    packed_deinit(&(census->board));
+    free(census->keys);
+    free(census->values);
+    free(census->classes);
+    free(census);
+}
+
+CensusScan* census_scan_alloc(void) {
+    CensusScan* scan = (CensusScan*)calloc(1, sizeof(CensusScan));
+    if (!scan) panic("Allocation of census_scan_alloc failed");
+    pthread_once(&census_keys_once, census_keys_init);
+    return scan;
+}
+
+void census_scan_free(CensusScan* scan) {
+    if (!scan) return;
+    for (size_t b = 0; b < scan->band_cap; b++) {
+        free(scan->bands[b].runs);
+        free(scan->bands[b].parent);
+    }
+    free(scan->bands);
+    free(scan->parent);
+    free(scan->object);
+    free(scan->runs);
+    free(scan->sorted);
+    free(scan->objects);
+    free(scan);
+}
+
+/// Grow `*items` to at least `n` items of `size` bytes. False after a panic.
+static bool census_grow(void** items, size_t n, size_t size) {
+    void* grown = realloc(*items, n * size);
+    if (!grown) {
+        panic("Growing the census failed");
+        return false;
+    }
+    *items = grown;
+    return true;
+}
+
+static inline uint64_t census_word(const CensusSource* src, size_t y, size_t k) {
+    if (!(src->packed)) return universe_word(src->universe, false, y, k);
+
+    const PackedGrid* g = src->packed;
+    uint64_t mask = (k + 1 == g->row_words) ? g->tail_mask : ~UINT64_C(0);
+    return PACKED_ROW(g, g->words, y)[k] & mask;
+}
+
+static inline uint32_t census_find(uint32_t* parent, uint32_t i) {
+    while (parent[i] != i) {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+    return i;
+}
+
+/// Join the runs [c0, c1) of a row with those of another row in [p0, p1) that are at most 2
+/// cells away either way. `runs` and `parent` are indexed alike.
+static void census_join_rows(const CensusRun* runs, uint32_t* parent, size_t p0, size_t p1, size_t c0, size_t c1) {
+    size_t p = p0;
+    for (size_t c = c0; c < c1; c++) {
+        while (p < p1 && runs[p].x1 + 2 < runs[c].x0) p++;
+        if (p == p1 || runs[p].x0 > runs[c].x1 + 2) continue;
+
+        uint32_t root = census_find(parent, (uint32_t)c);
+        for (size_t q = p; q < p1 && runs[q].x0 <= runs[c].x1 + 2; q++) {
+            const uint32_t other = census_find(parent, (uint32_t)q);
+            // the smaller index stays the root, so a root is the first run of its object
+            if (other < root) {
+                parent[root] = other;
+                root = other;
+            }
+            else if (root < other) parent[other] = root;
+        }
+    }
+}
+
+/// Find the runs of the bands [b0, b1) and join those that are close.
+static void census_scan_bands(void* ctx, size_t b0, size_t b1) {
+    CensusScan* scan = (CensusScan*)ctx;
+    const size_t row_words = (scan->src.width + 63) / 64;
+
+    for (size_t b = b0; b < b1; b++) {
+        CensusBand* band = scan->bands + b;
+        // where the runs of the two rows above start
+        size_t above = 0, above2 = 0;
+        band->len = 0;
+
+        for (size_t y = band->y0; y < band->y1; y++) {
+            const size_t row_start = band->len;
+            for (size_t k = 0; k < row_words; k++) {
+                uint64_t w = census_word(&(scan->src), y, k);
+                while (w) {
+                    const unsigned s = (unsigned)__builtin_ctzll(w);
+                    const uint64_t from = w >> s;
+                    const unsigned n = ~from ? (unsigned)__builtin_ctzll(~from) : 64 - s;
+                    const uint32_t x0 = (uint32_t)(k * 64 + s), x1 = x0 + n - 1;
+                    w = (s + n >= 64) ? 0 : w & (~UINT64_C(0) << (s + n));
+
+                    // a run that goes on from the last word
+                    const bool after = band->len > row_start;
+                    if (after && band->runs[band->len - 1].x1 + 1 == x0) {
+                        band->runs[band->len - 1].x1 = x1;
+                        continue;
+                    }
+                    if (band->len == band->cap) {
+                        size_t cap = max(band->cap * 2, 256);
+                        if (!census_grow((void**)&(band->runs), cap, sizeof(CensusRun))) return;
+                        if (!census_grow((void**)&(band->parent), cap, sizeof(uint32_t))) return;
+                        band->cap = cap;
+                    }
+                    band->runs[band->len] = (CensusRun){ x0, x1, (uint32_t)y };
+                    band->parent[band->len] = (uint32_t)(band->len);
+                    // with a single dead cell from the last run
+                    if (after && band->runs[band->len - 1].x1 + 2 == x0) {
+                        band->parent[band->len] = census_find(band->parent, (uint32_t)(band->len - 1));
+                    }
+                    band->len++;
+                }
+            }
+
+            census_join_rows(band->runs, band->parent, above, row_start, row_start, band->len);
+            census_join_rows(band->runs, band->parent, above2, above, row_start, band->len);
+            if (y == band->y0) band->head[1] = band->head[2] = band->len;
+            if (y == band->y0 + 1) band->head[2] = band->len;
+            above2 = (y == band->y0) ? row_start : above;
+            above = row_start;
+        }
+        band->head[0] = 0;
+        band->tail[0] = above2;
+        band->tail[1] = above;
+        band->tail[2] = band->len;
+    }
+}
+
+/// Move the union-find of the bands [b0, b1) into the one of all runs.
+static void census_gather_bands(void* ctx, size_t b0, size_t b1) {
+    CensusScan* scan = (CensusScan*)ctx;
+
+    for (size_t b = b0; b < b1; b++) {
+        const CensusBand* band = scan->bands + b;
+        for (size_t i = 0; i < band->len; i++) scan->parent[band->offset + i] = band->parent[i] + (uint32_t)(band->offset);
+        memcpy(scan->runs + band->offset, band->runs, band->len * sizeof(CensusRun));
+    }
+}
+
+/// Add the cell (x, y) of a `w` x `h` shape to the hashes of its 8 orientations.
+/// The cells are summed, so the order they come in doesn't matter.
+static inline void census_hash_cell(uint64_t sums[8], size_t x, size_t y, size_t w, size_t h) {
+    const size_t rx = w - 1 - x, ry = h - 1 - y;
+    sums[0] += census_key(x, y);
+    sums[1] += census_key(rx, y);
+    sums[2] += census_key(x, ry);
+    sums[3] += census_key(rx, ry);
+    sums[4] += census_key(y, x);
+    sums[5] += census_key(ry, x);
+    sums[6] += census_key(y, rx);
+    sums[7] += census_key(ry, rx);
+}
+
+/// The smallest hash of the 8 orientations, never 0.
+static inline uint64_t census_canonical(const uint64_t sums[8]) {
+    uint64_t best = sums[0];
+    for (int i = 1; i < 8; i++) best = min(best, sums[i]);
+    return best ? best : 1;
+}
+
+/// Find the root of every run of the bands [b0, b1), into `object`. Nothing is written to
+/// `parent`, other bands read it at the same time.
+static void census_find_roots(void* ctx, size_t b0, size_t b1) {
+    CensusScan* scan = (CensusScan*)ctx;
+
+    for (size_t b = b0; b < b1; b++) {
+        CensusBand* band = scan->bands + b;
+        band->roots = 0;
+        for (size_t i = band->offset; i < band->offset + band->len; i++) {
+            uint32_t root = (uint32_t)i;
+            while (scan->parent[root] != root) root = scan->parent[root];
+            scan->object[i] = root;
+            if (root == i) band->roots++;
+        }
+    }
+}
+
+/// Number the objects whose first run is in the bands [b0, b1), the number goes in `parent` of the root.
+static void census_number_objects(void* ctx, size_t b0, size_t b1) {
+    CensusScan* scan = (CensusScan*)ctx;
+
+    for (size_t b = b0; b < b1; b++) {
+        const CensusBand* band = scan->bands + b;
+        uint32_t o = (uint32_t)(band->first_object);
+        for (size_t i = band->offset; i < band->offset + band->len; i++) {
+            if (scan->object[i] != i) continue;
+            scan->parent[i] = o;
+            scan->objects[o++].run_count = 0;
+        }
+    }
+}
+
+/// Measure and hash the objects [o0, o1).
+static void census_hash_objects(void* ctx, size_t o0, size_t o1) {
+    CensusScan* scan = (CensusScan*)ctx;
+
+    for (size_t o = o0; o < o1; o++) {
+        CensusObject* obj = scan->objects + o;
+        const CensusRun* runs = scan->sorted + obj->first_run;
+        obj->cells = 0;
+        obj->min_x = obj->min_y = UINT32_MAX;
+        obj->max_x = obj->max_y = 0;
+        for (uint32_t r = 0; r < obj->run_count; r++) {
+            obj->cells += runs[r].x1 - runs[r].x0 + 1;
+            obj->min_x = min(obj->min_x, runs[r].x0);
+            obj->max_x = max(obj->max_x, runs[r].x1);
+            obj->min_y = min(obj->min_y, runs[r].y);
+            obj->max_y = max(obj->max_y, runs[r].y);
+        }
+
+        const size_t w = obj->max_x - obj->min_x + 1, h = obj->max_y - obj->min_y + 1;
+        obj->hash = 0;
+        if (w > CENSUS_MAX_SIDE || h > CENSUS_MAX_SIDE) continue;
+
+        uint64_t sums[8] = {0};
+        for (uint32_t r = 0; r < obj->run_count; r++) {
+            for (uint32_t x = runs[r].x0; x <= runs[r].x1; x++) {
+                census_hash_cell(sums, x - obj->min_x, runs[r].y - obj->min_y, w, h);
+            }
+        }
+        obj->hash = census_canonical(sums);
+    }
+}
+
+static inline void census_run(GolPool* pool, GolPoolJob job, void* ctx, size_t n) {
+    if (pool) gol_pool_run(pool, job, ctx, n);
+    else job(ctx, 0, n);
+}
+
+/// Split the live cells of `src` into objects, into `scan->objects`.
+/// The bands are scanned in parallel with `pool`, if there is one.
+void census_scan(CensusScan* scan, const CensusSource* src, GolPool* pool) {
+    scan->src = *src;
+    scan->object_count = 0;
+    scan->run_count = 0;
+    if (src->width == 0 || src->height == 0) return;
+
+    size_t bands = pool ? pool->thread_count * GOL_POOL_BANDS_PER_THREAD : 1;
+    bands = min(bands, src->height);
+    if (bands > scan->band_cap) {
+        if (!census_grow((void**)&(scan->bands), bands, sizeof(CensusBand))) return;
+        memset(scan->bands + scan->band_cap, 0, (bands - scan->band_cap) * sizeof(CensusBand));
+        scan->band_cap = bands;
+    }
+    // at least 2 rows, so the objects across the edge of a band are in the bands next to it
+    const size_t band_rows = max((src->height + bands - 1) / bands, 2);
+    scan->band_count = (src->height + band_rows - 1) / band_rows;
+    for (size_t b = 0; b < scan->band_count; b++) {
+        scan->bands[b].y0 = b * band_rows;
+        scan->bands[b].y1 = min((b + 1) * band_rows, src->height);
+    }
+
+    census_run(pool, census_scan_bands, scan, scan->band_count);
+    if (paniced) return;
+
+    size_t runs = 0;
+    for (size_t b = 0; b < scan->band_count; b++) {
+        scan->bands[b].offset = runs;
+        runs += scan->bands[b].len;
+    }
+    if (runs > scan->run_cap) {
+        if (!census_grow((void**)&(scan->parent), runs, sizeof(uint32_t))) return;
+        if (!census_grow((void**)&(scan->object), runs, sizeof(uint32_t))) return;
+        if (!census_grow((void**)&(scan->runs), runs, sizeof(CensusRun))) return;
+        if (!census_grow((void**)&(scan->sorted), runs, sizeof(CensusRun))) return;
+        scan->run_cap = runs;
+    }
+    scan->run_count = runs;
+    census_run(pool, census_gather_bands, scan, scan->band_count);
+
+    // the first two rows of a band are close to the last two of the band above
+    for (size_t b = 1; b < scan->band_count; b++) {
+        const size_t u = scan->bands[b - 1].offset, d = scan->bands[b].offset;
+        const size_t* tail = scan->bands[b - 1].tail;
+        const size_t* head = scan->bands[b].head;
+        census_join_rows(scan->runs, scan->parent, u + tail[1], u + tail[2], d + head[0], d + head[1]);
+        census_join_rows(scan->runs, scan->parent, u + tail[1], u + tail[2], d + head[1], d + head[2]);
+        census_join_rows(scan->runs, scan->parent, u + tail[0], u + tail[1], d + head[0], d + head[1]);
+    }
+
+    // an object for every root, the first run of its object
+    census_run(pool, census_find_roots, scan, scan->band_count);
+    size_t objects = 0;
+    for (size_t b = 0; b < scan->band_count; b++) {
+        scan->bands[b].first_object = objects;
+        objects += scan->bands[b].roots;
+    }
+    if (objects > scan->object_cap) {
+        if (!census_grow((void**)&(scan->objects), objects, sizeof(CensusObject))) return;
+        scan->object_cap = objects;
+    }
+    scan->object_count = objects;
+    census_run(pool, census_number_objects, scan, scan->band_count);
+    for (size_t i = 0; i < runs; i++) {
+        scan->object[i] = scan->parent[scan->object[i]];
+        scan->objects[scan->object[i]].run_count++;
+    }
+
+    // order the runs by object: every object starts at the end of its runs and counts back
+    uint32_t end = 0;
+    for (size_t o = 0; o < scan->object_count; o++) {
+        end += scan->objects[o].run_count;
+        scan->objects[o].first_run = end;
+    }
+    for (size_t i = runs; i-- > 0;) {
+        scan->sorted[--(scan->objects[scan->object[i]].first_run)] = scan->runs[i];
+    }
+
+    census_run(pool, census_hash_objects, scan, scan->object_count);
+}
+
+/// Forget the shapes, they were stepped with another rule.
+static void census_forget(Census* census, const GolRule* rule) {
+    if (census->keys) memset(census->keys, 0, census->slots * sizeof(uint64_t));
+    census->used = 0;
+    census->class_count = 0;
+    census->known_ready = false;
+    census->birth = rule->birth;
+    census->survive = rule->survive;
+}
+
+static inline size_t census_slot(const Census* census, uint64_t key) {
+    size_t i = (size_t)(key * UINT64_C(0x9E3779B97F4A7C15) >> 17) & (census->slots - 1);
+    while (census->keys[i] && census->keys[i] != key) i = (i + 1) & (census->slots - 1);
+    return i;
+}
+
+static void census_insert(Census* census, uint64_t key, uint32_t value) {
+    // at most half full
+    if (2 * (census->used + 1) > census->slots) {
+        uint64_t* keys = census->keys;
+        uint32_t* values = census->values;
+        const size_t slots = census->slots;
+
+        census->slots = max(slots * 2, 1024);
+        census->keys = (uint64_t*)calloc(census->slots, sizeof(uint64_t));
+        census->values = (uint32_t*)malloc(census->slots * sizeof(uint32_t));
+        if (!(census->keys) || !(census->values)) {
+            free(census->keys);
+            free(census->values);
+            census->keys = keys;
+            census->values = values;
+            census->slots = slots;
+            panic("Growing the census shapes failed");
+            return;
+        }
+        for (size_t i = 0; i < slots; i++) {
+            if (!keys[i]) continue;
+            size_t to = census_slot(census, keys[i]);
+            census->keys[to] = keys[i];
+            census->values[to] = values[i];
+        }
+        free(keys);
+        free(values);
+    }
+
+    size_t i = census_slot(census, key);
+    if (!(census->keys[i])) census->used++;
+    census->keys[i] = key;
+    census->values[i] = value;
+}
+
+/// The shape on the board within the rows [y0, y1), false if there is none.
+typedef struct CensusShape {
+    uint32_t cells;
+    size_t min_x, min_y, max_x, max_y;
+    /// the hash of this orientation, and the one of any orientation
+    uint64_t oriented, canonical;
+} CensusShape;
+
+static bool census_board_shape(const PackedGrid* g, size_t y0, size_t y1, CensusShape* shape) {
+    *shape = (CensusShape){ .min_x = SIZE_MAX, .min_y = SIZE_MAX };
+    for (size_t y = y0; y < y1; y++) {
+        const uint64_t* row = PACKED_ROW(g, g->words, y);
+        for (size_t k = 0; k < g->row_words; k++) {
+            if (!row[k]) continue;
+            shape->cells += (uint32_t)__builtin_popcountll(row[k]);
+            shape->min_x = min(shape->min_x, k * 64 + (size_t)__builtin_ctzll(row[k]));
+            shape->max_x = max(shape->max_x, k * 64 + 63 - (size_t)__builtin_clzll(row[k]));
+            shape->min_y = min(shape->min_y, y);
+            shape->max_y = y;
+        }
+    }
+    if (!(shape->cells)) return false;
+
+    const size_t w = shape->max_x - shape->min_x + 1, h = shape->max_y - shape->min_y + 1;
+    // a shape that grew too large can't come back to how it started
+    if (w > CENSUS_MAX_SIDE || h > CENSUS_MAX_SIDE) {
+        shape->oriented = shape->canonical = 0;
+        return true;
+    }
+    uint64_t sums[8] = {0};
+    for (size_t y = shape->min_y; y <= shape->max_y; y++) {
+        const uint64_t* row = PACKED_ROW(g, g->words, y);
+        for (size_t k = 0; k < g->row_words; k++) {
+            for (uint64_t bits = row[k]; bits; bits &= bits - 1) {
+                size_t x = k * 64 + (size_t)__builtin_ctzll(bits);
+                census_hash_cell(sums, x - shape->min_x, y - shape->min_y, w, h);
+            }
+        }
+    }
+    shape->oriented = sums[0];
+    shape->canonical = census_canonical(sums);
+    return true;
+}
+
+/// Step the shape on the board until it looks the same again, into `cls`, and its phases into
+/// `phases`. Returns the number of phases, 0 when it changes into something else, dies or
+/// grows out of the board.
+static size_t census_isolate(Census* census, const GolRule* rule, CensusClass* cls, uint64_t phases[CENSUS_MAX_PERIOD]) {
+    PackedGrid* g = &(census->board);
+    CensusShape start, shape;
+    if (!census_board_shape(g, 0, CENSUS_BOARD, &start)) return 0;
+
+    *cls = (CensusClass){ .id = start.canonical, .cells = start.cells };
+    phases[0] = start.canonical;
+    // the rows of `words_next` that may hold cells
+    size_t next_lo = 0, next_hi = 0;
+    shape = start;
+
+    for (uint32_t t = 1; t <= CENSUS_MAX_PERIOD; t++) {
+        const size_t y0 = shape.min_y - 1, y1 = shape.max_y + 2;
+        for (size_t y = next_lo; y < next_hi; y++) {
+            if (y < y0 || y >= y1) memset(PACKED_ROW(g, g->words_next, y), 0, g->row_words * sizeof(uint64_t));
+        }
+        packed_step_rows(g, rule, y0, y1);
+        packed_swap(g);
+        next_lo = shape.min_y;
+        next_hi = shape.max_y + 1;
+        next_lo = min(next_lo, y0);
+        next_hi = max(next_hi, y1);
+
+        if (!census_board_shape(g, y0, y1, &shape)) return 0;
+        if (shape.min_x == 0 || shape.min_y == 0 || shape.max_x == CENSUS_BOARD - 1 || shape.max_y == CENSUS_BOARD - 1) return 0;
+        if (!shape.canonical) return 0;
+
+        if (shape.oriented == start.oriented && shape.cells == start.cells) {
+            cls->period = t;
+            cls->dx = (int32_t)shape.min_x - (int32_t)start.min_x;
+            cls->dy = (int32_t)shape.min_y - (int32_t)start.min_y;
+            cls->kind = (cls->dx || cls->dy) ? CensusKind_Spaceship : (t == 1) ? CensusKind_Still : CensusKind_Oscillator;
+            return t;
+        }
+        if (t < CENSUS_MAX_PERIOD) phases[t] = shape.canonical;
+        cls->id = min(cls->id, shape.canonical);
+        cls->cells = min(cls->cells, shape.cells);
+    }
+    return 0;
+}
+
+static void census_board_clear(Census* census) {
+    PackedGrid* g = &(census->board);
+    const size_t words = g->stride * (g->capacity_height + 2);
+    memset(g->words, 0, words * sizeof(uint64_t));
+    memset(g->words_next, 0, words * sizeof(uint64_t));
+}
+
+/// Step the CENSUS_KNOWN objects to learn their ids.
+static void census_learn_known(Census* census, const GolRule* rule) {
+    for (size_t i = 0; i < CENSUS_KNOWN_COUNT; i++) {
+        census_board_clear(census);
+        size_t x = CENSUS_MARGIN, y = CENSUS_MARGIN;
+        for (const char* c = CENSUS_KNOWN[i].cells; *c; c++) {
+            if (*c == '/') {
+                x = CENSUS_MARGIN;
+                y++;
+                continue;
+            }
+            if (*c == 'O') packed_set(&(census->board), x, y, Alive);
+            x++;
+        }
+
+        CensusClass cls;
+        uint64_t phases[CENSUS_MAX_PERIOD];
+        census->known_ids[i] = census_isolate(census, rule, &cls, phases) ? cls.id : 0;
+    }
+    census->known_ready = true;
+}
+
+/// Step a shape seen for the first time alone and remember what it is for every phase.
+static uint32_t census_classify(Census* census, const CensusScan* scan, const CensusObject* obj, const GolRule* rule) {
+    census_board_clear(census);
+    const CensusRun* runs = scan->sorted + obj->first_run;
+    for (uint32_t r = 0; r < obj->run_count; r++) {
+        packed_set_run(
+            &(census->board), CENSUS_MARGIN + runs[r].x0 - obj->min_x, CENSUS_MARGIN + runs[r].y - obj->min_y,
+            runs[r].x1 - runs[r].x0 + 1
+        );
+    }
+
+    CensusClass cls;
+    uint64_t phases[CENSUS_MAX_PERIOD];
+    const size_t period = census_isolate(census, rule, &cls, phases);
+    if (!period) {
+        census_insert(census, obj->hash, CENSUS_UNSETTLED);
+        return CENSUS_UNSETTLED;
+    }
+
+    for (size_t i = 0; census->known_ready && i < CENSUS_KNOWN_COUNT; i++) {
+        if (census->known_ids[i] == cls.id) cls.name = CENSUS_KNOWN[i].name;
+    }
+    if (census->class_count == census->class_cap) {
+        size_t cap = max(census->class_cap * 2, 64);
+        if (!census_grow((void**)&(census->classes), cap, sizeof(CensusClass))) return CENSUS_UNSETTLED;
+        census->class_cap = cap;
+    }
+    census->classes[census->class_count++] = cls;
+
+    const uint32_t value = (uint32_t)(census->class_count);
+    for (size_t i = 0; i < period; i++) census_insert(census, phases[i], value);
+    return value;
+}
+
+/// Start counting from 0.
+void census_clear(Census* census) {
+    pthread_mutex_lock(&(census->lock));
+    for (size_t i = 0; i < census->class_count; i++) census->classes[i].count = 0;
+    census->objects = census->unsettled = census->large = 0;
+    pthread_mutex_unlock(&(census->lock));
+}
+
+/// Start over when the rule changed, and learn the names once it is B3/S23.
+static void census_prepare(Census* census, const GolRule* rule) {
+    if (rule->birth != census->birth || rule->survive != census->survive || !(census->keys)) census_forget(census, rule);
+    // only B3/S23 has names
+    if (!(census->known_ready) && rule->birth == (1 << 3) && rule->survive == ((1 << 2) | (1 << 3))) {
+        census_learn_known(census, rule);
+    }
+}
+
+/// The class + 1 of an object, CENSUS_UNSETTLED when it doesn't settle alone, 0 when it is too large.
+static uint32_t census_value(Census* census, const CensusScan* scan, const CensusObject* obj, const GolRule* rule) {
+    if (!(obj->hash)) return 0;
+
+    uint32_t value = 0;
+    if (census->keys) {
+        size_t i = census_slot(census, obj->hash);
+        if (census->keys[i]) value = census->values[i];
+    }
+    return value ? value : census_classify(census, scan, obj, rule);
+}
+
+static void census_tally(Census* census, uint32_t value) {
+    census->objects++;
+    if (!value) census->large++;
+    else if (value == CENSUS_UNSETTLED) census->unsettled++;
+    else census->classes[value - 1].count++;
+}
+
+/// Count the objects found by `census_scan` by what they are, in `rule`.
+void census_count(Census* census, const CensusScan* scan, const GolRule* rule) {
+    pthread_mutex_lock(&(census->lock));
+    census_prepare(census, rule);
+    for (size_t o = 0; o < scan->object_count && !paniced; o++) {
+        census_tally(census, census_value(census, scan, scan->objects + o, rule));
+    }
+    pthread_mutex_unlock(&(census->lock));
+}
+
+/// What object `o` found by `census_scan` is, into `cls`, without counting it.
+/// False when it is too large or doesn't settle alone.
+bool census_identify(Census* census, const CensusScan* scan, size_t o, const GolRule* rule, CensusClass* cls) {
+    pthread_mutex_lock(&(census->lock));
+    census_prepare(census, rule);
+    const uint32_t value = census_value(census, scan, scan->objects + o, rule);
+    const bool known = value && value != CENSUS_UNSETTLED && !paniced;
+    if (known) *cls = census->classes[value - 1];
+    pthread_mutex_unlock(&(census->lock));
+    return known;
+}
+
+/// Count object `o` found by `census_scan` alone, like `census_count` counts all of them.
+void census_count_object(Census* census, const CensusScan* scan, size_t o, const GolRule* rule) {
+    pthread_mutex_lock(&(census->lock));
+    census_prepare(census, rule);
+    census_tally(census, census_value(census, scan, scan->objects + o, rule));
+    pthread_mutex_unlock(&(census->lock));
+}
+
+/// Copy the `n` most counted classes into `top`, most counted first. Returns how many there are.
+size_t census_top(Census* census, CensusClass* top, size_t n) {
+    size_t len = 0;
+
+    pthread_mutex_lock(&(census->lock));
+    for (size_t c = 0; c < census->class_count; c++) {
+        const CensusClass* cls = census->classes + c;
+        if (!(cls->count)) continue;
+
+        size_t i = len;
+        if (i == n) {
+            if (!n || top[i - 1].count >= cls->count) continue;
+            i--;
+        }
+        else len++;
+        for (; i > 0 && top[i - 1].count < cls->count; i--) top[i] = top[i - 1];
+        top[i] = *cls;
+    }
+    pthread_mutex_unlock(&(census->lock));
+    return len;
+}
+
+/// The name of a class, or what it is when it has none.
+void census_label(const CensusClass* cls, char* text, size_t size) {
+    if (cls->name) {
+        snprintf(text, size, "%s", cls->name);
+        return;
+    }
+
+    switch (cls->kind) {
+    case CensusKind_Still: snprintf(text, size, "%u-cell still life", cls->cells); break;
+    case CensusKind_Oscillator: snprintf(text, size, "%u-cell p%u oscillator", cls->cells, cls->period); break;
+    case CensusKind_Spaceship: {
+        // cells per generation as a reduced fraction
+        uint32_t cells = (uint32_t)max(abs(cls->dx), abs(cls->dy)), period = cls->period;
+        for (uint32_t d = cells; d > 1; d--) {
+            if (cells % d == 0 && period % d == 0) {
+                cells /= d;
+                period /= d;
+            }
+        }
+        if (cells == 1) snprintf(text, size, "%u-cell c/%u spaceship", cls->cells, period);
+        else snprintf(text, size, "%u-cell %uc/%u spaceship", cls->cells, cells, period);
+    } break;
+    default: snprintf(text, size, "%s", "?");
+    }
+}
+
+#endif
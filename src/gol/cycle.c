@@ -0,0 +1,68 @@
+#ifndef GOL_CYCLE_C_
+#define GOL_CYCLE_C_
+
+//! Detects when the universe repeats itself: a still life, an oscillator, or a world that
+//! died out. The hashes of the last GOL_CYCLE_WINDOW generations are kept in a ring, and a
+//! new hash equal to one of them means every generation from here on repeats with that period.
+//! The hashes come from `universe_hash`, which the universe keeps up to date while stepping
+//! at the cost of the words that changed, so detection is nearly free.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+// the longest period that is detected
+#define GOL_CYCLE_WINDOW 128
+
+typedef enum GolCycleAction {
+    GolCycleAction_Off = 0,
+    GolCycleAction_Pause,
+    /// skip whole periods without stepping
+    GolCycleAction_FastForward,
+    GolCycleAction_Count,
+} GolCycleAction;
+
+static const char* GOL_CYCLE_ACTION_NAMES[] = {
+    [GolCycleAction_Off] = "off",
+    [GolCycleAction_Pause] = "pause",
+    [GolCycleAction_FastForward] = "fast-forward",
+};
+
+typedef struct GolCycle {
+    uint64_t hashes[GOL_CYCLE_WINDOW];
+    /// hashes pushed since the last reset, the newest at (count - 1) % GOL_CYCLE_WINDOW
+    uint64_t count;
+    /// 0 until a repetition is found, 1 for still lifes
+    uint32_t period;
+    /// the number of repetitions found, including the current one
+    uint64_t found;
+} GolCycle;
+
+/// Forget the hashes, after the cells were changed by anything but stepping.
+static inline void cycle_reset(GolCycle* c) {
+    c->count = 0;
+    c->period = 0;
+}
+
+/// Add the hash of the next generation. Returns true when it starts repeating an earlier one.
+bool cycle_push(GolCycle* c, uint64_t hash) {
+    if (c->period) {
+        // still repeating?
+        if (c->hashes[(c->count - c->period) % GOL_CYCLE_WINDOW] != hash) c->period = 0;
+        c->hashes[c->count++ % GOL_CYCLE_WINDOW] = hash;
+        return false;
+    }
+
+    uint64_t window = (c->count < GOL_CYCLE_WINDOW) ? c->count : GOL_CYCLE_WINDOW;
+    for (uint32_t p = 1; p <= window; p++) {
+        if (c->hashes[(c->count - p) % GOL_CYCLE_WINDOW] != hash) continue;
+
+        c->period = p;
+        c->found++;
+        break;
+    }
+    c->hashes[c->count++ % GOL_CYCLE_WINDOW] = hash;
+    return c->period != 0;
+}
+
+#endif
@@ -0,0 +1,302 @@
+#ifndef GOL_EVENTS_C_
+#define GOL_EVENTS_C_
+
+//! Event-driven kernel for the byte-per-cell universe, for big boards where little moves.
+//! Every cell keeps the count of its live neighbours. A generation only visits the cells that
+//! changed in the last one and their neighbours, and a cell that flips adds itself to or removes
+//! itself from the counts around it, so the cost follows the activity instead of the area.
+//! When too much changes the universe steps with the dense row kernel instead, see universe.c.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cell.c"
+#include "rule.c"
+#include "../const.h"
+#include "../panic.h"
+
+// the event kernel steps while at most one cell in EVENTS_DENSE_RATIO changes per generation.
+// A changed cell costs about as much as this many cells of the dense row kernel.
+#define EVENTS_DENSE_RATIO 256
+// without the statistics, the dense kernel compares the generations this often to find out
+#define EVENTS_PROBE_INTERVAL 16
+// the count of a cell is in the low bits, this one marks it as visited in the current generation
+#define EVENTS_SEEN 0x80
+
+/// A growable array of cell indices (y * width + x).
+typedef struct EventList {
+    uint32_t* items;
+    size_t len, cap;
+} EventList;
+
+typedef struct EventKernel {
+    /// the counts are those of the cells, `events_start` sets it and anything else clears it
+    bool active;
+    size_t width, height;
+    bool wrap;
+    /// the rule `changed` was stepped with, under another one any cell may flip
+    uint16_t birth, survive;
+    /// live neighbours of every cell, width * height
+    uint8_t* counts;
+    /// live cells of every row and column, for the bounds
+    uint32_t* row_population;
+    uint32_t* column_population;
+    /// cells that changed in the last generation, or were set since
+    EventList changed;
+    /// cells visited in this generation
+    EventList candidates;
+    /// cells that flip in this generation
+    EventList flips;
+    /// generations stepped with the dense kernel since the last comparison
+    size_t dense_steps;
+
+    uint64_t population, births, deaths;
+    /// the live cells lie within [min_x, max_x] x [min_y, max_y], if there are any
+    size_t min_x, max_x, min_y, max_y;
+} EventKernel;
+
+static void events_list_push(EventList* list, uint32_t i) {
+    if (list->len == list->cap) {
+        size_t cap = list->cap ? list->cap * 2 : 256;
+        uint32_t* items = (uint32_t*)realloc(list->items, cap * sizeof(uint32_t));
+        if (!items) {
+            panic("Growing an event list failed");
+            return;
+        }
+        list->items = items;
+        list->cap = cap;
+    }
+    list->items[list->len++] = i;
+}
+
+EventKernel* events_alloc(void) {
+    EventKernel* ek = (EventKernel*)calloc(1, sizeof(EventKernel));
+    if (!ek) panic("Allocation of events_alloc failed");
+    return ek;
+}
+
+static void events_release(EventKernel* ek) {
+    free(ek->counts);
+    free(ek->row_population);
+    free(ek->column_population);
+    ek->counts = NULL;
+    ek->row_population = ek->column_population = NULL;
+    ek->width = ek->height = 0;
+    ek->active = false;
+}
+
+void events_free(EventKernel* ek) {
+    if (!ek) return;
+    events_release(ek);
+    free(ek->changed.items);
+    free(ek->candidates.items);
+    free(ek->flips.items);
+    free(ek);
+}
+
+/// The neighbour of cell (x, y) at (x + dx, y + dy), false when it lies past a dead edge.
+static inline bool events_neighbour(const EventKernel* ek, size_t x, size_t y, int dx, int dy, uint32_t* out) {
+    size_t nx = x + (size_t)(ptrdiff_t)dx, ny = y + (size_t)(ptrdiff_t)dy;
+
+    if (nx >= ek->width) {
+        if (!(ek->wrap)) return false;
+        nx = (dx < 0) ? ek->width - 1 : 0;
+    }
+    if (ny >= ek->height) {
+        if (!(ek->wrap)) return false;
+        ny = (dy < 0) ? ek->height - 1 : 0;
+    }
+    *out = (uint32_t)(ny * ek->width + nx);
+    return true;
+}
+
+/// The up to 8 neighbours of cell `i`, returns how many there are.
+static inline size_t events_around(const EventKernel* ek, uint32_t i, uint32_t out[8]) {
+    const size_t w = ek->width;
+    const size_t x = i % w, y = i / w;
+
+    // away from the edges they are at fixed offsets
+    if (x > 0 && x + 1 < w && y > 0 && y + 1 < ek->height) {
+        out[0] = i - (uint32_t)w - 1; out[1] = i - (uint32_t)w; out[2] = i - (uint32_t)w + 1;
+        out[3] = i - 1;                                          out[4] = i + 1;
+        out[5] = i + (uint32_t)w - 1; out[6] = i + (uint32_t)w; out[7] = i + (uint32_t)w + 1;
+        return 8;
+    }
+
+    size_t n = 0;
+    for (int dy = -1; dy <= 1; dy++) {
+        for (int dx = -1; dx <= 1; dx++) {
+            if ((dx || dy) && events_neighbour(ek, x, y, dx, dy, out + n)) n++;
+        }
+    }
+    return n;
+}
+
+/// Start tracking the `width` x `height` cells at `cells` (row 0, with rows `stride` apart and
+/// the halo filled), which changed from the generation at `before` under `rule`. Gives up and
+/// returns false when more than `max_changed` of them changed, the counts are built only once
+/// it won't.
+bool events_start(
+    EventKernel* ek, const GolCell* cells, const GolCell* before, size_t stride,
+    size_t width, size_t height, bool wrap, const GolRule* rule, size_t max_changed
+) {
+    ek->active = false;
+    ek->dense_steps = 0;
+    if ((uint64_t)width * height > UINT32_MAX) return false;
+
+    ek->changed.len = 0;
+    ek->births = ek->deaths = 0;
+    for (size_t y = 0; y < height; y++) {
+        const GolCell* row = cells + y * stride;
+        const GolCell* old = before + y * stride;
+        if (memcmp(row, old, width) == 0) continue;
+
+        for (size_t x = 0; x < width; x++) {
+            if (row[x] == old[x]) continue;
+            if (ek->changed.len == max_changed) return false;
+
+            events_list_push(&(ek->changed), (uint32_t)(y * width + x));
+            if (row[x]) ek->births++;
+            else ek->deaths++;
+        }
+    }
+
+    if (width != ek->width || height != ek->height) {
+        events_release(ek);
+        ek->counts = (uint8_t*)malloc(width * height);
+        ek->row_population = (uint32_t*)malloc(height * sizeof(uint32_t));
+        ek->column_population = (uint32_t*)malloc(width * sizeof(uint32_t));
+        if (!(ek->counts) || !(ek->row_population) || !(ek->column_population)) {
+            events_release(ek);
+            panic("Allocation of the event kernel counts failed");
+            return false;
+        }
+        ek->width = width;
+        ek->height = height;
+    }
+    ek->wrap = wrap;
+    ek->birth = rule->birth;
+    ek->survive = rule->survive;
+
+    memset(ek->column_population, 0, width * sizeof(uint32_t));
+    ek->population = 0;
+    ek->min_x = ek->min_y = SIZE_MAX;
+    ek->max_x = ek->max_y = 0;
+
+    for (size_t y = 0; y < height; y++) {
+        const GolCell* row = cells + y * stride;
+        const GolCell* up = row - stride;
+        const GolCell* down = row + stride;
+        uint8_t* counts = ek->counts + y * width;
+        uint32_t live = 0;
+
+        for (size_t x = 0; x < width; x++) {
+            counts[x] = (uint8_t)(
+                up[x - 1] + up[x] + up[x + 1] +
+                row[x - 1] + row[x + 1] +
+                down[x - 1] + down[x] + down[x + 1]
+            );
+            if (row[x]) {
+                live++;
+                ek->column_population[x]++;
+                ek->min_x = min(ek->min_x, x);
+                ek->max_x = max(ek->max_x, x);
+            }
+        }
+
+        ek->row_population[y] = live;
+        ek->population += live;
+        if (live) {
+            ek->min_y = min(ek->min_y, y);
+            ek->max_y = y;
+        }
+    }
+
+    ek->active = true;
+    return true;
+}
+
+/// Find the cells that flip in this generation, among those that changed in the last one and
+/// their neighbours, into `flips`. Nothing changes yet, see `events_flip`.
+void events_find_flips(EventKernel* ek, const GolCell* cells, size_t stride, const GolRule* rule) {
+    ek->candidates.len = 0;
+    ek->flips.len = 0;
+    ek->births = ek->deaths = 0;
+
+    uint32_t around[8];
+    for (size_t c = 0; c < ek->changed.len; c++) {
+        const uint32_t i = ek->changed.items[c];
+        const size_t n = events_around(ek, i, around);
+
+        if (!(ek->counts[i] & EVENTS_SEEN)) {
+            ek->counts[i] |= EVENTS_SEEN;
+            events_list_push(&(ek->candidates), i);
+        }
+        for (size_t k = 0; k < n; k++) {
+            if (ek->counts[around[k]] & EVENTS_SEEN) continue;
+            ek->counts[around[k]] |= EVENTS_SEEN;
+            events_list_push(&(ek->candidates), around[k]);
+        }
+    }
+    ek->changed.len = 0;
+
+    for (size_t c = 0; c < ek->candidates.len; c++) {
+        const uint32_t i = ek->candidates.items[c];
+        ek->counts[i] &= (uint8_t)~EVENTS_SEEN;
+
+        GolCell old = cells[(i / ek->width) * stride + i % ek->width];
+        if (rule_next(rule, old, ek->counts[i]) != old) events_list_push(&(ek->flips), i);
+    }
+}
+
+/// Flip cell `i`, keep the counts of its neighbours and the population up to date, and list
+/// it as changed for the next generation. The bounds only grow, see `events_settle`.
+static inline void events_flip(EventKernel* ek, GolCell* cells, size_t stride, uint32_t i) {
+    const size_t x = i % ek->width, y = i / ek->width;
+    GolCell* cell = cells + y * stride + x;
+    *cell = !(*cell);
+
+    uint32_t around[8];
+    const size_t n = events_around(ek, i, around);
+
+    if (*cell) {
+        for (size_t k = 0; k < n; k++) ek->counts[around[k]]++;
+        ek->row_population[y]++;
+        ek->column_population[x]++;
+        ek->births++;
+
+        if (ek->population++ == 0) {
+            ek->min_x = ek->max_x = x;
+            ek->min_y = ek->max_y = y;
+        }
+        else {
+            ek->min_x = min(ek->min_x, x);
+            ek->max_x = max(ek->max_x, x);
+            ek->min_y = min(ek->min_y, y);
+            ek->max_y = max(ek->max_y, y);
+        }
+    }
+    else {
+        for (size_t k = 0; k < n; k++) ek->counts[around[k]]--;
+        ek->row_population[y]--;
+        ek->column_population[x]--;
+        ek->deaths++;
+        ek->population--;
+    }
+    events_list_push(&(ek->changed), i);
+}
+
+/// Shrink the bounds past the rows and columns that emptied, after flipping.
+static inline void events_settle(EventKernel* ek) {
+    if (ek->population == 0) return;
+
+    while (ek->row_population[ek->min_y] == 0) ek->min_y++;
+    while (ek->row_population[ek->max_y] == 0) ek->max_y--;
+    while (ek->column_population[ek->min_x] == 0) ek->min_x++;
+    while (ek->column_population[ek->max_x] == 0) ek->max_x--;
+}
+
+#endif
@@ -4,11 +4,26 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <math.h>
+#include <time.h>
+#include <errno.h>
+#include <string.h>
 
 #include "raylib.h"
 #include "raymath.h"
 
 #include "universe.c"
+#include "hashlife.c"
+#include "sparse.c"
+#include "mapped.c"
+#include "pattern.c"
+#include "sim.c"
+#include "snapshot.c"
+#include "history.c"
+#include "cycle.c"
+#include "stats.c"
+#include "census.c"
+#include "region.c"
+#include "render.c"
 #include "theme.c"
 #include "../ui/font.c"
 
@@ -23,29 +38,182 @@ INCBIN(bolus, "../assets/bolus.png");
 #define Cell GolCell
 
 #define GOL_SPEED_SLIDER_MAX 0.65f
+#define GOL_GENS_PER_SEC_WINDOW 0.5f
+// the most common kinds of objects [N] names
+#define GOL_CENSUS_SHOWN 6
 
+/// What steps the cells. For every engine but the universe itself,
+/// `GameOfLife.universe` is the view of the world at [0, width) x [0, height),
+/// or from the corner the view was moved to in the file-backed world.
+typedef enum GolEngine {
+    GolEngine_Universe = 0,
+    GolEngine_Hashlife,
+    GolEngine_Sparse,
+    GolEngine_Mapped,
+    GolEngine_Count,
+} GolEngine;
+
+/// How many generations turbo mode steps between refreshing the view, 0 is off.
+static const uint32_t GOL_TURBO_STEPS[] = { 0, 16, 256, 4096 };
+#define GOL_TURBO_STEPS_COUNT (sizeof(GOL_TURBO_STEPS) / sizeof(GOL_TURBO_STEPS[0]))
+
+/// Seconds of every tick of the simulation thread that may be spent stepping, see `gol_run_steps`.
+static const float GOL_STEP_BUDGETS[] = { 0.004f, 0.008f, 0.016f, 0.032f };
+#define GOL_STEP_BUDGETS_COUNT (sizeof(GOL_STEP_BUDGETS) / sizeof(GOL_STEP_BUDGETS[0]))
+#define GOL_DEFAULT_STEP_BUDGET 1
+
+/// Generations per pass of temporal blocking in turbo mode, see `gol_pass_generations`.
+static const size_t GOL_PASS_GENERATIONS[] = { 1, 4, 8, 16 };
+#define GOL_PASS_GENERATIONS_COUNT (sizeof(GOL_PASS_GENERATIONS) / sizeof(GOL_PASS_GENERATIONS[0]))
+
+/// The memory the rewind history may take, 0 is off.
+static const size_t GOL_HISTORY_BUDGETS[] = { 0, 16 << 20, 64 << 20, 256 << 20 };
+#define GOL_HISTORY_BUDGETS_COUNT (sizeof(GOL_HISTORY_BUDGETS) / sizeof(GOL_HISTORY_BUDGETS[0]))
+#define GOL_DEFAULT_HISTORY_BUDGET 2
+
+static const char* GOL_ENGINE_NAMES[] = {
+    [GolEngine_Universe] = "universe",
+    [GolEngine_Hashlife] = "hashlife",
+    [GolEngine_Sparse] = "sparse tiles",
+    [GolEngine_Mapped] = "file-backed",
+};
+
+/// While the game runs, the universe and the engines belong to the simulation thread,
+/// the UI renders the frames it publishes. See `gol_hold` and `gol_resume`.
 typedef struct GameOfLife {
     Universe universe;
+    GolEngine engine;
+    // the view was edited as a whole, the engine has to reload it before stepping
+    bool engine_dirty;
+    // the engine stepped past the view, see `gol_refresh_view`
+    bool view_stale;
+    // GolEngine_Hashlife, NULL otherwise
+    HashLife* hashlife;
+    // GolEngine_Sparse, NULL otherwise
+    SparseLife* sparse;
+    // GolEngine_Mapped, NULL otherwise
+    MappedLife* mapped;
+    // every hashlife step advances 2^hashlife_step_log2 generations
+    int hashlife_step_log2;
+    // index into RULE_PRESETS of the last preset picked with [U]
+    size_t rule_preset;
+    // the rule text box in the help window
+    char rule_text[32];
+    bool rule_editing;
+    // the last random soup, which [Shift+R] fills in again
+    uint64_t soup_seed;
+    float soup_density;
     GameState state;
-    float update_frame_cap;
+    // also read by the simulation thread
+    _Atomic float update_frame_cap;
     int window_width;
     int window_height;
+    // the window changed size this long ago and the universe doesn't fit it yet
+    bool resize_pending;
+    float resize_wait;
     Vector2 mouse_pos;
     Theme theme;
     Theme prev_theme;
     Texture2D bolus;
+    // draws the cells that changed in one go, for every theme but Bolus
+    GolRender render;
 
     float speed_slider_value;
 
+    // index into GOL_STEP_BUDGETS
+    size_t step_budget;
+    // time owed to the speed slider, stepped off a generation at a time
+    float step_accumulator;
+    // index into GOL_TURBO_STEPS
+    size_t turbo;
+    // index into GOL_PASS_GENERATIONS
+    size_t pass_generations;
+    uint64_t turbo_steps_since_view;
+    // generations per second, measured over the last GOL_GENS_PER_SEC_WINDOW seconds
+    double gens_per_sec;
+    uint64_t gens_window;
+    float gens_window_time;
+
     uint64_t iterations;
+
+    GolSim* sim;
+    // when the simulation thread last stepped
+    double sim_last_time;
+
+    // the generations the simulation thread published, for rewinding
+    GolHistory history;
+    // index into GOL_HISTORY_BUDGETS
+    size_t history_budget;
+    // the history entry the view shows, if it is not the newest one
+    bool rewound;
+    size_t rewound_to;
+    GolFrame rewind_frame;
+    float timeline_value;
+
+    SnapshotWriter snapshot_writer;
+    // the last snapshot saved, which [F3] loads again
+    char snapshot_path[64];
+
+    // what happens when the universe engine repeats a generation
+    GolCycleAction cycle_action;
+    GolCycle cycle;
+    // the `cycle.found` the UI acted on, see `gol_cycle_waiting`
+    uint64_t cycles_seen;
+    // since the last frame published while fast-forwarding
+    float cycle_publish_time;
+
+    // the statistics of every generation the universe engine steps
+    StatsLog stats_log;
+
+    // what the objects in the view are, see `gol_census`, NULL until [N]
+    Census* census;
+    CensusScan* census_scan;
+    char census_text[256];
+
+    // the selected cells of the view, [Shift+drag] selects them
+    bool selection;
+    size_t selection_x, selection_y, selection_width, selection_height;
+    // the drag started at (selection_from_x, selection_from_y) and goes on
+    bool selecting;
+    size_t selection_from_x, selection_from_y;
+    // what [Ctrl+C] or [Ctrl+X] took, [Ctrl+V] pastes it at the mouse
+    GolRegion clipboard;
 } GameOfLife;
 
+static void gol_sim_tick(void* ctx);
+
+/// Bring the view up to date with the engine, which only happens every so many
+/// generations in turbo mode because storing the view of a large world is not free.
+void gol_refresh_view(GameOfLife* gol) {
+    if (gol->view_stale && !(gol->engine_dirty)) {
+        switch (gol->engine) {
+        case GolEngine_Hashlife: hashlife_store_universe(gol->hashlife, &(gol->universe)); break;
+        case GolEngine_Sparse: sparse_store_universe(gol->sparse, &(gol->universe)); break;
+        case GolEngine_Mapped: mapped_store_universe(gol->mapped, &(gol->universe)); break;
+        default: {}
+        }
+    }
+    gol->view_stale = false;
+    gol->turbo_steps_since_view = 0;
+}
+
+static void gol_publish_frame(GameOfLife* gol, bool record);
+
 void gol_state_toggle(GameOfLife* ptr) {
     if (ptr->state == GameState_Paused) {
-        ptr->iterations = 0;
+        bool rewound = ptr->rewound;
+        // going on from a rewound generation forgets the ones after it
+        if (rewound) history_truncate(&(ptr->history), ptr->rewound_to + 1);
+        ptr->rewound = false;
+
+        ptr->step_accumulator = 0.0f;
         ptr->state = GameState_Running;
+        // the generation it starts from, unless that is in the history already
+        gol_publish_frame(ptr, !rewound);
     }
     else {
+        // the cells are edited while paused, so the view has to show the world
+        gol_refresh_view(ptr);
         ptr->state = GameState_Paused;
     }
 }
@@ -59,27 +227,666 @@ GameOfLife* gol_alloc() {
 
     gol->update_frame_cap = GOL_DEFAULT_UPDATE_CAP;
     gol->universe = universe_new(GOL_GRID_W, GOL_GRID_H);
+    snprintf(gol->rule_text, sizeof gol->rule_text, "%s", gol->universe.rule.name);
 
     Image bolus_png = LoadImageFromMemory(".png", bolus_data, bolus_size);
     gol->bolus = LoadTextureFromImage(bolus_png);
     UnloadImage(bolus_png);
+    gol->render = render_new();
 
     gol->state = GameState_Paused;
     gol->theme = GOLTheme_Default;
     gol->prev_theme = -1;
     gol->speed_slider_value = GOL_SPEED_SLIDER_MAX - GOL_DEFAULT_UPDATE_CAP;
+    gol->soup_density = GOL_DEFAULT_SOUP_DENSITY;
+    gol->step_budget = GOL_DEFAULT_STEP_BUDGET;
+    gol->history_budget = GOL_DEFAULT_HISTORY_BUDGET;
+    gol->history = history_new(GOL_HISTORY_BUDGETS[gol->history_budget]);
+    gol->cycle_action = GolCycleAction_Pause;
+    gol->sim = gol_sim_alloc(gol_sim_tick, gol);
 
     return gol;
 }
 
 void gol_free(GameOfLife* ptr) {
+    gol_sim_free(ptr->sim);
+    stats_log_stop(&(ptr->stats_log));
+    snapshot_writer_deinit(&(ptr->snapshot_writer));
+    history_deinit(&(ptr->history));
+    free(ptr->rewind_frame.words);
     UnloadTexture(ptr->bolus);
+    render_deinit(&(ptr->render));
     universe_deinit(&(ptr->universe));
+    census_free(ptr->census);
+    census_scan_free(ptr->census_scan);
+    region_deinit(&(ptr->clipboard));
+    if (ptr->hashlife) hashlife_free(ptr->hashlife);
+    if (ptr->sparse) sparse_free(ptr->sparse);
+    if (ptr->mapped) {
+        if (ptr->engine_dirty) mapped_load_universe(ptr->mapped, &(ptr->universe));
+        mapped_close(ptr->mapped);
+    }
     free(ptr);
 }
 
+/// Step every engine with `rule` from now on.
+void gol_set_rule(GameOfLife* gol, const GolRule* rule) {
+    gol->universe.rule = *rule;
+    if (gol->hashlife) hashlife_set_rule(gol->hashlife, rule);
+    if (gol->sparse) sparse_set_rule(gol->sparse, rule);
+    if (gol->mapped) mapped_set_rule(gol->mapped, rule);
+    cycle_reset(&(gol->cycle));
+    snprintf(gol->rule_text, sizeof gol->rule_text, "%s", rule->name);
+}
+
+void gol_set_engine(GameOfLife* gol, GolEngine engine) {
+    if (engine == gol->engine) return;
+
+    gol_refresh_view(gol);
+    // the universe already holds the visible cells of the old engine
+    switch (gol->engine) {
+    case GolEngine_Hashlife: {
+        hashlife_free(gol->hashlife);
+        gol->hashlife = NULL;
+    } break;
+    case GolEngine_Sparse: {
+        sparse_free(gol->sparse);
+        gol->sparse = NULL;
+    } break;
+    case GolEngine_Mapped: {
+        // what was drawn since the last step is kept with the world
+        if (gol->engine_dirty) mapped_load_universe(gol->mapped, &(gol->universe));
+        mapped_close(gol->mapped);
+        gol->mapped = NULL;
+    } break;
+    default: {}
+    }
+
+    switch (engine) {
+    case GolEngine_Hashlife: {
+        gol->hashlife = hashlife_alloc();
+        hashlife_set_rule(gol->hashlife, &(gol->universe.rule));
+        hashlife_load_universe(gol->hashlife, &(gol->universe));
+    } break;
+    case GolEngine_Sparse: {
+        gol->sparse = sparse_alloc();
+        sparse_set_rule(gol->sparse, &(gol->universe.rule));
+        sparse_load_universe(gol->sparse, &(gol->universe));
+    } break;
+    case GolEngine_Mapped: {
+        // a world from before goes on where it was left, a new one starts as the view
+        gol->mapped = mapped_open(MAPPED_DEFAULT_PATH, MAPPED_DEFAULT_SIZE, MAPPED_DEFAULT_SIZE, &(gol->universe.rule));
+        if (!(gol->mapped)) {
+            TraceLog(LOG_WARNING, "Opening the world %s failed: %s", MAPPED_DEFAULT_PATH, strerror(errno));
+            engine = GolEngine_Universe;
+            break;
+        }
+        universe_set_threads(&(gol->mapped->universe), universe_threads(&(gol->universe)));
+        if (!(gol->mapped->created)) {
+            gol_set_rule(gol, &(gol->mapped->universe.rule));
+            gol->universe.edge = gol->mapped->universe.edge;
+            mapped_store_universe(gol->mapped, &(gol->universe));
+        }
+        else {
+            mapped_set_edge(gol->mapped, gol->universe.edge);
+            mapped_load_universe(gol->mapped, &(gol->universe));
+        }
+    } break;
+    default: {}
+    }
+
+    gol->engine = engine;
+    gol->engine_dirty = false;
+    cycle_reset(&(gol->cycle));
+}
+
+/// Move the view of the file-backed world by `dx`, `dy` cells.
+void gol_move_view(GameOfLife* gol, int64_t dx, int64_t dy) {
+    MappedLife* ml = gol->mapped;
+    if (!ml) return;
+
+    if (gol->engine_dirty) mapped_load_universe(ml, &(gol->universe));
+    gol->engine_dirty = false;
+    mapped_move_view(ml, (int64_t)(ml->view_x) + dx, (int64_t)(ml->view_y) + dy);
+    gol->view_stale = true;
+    gol_refresh_view(gol);
+    cycle_reset(&(gol->cycle));
+}
+
+/// Fill the view with a random soup, with a new seed or the last one.
+void gol_fill_soup(GameOfLife* gol, bool new_seed) {
+    if (new_seed) {
+        gol->soup_seed = ((uint64_t)GetRandomValue(0, INT_MAX) << 32) ^ (uint64_t)GetRandomValue(0, INT_MAX);
+    }
+    universe_fill_random(&(gol->universe), gol->soup_seed, gol->soup_density);
+    gol->engine_dirty = true;
+}
+
+/// Replace the world with the pattern in the file at `path`, which takes the rule of the file along.
+/// RLE and plaintext patterns are centred in the view, Macrocell files put their origin
+/// at the top left corner of the view.
+bool gol_load_pattern(GameOfLife* gol, const char* path) {
+    PatternTarget target = {
+        .centre_x = (int64_t)(gol->universe.width / 2),
+        .centre_y = (int64_t)(gol->universe.height / 2),
+    };
+    PatternInfo info;
+
+    universe_fill(&(gol->universe), Dead);
+    switch (gol->engine) {
+    case GolEngine_Universe: target.universe = &(gol->universe); break;
+    case GolEngine_Hashlife: target.hashlife = gol->hashlife; break;
+    case GolEngine_Sparse: {
+        sparse_clear(gol->sparse);
+        target.sparse = gol->sparse;
+    } break;
+    // the view of the world gets the pattern, like with a soup
+    case GolEngine_Mapped: target.universe = &(gol->universe); break;
+    default: {}
+    }
+
+    bool ok = pattern_load(path, &target, &info);
+    if (info.has_rule) gol_set_rule(gol, &(info.rule));
+    gol->iterations = 0;
+
+    // the other engines got the pattern directly
+    gol->engine_dirty = gol->engine == GolEngine_Mapped;
+    cycle_reset(&(gol->cycle));
+    gol->view_stale = (gol->engine != GolEngine_Universe);
+    gol_refresh_view(gol);
+
+    if (!ok) TraceLog(LOG_WARNING, "Loading the %s pattern %s failed", PATTERN_FORMAT_NAMES[info.format], path);
+    return ok;
+}
+
+/// Save the world to a new file in the working directory, as Macrocell with the hashlife
+/// engine (the whole world) and as RLE or plaintext otherwise (the view).
+bool gol_save_pattern(GameOfLife* gol, PatternFormat format) {
+    static const char* EXTENSIONS[] = {
+        [PatternFormat_RLE] = "rle",
+        [PatternFormat_Cells] = "cells",
+        [PatternFormat_Macrocell] = "mc",
+    };
+    if (format == PatternFormat_Macrocell && gol->engine != GolEngine_Hashlife) format = PatternFormat_RLE;
+
+    const char* path = TextFormat("multisim-%lld.%s", (long long)time(NULL), EXTENSIONS[format]);
+    bool ok = false;
+
+    switch (format) {
+    case PatternFormat_Macrocell: {
+        if (gol->engine_dirty) {
+            hashlife_load_universe(gol->hashlife, &(gol->universe));
+            gol->engine_dirty = false;
+        }
+        ok = pattern_save_mc(path, gol->hashlife);
+    } break;
+    case PatternFormat_RLE:
+    case PatternFormat_Cells: {
+        gol_refresh_view(gol);
+        ok = (format == PatternFormat_RLE) ?
+            pattern_save_rle(path, &(gol->universe)) :
+            pattern_save_cells(path, &(gol->universe));
+    } break;
+    default: {}
+    }
+
+    if (!ok) TraceLog(LOG_WARNING, "Saving the pattern to %s failed", path);
+    return ok;
+}
+
+/// Save the view, the generation, the rule, the edge mode and the theme to a new snapshot
+/// in the working directory. Only copying the cells holds the UI, the file is written in the background.
+/// With the hashlife and sparse engines that is only the whole world while no cell lives outside
+/// the view, otherwise nothing is saved. The file-backed world is kept in its own file.
+bool gol_save_snapshot(GameOfLife* gol) {
+    SnapshotWriter* w = &(gol->snapshot_writer);
+    if (snapshot_writer_busy(w)) {
+        TraceLog(LOG_WARNING, "Still writing the snapshot %s", w->path);
+        return false;
+    }
+    if (gol->engine == GolEngine_Mapped) {
+        TraceLog(LOG_WARNING, "The file-backed world is saved in %s, a snapshot would only hold the view", MAPPED_DEFAULT_PATH);
+        return false;
+    }
+    snapshot_writer_wait(w);
+
+    gol_refresh_view(gol);
+    gol_frame_store(&(w->snap.cells), &(gol->universe));
+
+    // an engine that still has to take in the edited view holds nothing else
+    uint64_t world = 0;
+    if (!(gol->engine_dirty)) {
+        switch (gol->engine) {
+        case GolEngine_Hashlife: world = gol->hashlife->root->population; break;
+        case GolEngine_Sparse: world = sparse_population(gol->sparse); break;
+        default: {}
+        }
+    }
+    if (world > gol_frame_stats(&(w->snap.cells)).population) {
+        TraceLog(
+            LOG_WARNING, "Not saving a snapshot: the %s world has cells outside the view%s",
+            GOL_ENGINE_NAMES[gol->engine], (gol->engine == GolEngine_Hashlife) ? ", save it as Macrocell with [S]" : ""
+        );
+        return false;
+    }
+    w->snap.iterations = gol->iterations;
+    w->snap.birth = gol->universe.rule.birth;
+    w->snap.survive = gol->universe.rule.survive;
+    w->snap.edge = (uint8_t)gol->universe.edge;
+    w->snap.theme = (uint8_t)gol->theme;
+
+    snprintf(gol->snapshot_path, sizeof gol->snapshot_path, "multisim-%lld.gol", (long long)time(NULL));
+    return snapshot_writer_start(w, gol->snapshot_path);
+}
+
+/// Replace the game with the snapshot at `path`. The universe grows to hold the snapshot if needed.
+bool gol_load_snapshot(GameOfLife* gol, const char* path) {
+    GolSnapshot snap;
+    if (!snapshot_read(path, &snap)) {
+        TraceLog(LOG_WARNING, "Loading the snapshot %s failed", path);
+        return false;
+    }
+
+    universe_resize(&(gol->universe), snap.cells.width, snap.cells.height);
+    gol_frame_load(&(snap.cells), &(gol->universe));
+    gol->engine_dirty = true;
+    gol->view_stale = false;
+    gol->iterations = snap.iterations;
+
+    // B0 rules are not supported, see `rule_parse`
+    if (!(snap.birth & 1)) {
+        GolRule rule = rule_new(snap.birth, snap.survive);
+        gol_set_rule(gol, &rule);
+    }
+    if (snap.edge <= UniverseEdge_Wrap) gol->universe.edge = (UniverseEdge)snap.edge;
+    if (snap.theme <= GOLTheme_Bolus) gol->theme = (Theme)snap.theme;
+
+    snapshot_deinit(&snap);
+    return true;
+}
+
+/// Show entry `i` of the history, 0 being the oldest one, and pause there.
+/// Running again forgets the entries after it and goes on counting from its generation.
+void gol_rewind(GameOfLife* gol, size_t i) {
+    size_t count = history_count(&(gol->history));
+    if (count == 0) return;
+    i = min(i, count - 1);
+
+    if (gol->state == GameState_Running) gol_state_toggle(gol);
+    if (!history_restore(&(gol->history), i, &(gol->rewind_frame))) return;
+
+    gol_frame_load(&(gol->rewind_frame), &(gol->universe));
+    gol->iterations = gol->rewind_frame.iterations;
+    gol->engine_dirty = true;
+    gol->view_stale = false;
+    gol->rewound = (i + 1 < count);
+    gol->rewound_to = i;
+}
+
+/// Set a single cell of the view, and of the world behind it.
+static inline void gol_set_cell(GameOfLife* gol, size_t x, size_t y, Cell to) {
+    universe_set(&(gol->universe), x, y, to);
+    cycle_reset(&(gol->cycle));
+
+    switch (gol->engine) {
+    case GolEngine_Hashlife: hashlife_set(gol->hashlife, (int64_t)x, (int64_t)y, to); break;
+    case GolEngine_Sparse: sparse_set(gol->sparse, (int64_t)x, (int64_t)y, to); break;
+    case GolEngine_Mapped: mapped_set(gol->mapped, x, y, to); break;
+    default: {}
+    }
+}
+
+/// Give the engine the `w` x `h` cells of the view at (x, y), after an edit of just those.
+/// The other engines hold more than the view, which loading it whole would wipe out.
+static void gol_set_cells(GameOfLife* gol, size_t x, size_t y, size_t w, size_t h) {
+    cycle_reset(&(gol->cycle));
+    // the engine takes the whole view at the next step anyway
+    if (gol->engine == GolEngine_Universe || gol->engine_dirty) return;
+    if (!region_clip(&(gol->universe), x, y, &w, &h)) return;
+
+    for (size_t j = y; j < y + h; j++) {
+        for (size_t i = x; i < x + w; i++) {
+            Cell to = universe_get(&(gol->universe), i, j);
+            switch (gol->engine) {
+            case GolEngine_Hashlife: {
+                if (hashlife_get(gol->hashlife, (int64_t)i, (int64_t)j) != to) hashlife_set(gol->hashlife, (int64_t)i, (int64_t)j, to);
+            } break;
+            case GolEngine_Sparse: {
+                if (sparse_get(gol->sparse, (int64_t)i, (int64_t)j) != to) sparse_set(gol->sparse, (int64_t)i, (int64_t)j, to);
+            } break;
+            case GolEngine_Mapped: mapped_set(gol->mapped, i, j, to); break;
+            default: {}
+            }
+        }
+    }
+}
+
+/// Generations the universe and file-backed engines step at once. Temporal blocking only
+/// pays off when nothing looks at the generations in between: in turbo mode on the bit-packed
+/// backend, without cycle detection or a statistics log, which need every generation.
+/// The file-backed world is always bit-packed and has neither.
+static size_t gol_pass_generations(const GameOfLife* gol) {
+    bool blocking = GOL_TURBO_STEPS[gol->turbo] && (
+        gol->engine == GolEngine_Mapped || (
+            gol->universe.backend == UniverseBackend_Packed &&
+            gol->cycle_action == GolCycleAction_Off &&
+            !stats_log_active(&(gol->stats_log))
+        )
+    );
+    return blocking ? GOL_PASS_GENERATIONS[gol->pass_generations] : 1;
+}
+
+/// Count the objects in the view by what they are, into `census_text`.
+void gol_census(GameOfLife* gol) {
+    if (!(gol->census)) gol->census = census_alloc();
+    if (!(gol->census_scan)) gol->census_scan = census_scan_alloc();
+    if (!(gol->census) || !(gol->census_scan)) return;
+
+    gol_refresh_view(gol);
+    const Universe* uvs = &(gol->universe);
+    CensusSource src = {
+        .packed = (uvs->backend == UniverseBackend_Packed) ? &(uvs->packed) : NULL,
+        .universe = uvs,
+        .width = uvs->width,
+        .height = uvs->height,
+    };
+
+    double start = GetTime();
+    census_clear(gol->census);
+    census_scan(gol->census_scan, &src, uvs->pool);
+    census_count(gol->census, gol->census_scan, &(uvs->rule));
+    double elapsed = GetTime() - start;
+
+    CensusClass top[GOL_CENSUS_SHOWN];
+    size_t shown = census_top(gol->census, top, GOL_CENSUS_SHOWN);
+    int len = snprintf(
+        gol->census_text, sizeof gol->census_text, "%zu objects in %.1f ms",
+        gol->census_scan->object_count, elapsed * 1000.0
+    );
+    for (size_t i = 0; i < shown && len > 0 && (size_t)len < sizeof gol->census_text; i++) {
+        char label[64];
+        census_label(top + i, label, sizeof label);
+        len += snprintf(
+            gol->census_text + len, sizeof gol->census_text - (size_t)len, "%s %llu %s",
+            i ? "," : ":", (unsigned long long)top[i].count, label
+        );
+    }
+    if (len > 0 && (size_t)len < sizeof gol->census_text && (gol->census->unsettled || gol->census->large)) {
+        snprintf(
+            gol->census_text + len, sizeof gol->census_text - (size_t)len, ", %llu unsettled, %llu large",
+            (unsigned long long)gol->census->unsettled, (unsigned long long)gol->census->large
+        );
+    }
+}
+
+/// Select the `w` x `h` cells at (x, y), as much of them as lies in the view.
+static void gol_select(GameOfLife* gol, size_t x, size_t y, size_t w, size_t h) {
+    gol->selection = region_clip(&(gol->universe), x, y, &w, &h);
+    gol->selection_x = x;
+    gol->selection_y = y;
+    gol->selection_width = w;
+    gol->selection_height = h;
+}
+
+/// Kill the selected cells.
+void gol_clear_selection(GameOfLife* gol) {
+    if (!(gol->selection)) return;
+
+    gol_refresh_view(gol);
+    region_fill(&(gol->universe), gol->selection_x, gol->selection_y, gol->selection_width, gol->selection_height, Dead);
+    gol_set_cells(gol, gol->selection_x, gol->selection_y, gol->selection_width, gol->selection_height);
+}
+
+/// Copy the selected cells to the clipboard, and kill them when `cut`.
+void gol_copy_selection(GameOfLife* gol, bool cut) {
+    if (!(gol->selection)) return;
+
+    gol_refresh_view(gol);
+    region_copy(
+        &(gol->clipboard), &(gol->universe),
+        gol->selection_x, gol->selection_y, gol->selection_width, gol->selection_height
+    );
+    if (cut) gol_clear_selection(gol);
+}
+
+/// Paste the clipboard with its top left corner at (x, y) and select it.
+void gol_paste(GameOfLife* gol, size_t x, size_t y) {
+    if (region_empty(&(gol->clipboard))) return;
+
+    gol_refresh_view(gol);
+    region_paste(&(gol->clipboard), &(gol->universe), x, y);
+    gol_set_cells(gol, x, y, gol->clipboard.width, gol->clipboard.height);
+    gol_select(gol, x, y, gol->clipboard.width, gol->clipboard.height);
+}
+
+/// Move the selected cells to (x, y), the cells they leave are dead.
+void gol_move_selection(GameOfLife* gol, size_t x, size_t y) {
+    if (!(gol->selection)) return;
+
+    GolRegion moved = {0};
+    gol_refresh_view(gol);
+    region_copy(&moved, &(gol->universe), gol->selection_x, gol->selection_y, gol->selection_width, gol->selection_height);
+    gol_clear_selection(gol);
+    region_paste(&moved, &(gol->universe), x, y);
+    gol_set_cells(gol, x, y, moved.width, moved.height);
+    gol_select(gol, x, y, moved.width, moved.height);
+    region_deinit(&moved);
+}
+
+/// Rotate or mirror the selected cells in place, about their top left corner, with
+/// `region_rotate`, `region_flip_x` or `region_flip_y`. Without a selection, the clipboard.
+void gol_transform_selection(GameOfLife* gol, void (*transform)(GolRegion*)) {
+    if (!(gol->selection)) {
+        transform(&(gol->clipboard));
+        return;
+    }
+
+    GolRegion cells = {0};
+    gol_refresh_view(gol);
+    region_copy(&cells, &(gol->universe), gol->selection_x, gol->selection_y, gol->selection_width, gol->selection_height);
+    transform(&cells);
+    gol_clear_selection(gol);
+    region_paste(&cells, &(gol->universe), gol->selection_x, gol->selection_y);
+    gol_set_cells(gol, gol->selection_x, gol->selection_y, cells.width, cells.height);
+    gol_select(gol, gol->selection_x, gol->selection_y, cells.width, cells.height);
+    region_deinit(&cells);
+}
+
+/// Advance the active engine by one step, the view is refreshed by `gol_refresh_view`.
+static void gol_step(GameOfLife* gol) {
+    switch (gol->engine) {
+    case GolEngine_Universe: {
+        bool detect = gol->cycle_action != GolCycleAction_Off;
+        if (gol->engine_dirty || !detect) cycle_reset(&(gol->cycle));
+        // stepping only keeps the hash up to date, after anything else it takes a full one
+        if (detect && gol->cycle.count == 0) {
+            gol->universe.hash = universe_hash(&(gol->universe));
+            cycle_push(&(gol->cycle), gol->universe.hash);
+        }
+        gol->universe.hashing = detect;
+
+        size_t k = gol_pass_generations(gol);
+        universe_update_generations(&(gol->universe), k);
+        gol->iterations += k;
+        if (detect) cycle_push(&(gol->cycle), gol->universe.hash);
+        if (stats_log_active(&(gol->stats_log))) stats_log_push(&(gol->stats_log), gol->iterations, &(gol->universe.stats));
+    } break;
+    case GolEngine_Hashlife: {
+        if (gol->engine_dirty) hashlife_load_universe(gol->hashlife, &(gol->universe));
+
+        hashlife_step(gol->hashlife, gol->hashlife_step_log2);
+        gol->iterations += UINT64_C(1) << gol->hashlife_step_log2;
+        gol->view_stale = true;
+    } break;
+    case GolEngine_Sparse: {
+        if (gol->engine_dirty) sparse_load_universe(gol->sparse, &(gol->universe));
+
+        sparse_step(gol->sparse);
+        gol->iterations += 1;
+        gol->view_stale = true;
+    } break;
+    case GolEngine_Mapped: {
+        MappedLife* ml = gol->mapped;
+        if (gol->engine_dirty) mapped_load_universe(ml, &(gol->universe));
+        if (ml->universe.edge != gol->universe.edge) mapped_set_edge(ml, gol->universe.edge);
+        universe_set_threads(&(ml->universe), universe_threads(&(gol->universe)));
+
+        size_t k = gol_pass_generations(gol);
+        mapped_step(ml, k);
+        gol->iterations += k;
+        gol->view_stale = true;
+    } break;
+    default: {}
+    }
+    gol->engine_dirty = false;
+}
+
+/// The simulation thread found a repetition and waits for the UI to pause the game.
+static inline bool gol_cycle_waiting(const GameOfLife* gol) {
+    return gol->cycle_action == GolCycleAction_Pause && gol->cycle.found != gol->cycles_seen;
+}
+
+/// Every generation after a repetition is known, so fast-forwarding advances the
+/// counter by whole periods instead of stepping, which keeps the view on the same phase.
+static inline bool gol_cycle_skipping(const GameOfLife* gol) {
+    return gol->cycle_action == GolCycleAction_FastForward && gol->cycle.period != 0;
+}
+
+/// Step as many generations as the speed slider asks for since the last frame, at most for
+/// the step budget [G]. With the slider at full speed or in turbo mode, that is as many as fit.
+/// Returns whether the view was refreshed, which in turbo mode is only every so many generations.
+static bool gol_run_steps(GameOfLife* gol, float dt) {
+    const double start = GetTime();
+    const uint32_t turbo_steps = GOL_TURBO_STEPS[gol->turbo];
+    const float interval = turbo_steps ? 0.0f : gol->update_frame_cap;
+    const float step_budget = GOL_STEP_BUDGETS[gol->step_budget];
+    const float budget = turbo_steps ? max(step_budget, GOL_TURBO_STEP_BUDGET) : step_budget;
+    bool refreshed = !turbo_steps;
+
+    gol->step_accumulator += dt;
+    while (gol->step_accumulator >= interval && !gol_cycle_waiting(gol)) {
+        gol_step(gol);
+        gol->step_accumulator -= interval;
+
+        if (turbo_steps && ++(gol->turbo_steps_since_view) >= turbo_steps) {
+            gol_refresh_view(gol);
+            refreshed = true;
+        }
+
+        if (GetTime() - start >= budget) {
+            // the steps can't keep up, drop what is owed instead of stalling later frames
+            gol->step_accumulator = 0.0f;
+            break;
+        }
+    }
+    if (!turbo_steps) gol_refresh_view(gol);
+    return refreshed;
+}
+
+/// Measure the generations per second shown in the status bar.
+static void gol_count_gens(GameOfLife* gol, uint64_t gens, float dt) {
+    gol->gens_window += gens;
+    gol->gens_window_time += dt;
+
+    if (gol->gens_window_time >= GOL_GENS_PER_SEC_WINDOW) {
+        gol->gens_per_sec = (double)(gol->gens_window) / gol->gens_window_time;
+        gol->gens_window = 0;
+        gol->gens_window_time = 0.0f;
+    }
+}
+
+/// Publish the view as the newest frame, from whichever thread owns the world.
+/// Hand the view to the UI, and to the history if `record`.
+static void gol_publish_frame(GameOfLife* gol, bool record) {
+    GolFrame* frame = gol_triple_back(&(gol->sim->frames));
+
+    gol_frame_store(frame, &(gol->universe));
+    frame->iterations = gol->iterations;
+    frame->gens_per_sec = gol->gens_per_sec;
+    frame->period = (gol->engine == GolEngine_Universe) ? gol->cycle.period : 0;
+    frame->cycles_found = gol->cycle.found;
+    // the kernel counts as it steps, anything else is counted from the frame
+    bool counted = gol->engine == GolEngine_Universe && gol->universe.counted;
+    frame->stats = counted ? gol->universe.stats : gol_frame_stats(frame);
+    if (record) history_record(&(gol->history), frame);
+    gol_triple_publish(&(gol->sim->frames));
+}
+
+static void gol_apply_command(GameOfLife* gol, const GolCommand* cmd) {
+    switch (cmd->type) {
+    case GolCommand_SetCell: gol_set_cell(gol, cmd->x, cmd->y, cmd->cell); break;
+    }
+}
+
+/// GolSimTick of the simulation thread.
+static void gol_sim_tick(void* ctx) {
+    GameOfLife* gol = (GameOfLife*)ctx;
+    GolCommand cmd;
+    bool edited = false;
+
+    while (gol_command_pop(&(gol->sim->commands), &cmd)) {
+        gol_apply_command(gol, &cmd);
+        edited = true;
+    }
+
+    double now = GetTime();
+    float dt = (float)(now - gol->sim_last_time);
+    gol->sim_last_time = now;
+
+    uint64_t iterations = gol->iterations;
+    if (gol_cycle_skipping(gol)) {
+        gol->step_accumulator += dt;
+        uint64_t periods = (uint64_t)(gol->step_accumulator * GOL_CYCLE_SKIP_PER_SEC);
+        gol->step_accumulator -= (float)periods / GOL_CYCLE_SKIP_PER_SEC;
+        gol->iterations += periods * gol->cycle.period;
+        gol_count_gens(gol, gol->iterations - iterations, dt);
+
+        // the view doesn't change, only the counter does
+        gol->cycle_publish_time += dt;
+        if (gol->cycle_publish_time >= GOL_CYCLE_PUBLISH_TIME) {
+            gol->cycle_publish_time = 0.0f;
+            gol_publish_frame(gol, false);
+        }
+        gol_sim_nap();
+        return;
+    }
+    bool refreshed = gol_run_steps(gol, dt);
+    gol_count_gens(gol, gol->iterations - iterations, dt);
+
+    // in turbo mode only every so many generations are handed on, for the universe as well:
+    // its view is always fresh, but copying it into the frame and the history is not free
+    bool stepped = gol->iterations != iterations;
+    if (stepped && refreshed) gol_publish_frame(gol, true);
+    else if (edited) gol_publish_frame(gol, false);
+    else if (!stepped) gol_sim_nap();
+}
+
+/// Take the world back from the simulation thread, to change it on the UI thread.
+static inline void gol_hold(GameOfLife* gol) {
+    gol_sim_stop(gol->sim);
+}
+
+/// Hand the world to the simulation thread, if the game runs.
+static void gol_resume(GameOfLife* gol) {
+    if (gol->state != GameState_Running || gol_sim_running(gol->sim)) return;
+
+    gol->sim_last_time = GetTime();
+    gol_sim_start(gol->sim);
+}
+
+/// Set a cell from the UI, through the simulation thread if it runs.
+static void gol_edit_cell(GameOfLife* gol, size_t x, size_t y, Cell to) {
+    GolCommand cmd = { .type = GolCommand_SetCell, .x = x, .y = y, .cell = to };
+
+    if (gol_sim_running(gol->sim) && gol_command_push(&(gol->sim->commands), cmd)) return;
+
+    // paused, or the queue is full
+    gol_hold(gol);
+    gol_apply_command(gol, &cmd);
+}
+
 bool gol_screen_size_changed(GameOfLife* gol) {
-    bool changed = global_state.screen_w != gol->window_width || global_state.screen_w != gol->window_height;
+    bool changed = global_state.screen_w != gol->window_width || global_state.screen_h != gol->window_height;
 
     gol->window_width = global_state.screen_w;
     gol->window_height = global_state.screen_h;
@@ -95,20 +902,32 @@ SelectedGame gol_update(GameOfLife* gol) {
     static ThemeStyle theme_style;
     // dt shit
     static bool mouse_left_down, mouse_right_down, show_help_window;
-    static float passed_time;
     static bool mouse_in_grid;
 
     dt = GetFrameTime();
-    passed_time = (passed_time >= gol->update_frame_cap) ? 0.0f : passed_time + dt;
 
     // handle window size
     size_changed = gol_screen_size_changed(gol);
 
+    // a window being dragged changes size every frame, the universe waits until it settles
     if (size_changed) {
+        gol->resize_pending = true;
+        gol->resize_wait = 0.0f;
+    }
+    else if (gol->resize_pending && (gol->resize_wait += dt) >= GOL_RESIZE_TIME_LIMIT) {
         int new_w = gol->window_width / GOL_SCALE;
         int new_h = (gol->window_height - GOL_STATUS_BAR_HEIGHT) / GOL_SCALE;
+        gol->resize_pending = false;
 
-        universe_resize(&(gol->universe), (size_t)new_w, (size_t)new_h);
+        // the universe only grows, so only hold the simulation when it does
+        if ((size_t)new_w > gol->universe.width || (size_t)new_h > gol->universe.height) {
+            gol_hold(gol);
+            universe_resize(&(gol->universe), (size_t)new_w, (size_t)new_h);
+            cycle_reset(&(gol->cycle));
+            // the engine knows the cells that just came into view
+            if (gol->engine != GolEngine_Universe) gol->view_stale = true;
+            gol_refresh_view(gol);
+        }
     }
 
     // handle mouse position
@@ -123,43 +942,200 @@ SelectedGame gol_update(GameOfLife* gol) {
     // handle the keys
     key = GetKeyPressed();
 
-    if (IsKeyDown(KEY_MINUS) || IsKeyDown(KEY_KP_SUBTRACT) || global_state.mouse_wheel_move < 0.0f) {
-        gol->update_frame_cap = Clamp(gol->update_frame_cap + GOL_DEFAULT_TIME_STEP, 0.0f, GOL_SPEED_SLIDER_MAX);
-        gol->speed_slider_value = GOL_SPEED_SLIDER_MAX - gol->update_frame_cap;
-    }
-    if (IsKeyDown(KEY_EQUAL) || IsKeyDown(KEY_KP_EQUAL) || global_state.mouse_wheel_move > 0.0f) {
-        gol->update_frame_cap = max(
-            0.0, gol->update_frame_cap - GOL_DEFAULT_TIME_STEP
-        );
-        gol->speed_slider_value = GOL_SPEED_SLIDER_MAX - gol->update_frame_cap;
+    // while editing the rule text box, the keys are typed into it
+    if (gol->rule_editing) key = 0;
+
+    if (!(gol->rule_editing)) {
+        if (IsKeyDown(KEY_MINUS) || IsKeyDown(KEY_KP_SUBTRACT) || global_state.mouse_wheel_move < 0.0f) {
+            gol->update_frame_cap = Clamp(gol->update_frame_cap + GOL_DEFAULT_TIME_STEP, 0.0f, GOL_SPEED_SLIDER_MAX);
+            gol->speed_slider_value = GOL_SPEED_SLIDER_MAX - gol->update_frame_cap;
+        }
+        if (IsKeyDown(KEY_EQUAL) || IsKeyDown(KEY_KP_EQUAL) || global_state.mouse_wheel_move > 0.0f) {
+            gol->update_frame_cap = max(
+                0.0, gol->update_frame_cap - GOL_DEFAULT_TIME_STEP
+            );
+            gol->speed_slider_value = GOL_SPEED_SLIDER_MAX - gol->update_frame_cap;
+        }
     }
 
+    // the keys change the world, which the UI can only do while it holds the simulation
+    if (key != 0) gol_hold(gol);
+    const bool shift = IsKeyDown(KEY_LEFT_SHIFT) || IsKeyDown(KEY_RIGHT_SHIFT);
+    const bool ctrl = IsKeyDown(KEY_LEFT_CONTROL) || IsKeyDown(KEY_RIGHT_CONTROL);
+    const size_t mouse_x = (size_t)(gol->mouse_pos.x), mouse_y = (size_t)(gol->mouse_pos.y);
+
     switch (key) {
     case 0: break;
     case KEY_C: {
+        if (ctrl) {
+            gol_copy_selection(gol, false);
+            break;
+        }
         universe_fill(&(gol->universe), Dead);
+        gol->engine_dirty = true;
     } break;
     case KEY_A: {
         universe_fill(&(gol->universe), Alive);
+        gol->engine_dirty = true;
     } break;
     case KEY_T: {
         gol->prev_theme = gol->theme;
         theme_cycle(&(gol->theme));
     } break;
     case KEY_I: {
+        gol_refresh_view(gol);
         universe_invert(&(gol->universe));
+        gol->engine_dirty = true;
     } break;
     case KEY_R: {
-        universe_fill_random(&(gol->universe));
+        if (ctrl) gol_transform_selection(gol, region_rotate);
+        else gol_fill_soup(gol, !shift);
+    } break;
+    case KEY_F: {
+        if (ctrl) gol_transform_selection(gol, shift ? region_flip_y : region_flip_x);
+    } break;
+    case KEY_V: {
+        if (ctrl) gol_paste(gol, mouse_x, mouse_y);
+    } break;
+    case KEY_DELETE: {
+        gol_clear_selection(gol);
+    } break;
+    case KEY_LEFT_BRACKET: {
+        gol->soup_density = max(gol->soup_density - GOL_SOUP_DENSITY_STEP, GOL_SOUP_DENSITY_STEP);
+    } break;
+    case KEY_RIGHT_BRACKET: {
+        gol->soup_density = min(gol->soup_density + GOL_SOUP_DENSITY_STEP, 1.0f - GOL_SOUP_DENSITY_STEP);
     } break;
     case KEY_B: {
         gol->prev_theme = gol->theme;
         theme_toggle_bolus(&(gol->theme));
     } break;
+    case KEY_P: {
+        universe_set_backend(
+            &(gol->universe),
+            (gol->universe.backend == UniverseBackend_Packed) ? UniverseBackend_Bytes : UniverseBackend_Packed
+        );
+    } break;
+    case KEY_K: {
+        gol->universe.kernel = (gol->universe.kernel + 1) % UniverseKernel_Count;
+    } break;
+    case KEY_W: {
+        gol->universe.edge = (gol->universe.edge == UniverseEdge_Wrap) ? UniverseEdge_Dead : UniverseEdge_Wrap;
+        cycle_reset(&(gol->cycle));
+    } break;
+    case KEY_O: {
+        gol->cycle_action = (gol->cycle_action + 1) % GolCycleAction_Count;
+    } break;
+    case KEY_M: {
+        if (ctrl) {
+            gol_move_selection(gol, mouse_x, mouse_y);
+            break;
+        }
+        size_t threads = universe_threads(&(gol->universe));
+        size_t hardware = gol_pool_hardware_threads();
+        universe_set_threads(&(gol->universe), (threads >= hardware) ? 1 : min(threads * 2, hardware));
+    } break;
+    case KEY_X: {
+        if (ctrl) {
+            gol_copy_selection(gol, true);
+            break;
+        }
+        gol->turbo = (gol->turbo + 1) % GOL_TURBO_STEPS_COUNT;
+        gol_refresh_view(gol);
+    } break;
+    case KEY_J: {
+        gol->pass_generations = (gol->pass_generations + 1) % GOL_PASS_GENERATIONS_COUNT;
+    } break;
+    case KEY_E: {
+        gol_set_engine(gol, (gol->engine + 1) % GolEngine_Count);
+    } break;
+    case KEY_U: {
+        GolRule rule;
+        gol->rule_preset = (gol->rule_preset + 1) % RULE_PRESET_COUNT;
+        if (rule_parse(RULE_PRESETS[gol->rule_preset], &rule)) gol_set_rule(gol, &rule);
+    } break;
+    case KEY_N: {
+        gol_census(gol);
+    } break;
+    case KEY_S: {
+        gol_save_pattern(gol, shift ? PatternFormat_Cells : PatternFormat_Macrocell);
+    } break;
+    case KEY_LEFT: {
+        if (ctrl) {
+            if (gol->selection_x > 0) gol_move_selection(gol, gol->selection_x - 1, gol->selection_y);
+            break;
+        }
+        if (gol->mapped && shift) {
+            gol_move_view(gol, -(int64_t)(gol->universe.width / 2), 0);
+            break;
+        }
+        size_t shown = gol->rewound ? gol->rewound_to : history_count(&(gol->history)) - 1;
+        if (history_count(&(gol->history)) > 0 && shown > 0) gol_rewind(gol, shown - 1);
+    } break;
+    case KEY_RIGHT: {
+        if (ctrl) {
+            if (gol->selection_x + gol->selection_width < gol->universe.width) {
+                gol_move_selection(gol, gol->selection_x + 1, gol->selection_y);
+            }
+            break;
+        }
+        if (gol->mapped && shift) {
+            gol_move_view(gol, (int64_t)(gol->universe.width / 2), 0);
+            break;
+        }
+        if (gol->rewound) gol_rewind(gol, gol->rewound_to + 1);
+    } break;
+    case KEY_UP: {
+        if (ctrl) {
+            if (gol->selection_y > 0) gol_move_selection(gol, gol->selection_x, gol->selection_y - 1);
+            break;
+        }
+        if (shift) gol_move_view(gol, 0, -(int64_t)(gol->universe.height / 2));
+    } break;
+    case KEY_DOWN: {
+        if (ctrl) {
+            if (gol->selection_y + gol->selection_height < gol->universe.height) {
+                gol_move_selection(gol, gol->selection_x, gol->selection_y + 1);
+            }
+            break;
+        }
+        if (shift) gol_move_view(gol, 0, (int64_t)(gol->universe.height / 2));
+    } break;
+    case KEY_G: {
+        gol->step_budget = (gol->step_budget + 1) % GOL_STEP_BUDGETS_COUNT;
+    } break;
+    case KEY_H: {
+        gol->history_budget = (gol->history_budget + 1) % GOL_HISTORY_BUDGETS_COUNT;
+        history_set_budget(&(gol->history), GOL_HISTORY_BUDGETS[gol->history_budget]);
+        if (history_count(&(gol->history)) == 0) gol->rewound = false;
+    } break;
+    case KEY_PAGE_UP: {
+        gol->hashlife_step_log2 = min(gol->hashlife_step_log2 + 1, HASHLIFE_MAX_STEP_LOG2);
+    } break;
+    case KEY_PAGE_DOWN: {
+        gol->hashlife_step_log2 = max(gol->hashlife_step_log2 - 1, 0);
+    } break;
     case KEY_SPACE: {
         gol_state_toggle(gol);
     } break;
     case KEY_ESCAPE: return Selected_None;
+    case KEY_F2: {
+        gol_save_snapshot(gol);
+    } break;
+    case KEY_F3: {
+        if (gol->snapshot_path[0]) {
+            // the snapshot may still be on its way to the disk
+            snapshot_writer_wait(&(gol->snapshot_writer));
+            gol_load_snapshot(gol, gol->snapshot_path);
+        }
+    } break;
+    case KEY_F4: {
+        if (stats_log_active(&(gol->stats_log))) stats_log_stop(&(gol->stats_log));
+        else {
+            const char* path = TextFormat("multisim-stats-%lld.csv", (long long)time(NULL));
+            if (!stats_log_start(&(gol->stats_log), path)) TraceLog(LOG_WARNING, "Logging the statistics to %s failed", path);
+        }
+    } break;
     case KEY_F5: {
         global_state.show_fps = !global_state.show_fps;
     } break;
@@ -173,29 +1149,60 @@ SelectedGame gol_update(GameOfLife* gol) {
     default: {}
     }
 
+    if (IsFileDropped()) {
+        FilePathList files = LoadDroppedFiles();
+        gol_hold(gol);
+        if (files.count > 0) {
+            if (IsFileExtension(files.paths[0], ".gol")) gol_load_snapshot(gol, files.paths[0]);
+            else gol_load_pattern(gol, files.paths[0]);
+        }
+        UnloadDroppedFiles(files);
+    }
+
     if (gol->prev_theme != gol->theme) {
         theme_destructure(gol->theme, &theme_style);
         gol->prev_theme = gol->theme;
     }
 
-    switch (gol->state) {
-    case GameState_Running: {
-        if (passed_time >= gol->update_frame_cap) {
-            universe_update_cells(&(gol->universe));
-            passed_time = 0.0;
-            gol->iterations += 1;
+    // the simulation thread counts while running
+    if (gol->state == GameState_Paused) gol_count_gens(gol, 0, dt);
+
+    if (gol->selecting && !mouse_left_down) gol->selecting = false;
+
+    if (mouse_in_grid && !show_help_window) {
+        // with shift the mouse selects instead of drawing
+        if (shift && IsMouseButtonPressed(MOUSE_BUTTON_LEFT)) {
+            gol->selecting = true;
+            gol->selection_from_x = mouse_x;
+            gol->selection_from_y = mouse_y;
         }
-    } break;
-    case GameState_Paused: {
-        if ((!mouse_in_grid) || show_help_window) break;
-        if (mouse_left_down) {
-            universe_set(&(gol->universe), (size_t)(gol->mouse_pos.x), (size_t)(gol->mouse_pos.y), Alive);
+
+        if (gol->selecting) {
+            gol_select(
+                gol, min(gol->selection_from_x, mouse_x), min(gol->selection_from_y, mouse_y),
+                max(gol->selection_from_x, mouse_x) - min(gol->selection_from_x, mouse_x) + 1,
+                max(gol->selection_from_y, mouse_y) - min(gol->selection_from_y, mouse_y) + 1
+            );
+        }
+        else if (shift && mouse_right_down) {
+            gol->selection = false;
+        }
+        else if (mouse_left_down) {
+            gol_edit_cell(gol, mouse_x, mouse_y, Alive);
         }
         else if (mouse_right_down) {
-            universe_set(&(gol->universe), (size_t)(gol->mouse_pos.x), (size_t)(gol->mouse_pos.y), Dead);
+            gol_edit_cell(gol, mouse_x, mouse_y, Dead);
         }
     }
-    default: {}
+
+    if (!gol_sim_running(gol->sim)) gol_publish_frame(gol, false);
+    const GolFrame* frame = gol_triple_front(&(gol->sim->frames));
+
+    // a new repetition, which the simulation thread may be waiting on
+    if (frame->cycles_found != gol->cycles_seen) {
+        gol_hold(gol);
+        gol->cycles_seen = frame->cycles_found;
+        if (gol->cycle_action == GolCycleAction_Pause && gol->state == GameState_Running) gol_state_toggle(gol);
     }
 
     BeginDrawing();
@@ -203,19 +1210,20 @@ SelectedGame gol_update(GameOfLife* gol) {
 
     switch (gol->theme) {
     case GOLTheme_Midnight: {
+        if (render_draw(&(gol->render), frame, gol->theme, &theme_style)) break;
         Color midnight_fg_color = color(0, 0, 100);
-        for (uint32_t y = 0; y < gol->universe.height; y++) {
-            for (uint32_t x = 0; x < gol->universe.width; x++) {
+        for (uint32_t y = 0; y < frame->height; y++) {
+            for (uint32_t x = 0; x < frame->width; x++) {
                 DrawRectangle(
                     x * GOL_SCALE,
                     y * GOL_SCALE,
                     GOL_SCALE,
                     GOL_SCALE,
-                    universe_get(&(gol->universe), x, y) ?
+                    gol_frame_get(frame, x, y) ?
                     color(x, y, 100) :
                     theme_style.bg_color
                 );
-                if (universe_get(&(gol->universe), x, y)) {
+                if (gol_frame_get(frame, x, y)) {
                     midnight_fg_color.r = x;
                     midnight_fg_color.g = y;
                     DrawTextD(
@@ -239,9 +1247,9 @@ SelectedGame gol_update(GameOfLife* gol) {
         }
     } break;
     case GOLTheme_Bolus: {
-        for (uint32_t y = 0; y < gol->universe.height; y++) {
-            for (uint32_t x = 0; x < gol->universe.width; x++) {
-                if (universe_get(&(gol->universe), x, y)) {
+        for (uint32_t y = 0; y < frame->height; y++) {
+            for (uint32_t x = 0; x < frame->width; x++) {
+                if (gol_frame_get(frame, x, y)) {
                     DrawTextureEx(
                         gol->bolus,
                         vec2(x * GOL_SCALE, y * GOL_SCALE),
@@ -254,9 +1262,10 @@ SelectedGame gol_update(GameOfLife* gol) {
         }
     } break;
     default: {
-        for (uint32_t y = 0; y < gol->universe.height; y++) {
-            for (uint32_t x = 0; x < gol->universe.width; x++) {
-                bool alive = universe_get(&(gol->universe), x, y);
+        if (render_draw(&(gol->render), frame, gol->theme, &theme_style)) break;
+        for (uint32_t y = 0; y < frame->height; y++) {
+            for (uint32_t x = 0; x < frame->width; x++) {
+                bool alive = gol_frame_get(frame, x, y);
                 DrawTextD(
                     alive ? theme_style.fg_char : theme_style.bg_char,
                     x * GOL_SCALE,
@@ -283,7 +1292,10 @@ SelectedGame gol_update(GameOfLife* gol) {
     if (GuiButton(
         rect(slider_width + 70, icon_y, ICON_SIZE, ICON_SIZE),
         (gol->state == GameState_Paused) ? "#131#" : "#132#"
-    )) gol_state_toggle(gol);
+    )) {
+        gol_hold(gol);
+        gol_state_toggle(gol);
+    }
 
     GuiSliderPro(
         rect(ICON_PADDING + 65, icon_y + (14.25 / 2) - ICON_PADDING, slider_width, ICON_SIZE * 0.75),
@@ -297,7 +1309,11 @@ SelectedGame gol_update(GameOfLife* gol) {
 
     if (GuiButton(
         rect(icon_padding_x, icon_y, ICON_SIZE, ICON_SIZE), "#159#"
-    )) return Selected_None; // Leave
+    )) {
+        // don't simulate in the background
+        gol_hold(gol);
+        return Selected_None; // Leave
+    }
 
     if (GuiButton(
         rect(icon_padding_x -= ICON_SIZE, icon_y, ICON_SIZE, ICON_SIZE),
@@ -310,26 +1326,85 @@ SelectedGame gol_update(GameOfLife* gol) {
             icon_padding_x -= (ICON_SIZE - ICON_PADDING) * 2,
             icon_y, ICON_SIZE, ICON_SIZE
         ), "#29#"
-    )) universe_fill(&(gol->universe), Alive);
+    )) {
+        gol_hold(gol);
+        universe_fill(&(gol->universe), Alive);
+        gol->engine_dirty = true;
+    }
 
     if (GuiButton(
         rect(icon_padding_x -= ICON_SIZE - ICON_PADDING, icon_y, ICON_SIZE, ICON_SIZE), "#143#"
-    )) universe_fill(&(gol->universe), Dead);
+    )) {
+        gol_hold(gol);
+        universe_fill(&(gol->universe), Dead);
+        gol->engine_dirty = true;
+    }
 
     if (GuiButton(
         rect(icon_padding_x -= ICON_SIZE - ICON_PADDING, icon_y, ICON_SIZE, ICON_SIZE),
         "#194#"
-    )) universe_fill_random(&(gol->universe));
+    )) {
+        gol_hold(gol);
+        gol_fill_soup(gol, true);
+    }
     if (GuiButton(
         rect(icon_padding_x -= ICON_SIZE - ICON_PADDING, icon_y, ICON_SIZE, ICON_SIZE),
         "#26#"
     )) theme_cycle(&(gol->theme));
 
-    //snprintf(buffer, sizeof buffer, "%llu", gol->iterations); // NOTE: this might be useful later
-    //DrawTextD(buffer, icon_padding_x - 100, icon_y, 30.0, WHITE);
+    const int text_x = slider_width + 70 + ICON_SIZE + ICON_PADDING * 10;
+    DrawTextD(
+        gol->rewound ?
+            TextFormat("%zu BACK", history_count(&(gol->history)) - 1 - gol->rewound_to) :
+            TextFormat(
+                "gen %llu %s%.0f/s%s", (unsigned long long)frame->iterations,
+                GOL_TURBO_STEPS[gol->turbo] ? "TURBO " : "", frame->gens_per_sec,
+                (frame->period == 0) ? "" : (frame->period == 1) ? " STILL" : TextFormat(" P%u", frame->period)
+            ),
+        text_x, icon_y + ICON_PADDING * 2, 17.0f, theme_style.fg_color
+    );
+
+    const UniverseStats* stats = &(frame->stats);
+    DrawTextD(
+        TextFormat(
+            "pop %llu +%llu -%llu%s", (unsigned long long)stats->population,
+            (unsigned long long)stats->births, (unsigned long long)stats->deaths,
+            stats->population ?
+            TextFormat(" %zux%zu", stats->max_x - stats->min_x + 1, stats->max_y - stats->min_y + 1) : ""
+        ),
+        text_x, icon_y + ICON_SIZE / 2 + ICON_PADDING * 2, 17.0f, theme_style.fg_color
+    );
+
+    // the timeline of the history, dragging it rewinds
+    const int timeline_x = text_x + ICON_SIZE * 6;
+    const int timeline_width = icon_padding_x - ICON_PADDING * 10 - timeline_x;
+    size_t recorded = history_count(&(gol->history));
+    if (recorded > 1 && timeline_width > ICON_SIZE) {
+        size_t shown = gol->rewound ? gol->rewound_to : recorded - 1;
+        gol->timeline_value = (float)shown;
+        GuiSliderPro(
+            rect(timeline_x, icon_y + (14.25 / 2) - ICON_PADDING, timeline_width, ICON_SIZE * 0.75),
+            "", "", &(gol->timeline_value), 0.0f, (float)(recorded - 1), 8
+        );
+        size_t to = (size_t)roundf(Clamp(gol->timeline_value, 0.0f, (float)(recorded - 1)));
+        if (to != shown) {
+            gol_hold(gol);
+            gol_rewind(gol, to);
+        }
+    }
+
+    if (gol->selection) {
+        DrawRectangleLines(
+            gol->selection_x * GOL_SCALE,
+            gol->selection_y * GOL_SCALE,
+            gol->selection_width * GOL_SCALE,
+            gol->selection_height * GOL_SCALE,
+            theme_style.ac_color
+        );
+    }
 
     // draw the outline around the mouse selection
-    if (gol->state == GameState_Paused && mouse_in_grid) {
+    if (mouse_in_grid) {
         DrawRectangleLines(
             floorf(gol->mouse_pos.x) * GOL_SCALE,
             floorf(gol->mouse_pos.y) * GOL_SCALE,
@@ -363,8 +1438,11 @@ SelectedGame gol_update(GameOfLife* gol) {
 
         GuiButton(bounds, "#194#");
         bounds.x += padx;
-        bounds.width *= 10;
-        GuiLabel(bounds, "Fill the grid with random cells");
+        bounds.width *= 20;
+        GuiLabel(bounds, TextFormat(
+            "Fill the grid with random cells [R], again [Shift+R], density [ and ] (seed %llu, %d%% alive)",
+            (unsigned long long)gol->soup_seed, (int)roundf(gol->soup_density * 100.0f)
+        ));
     
         bounds = rect(bounds_win.x + padx, bounds_win.y + pady*3, ICON_SIZE, ICON_SIZE);
         
@@ -379,8 +1457,148 @@ SelectedGame gol_update(GameOfLife* gol) {
         bounds.x += padx;
         bounds.width *= 10;
         GuiLabel(bounds, "Fill the grid with all live cells");
+
+        bounds = rect(bounds_win.x + padx, bounds_win.y + pady*5, ICON_SIZE * 20, ICON_SIZE);
+        GuiLabel(bounds, TextFormat(
+            "[P] Toggle the cell storage (current: %s)",
+            UNIVERSE_BACKEND_NAMES[gol->universe.backend]
+        ));
+
+        bounds.y += pady;
+        GuiLabel(bounds, TextFormat(
+            "[K] Cycle the byte storage kernel (current: %s)",
+            (gol->universe.kernel == UniverseKernel_Rows) ?
+            TextFormat("%s row", SIMD_LEVEL_NAMES[gol->universe.simd]) :
+            UNIVERSE_KERNEL_NAMES[gol->universe.kernel]
+        ));
+
+        bounds.y += pady;
+        GuiLabel(bounds, TextFormat(
+            "[M] Cycle the simulation threads (current: %zu of %zu)",
+            universe_threads(&(gol->universe)), gol_pool_hardware_threads()
+        ));
+
+        bounds.y += pady;
+        GuiLabel(bounds, TextFormat(
+            "[W] Toggle what lies past the edges (current: %s)", UNIVERSE_EDGE_NAMES[gol->universe.edge]
+        ));
+
+        bounds.y += pady;
+        GuiLabel(bounds, TextFormat(
+            "[E] Cycle the engine (current: %s)", GOL_ENGINE_NAMES[gol->engine]
+        ));
+
+        if (gol->mapped) {
+            bounds.y += pady;
+            GuiLabel(bounds, TextFormat(
+                "[Shift+Arrows] Move the view over the %zu x %zu world in %s (current: %zu, %zu)",
+                gol->mapped->universe.width, gol->mapped->universe.height, MAPPED_DEFAULT_PATH,
+                gol->mapped->view_x, gol->mapped->view_y
+            ));
+        }
+
+        bounds.y += pady;
+        GuiLabel(bounds, TextFormat(
+            "[Shift+Drag] Select, [Shift+Right click] Drop the selection, [Del] Clear it (current: %s)",
+            gol->selection ?
+            TextFormat("%zu x %zu at %zu, %zu", gol->selection_width, gol->selection_height, gol->selection_x, gol->selection_y) :
+            "none"
+        ));
+
+        bounds.y += pady;
+        GuiLabel(bounds, TextFormat(
+            "[Ctrl+C/X/V] Copy, cut, paste at the mouse, [Ctrl+R] Rotate, [Ctrl+F] Flip ([Shift] up-down), "
+            "[Ctrl+Arrows] Move, [Ctrl+M] to the mouse (clipboard: %zu x %zu)",
+            gol->clipboard.width, gol->clipboard.height
+        ));
+
+        bounds.y += pady;
+        GuiLabel(bounds, TextFormat(
+            "[N] Count the objects in the view (last: %s)", gol->census_text[0] ? gol->census_text : "none"
+        ));
+
+        bounds.y += pady;
+        GuiLabel(bounds, TextFormat(
+            "[PgUp/PgDn] Generations per hashlife step (current: 2^%d)", gol->hashlife_step_log2
+        ));
+
+        bounds.y += pady;
+        GuiLabel(bounds, TextFormat(
+            "[X] Cycle turbo mode (current: %s)",
+            GOL_TURBO_STEPS[gol->turbo] ? TextFormat("view every %u generations", GOL_TURBO_STEPS[gol->turbo]) : "off"
+        ));
+
+        bounds.y += pady;
+        GuiLabel(bounds, TextFormat(
+            "[-/+] or the slider: speed, [G] Time every tick may step (current: %.0f ms%s)",
+            GOL_STEP_BUDGETS[gol->step_budget] * 1000.0f,
+            (GOL_TURBO_STEPS[gol->turbo] && GOL_STEP_BUDGETS[gol->step_budget] < GOL_TURBO_STEP_BUDGET) ?
+            TextFormat(", %.0f ms in turbo", GOL_TURBO_STEP_BUDGET * 1000.0f) : ""
+        ));
+
+        bounds.y += pady;
+        GuiLabel(bounds, TextFormat(
+            "[J] Generations per pass of temporal blocking (current: %zu%s)",
+            GOL_PASS_GENERATIONS[gol->pass_generations],
+            (GOL_PASS_GENERATIONS[gol->pass_generations] == gol_pass_generations(gol)) ? "" :
+            ", needs turbo, bit-packed storage and [O] off"
+        ));
+
+        bounds.y += pady;
+        GuiLabel(bounds, "Drop a .rle, .cells or .mc file to load it, [S] Save it ([Shift+S] as .cells)");
+
+        bounds.y += pady;
+        GuiLabel(bounds, TextFormat(
+            "[F2] Save a snapshot, [F3] load it again, or drop a .gol file (last: %s%s)",
+            gol->snapshot_path[0] ? gol->snapshot_path : "none",
+            snapshot_writer_busy(&(gol->snapshot_writer)) ? ", writing" : ""
+        ));
+
+        bounds.y += pady;
+        GuiLabel(bounds, TextFormat(
+            "[Left/Right] or the timeline: rewind, [H] History budget (current: %s, %zu frames)",
+            GOL_HISTORY_BUDGETS[gol->history_budget] ?
+            TextFormat("%zu MiB", GOL_HISTORY_BUDGETS[gol->history_budget] >> 20) : "off",
+            history_count(&(gol->history))
+        ));
+
+        bounds.y += pady;
+        GuiLabel(bounds, TextFormat(
+            "[F4] Stream the statistics of every universe generation to a CSV file (current: %s)",
+            stats_log_active(&(gol->stats_log)) ? gol->stats_log.path : "off"
+        ));
+
+        bounds.y += pady;
+        GuiLabel(bounds, TextFormat(
+            "[O] When the universe repeats a generation or dies out (current: %s)",
+            GOL_CYCLE_ACTION_NAMES[gol->cycle_action]
+        ));
+
+        bounds.y += pady;
+        GuiLabel(bounds, TextFormat("[U] Cycle the rule presets (current: %s)", gol->universe.rule.name));
+
+        bounds.y += pady;
+        Rectangle bounds_rule = rect(bounds.x, bounds.y, ICON_SIZE * 6, ICON_SIZE);
+        if (GuiTextBox(bounds_rule, gol->rule_text, sizeof gol->rule_text, gol->rule_editing)) {
+            if (gol->rule_editing) {
+                GolRule rule;
+                gol_hold(gol);
+                // keep the current rule when the text is not a valid one
+                if (rule_parse(gol->rule_text, &rule)) gol_set_rule(gol, &rule);
+                else snprintf(gol->rule_text, sizeof gol->rule_text, "%s", gol->universe.rule.name);
+            }
+            gol->rule_editing = !(gol->rule_editing);
+        }
+        bounds_rule.x += bounds_rule.width + ICON_PADDING;
+        bounds_rule.width = ICON_SIZE * 14;
+        GuiLabel(bounds_rule, "Type a rule like B36/S23 and press enter");
+    }
+    else if (gol->rule_editing) {
+        gol->rule_editing = false;
+        snprintf(gol->rule_text, sizeof gol->rule_text, "%s", gol->universe.rule.name);
     }
 
+    gol_resume(gol);
     return Selected_GOL;
 }
 
@@ -0,0 +1,651 @@
+#ifndef GOL_HASHLIFE_C_
+#define GOL_HASHLIFE_C_
+
+//! Hashlife: an unbounded universe stored as a quadtree of hash-consed nodes.
+//! Identical subtrees share one node, and the future of every node is memoised,
+//! so repetitive patterns advance 2^k generations in one `hashlife_step`.
+//! The world is centered on (0, 0), a root of level L spans [-2^(L-1), 2^(L-1)).
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cell.c"
+#include "universe.c"
+#include "../const.h"
+#include "../panic.h"
+
+// level 62 is the largest square that int64_t coordinates can address
+#define HASHLIFE_MAX_LEVEL 62
+#define HASHLIFE_MAX_STEP_LOG2 (HASHLIFE_MAX_LEVEL - 3)
+#define HASHLIFE_BLOCK_NODES 4096
+// collect unreachable nodes once this many are alive
+#define HASHLIFE_GC_NODES (1 << 21)
+
+typedef struct HashNode HashNode;
+
+struct HashNode {
+    // the four quadrants, NULL for the level 0 leaves
+    HashNode* nw;
+    HashNode* ne;
+    HashNode* sw;
+    HashNode* se;
+    /// memoised centre of this node, advanced 2^min(level - 2, step_log2) generations
+    HashNode* result;
+    /// next node in the same hash bucket, or in the free list
+    HashNode* chain;
+    uint64_t population;
+    uint32_t level;
+    uint32_t marked;
+};
+
+typedef struct HashNodeBlock {
+    struct HashNodeBlock* next;
+    HashNode nodes[HASHLIFE_BLOCK_NODES];
+} HashNodeBlock;
+
+typedef struct HashLife {
+    HashNode** buckets;
+    size_t bucket_count;
+    size_t node_count;
+
+    HashNodeBlock* blocks;
+    size_t block_used;
+    HashNode* free_list;
+
+    HashNode leaves[2];
+    /// canonical empty node per level, built on demand
+    HashNode* empty[HASHLIFE_MAX_LEVEL + 1];
+
+    HashNode* root;
+    GolRule rule;
+    /// the step every memoised `result` was computed for
+    int step_log2;
+    uint64_t generation;
+} HashLife;
+
+static inline size_t hashlife_hash(HashNode* nw, HashNode* ne, HashNode* sw, HashNode* se) {
+    uint64_t h = (uintptr_t)nw;
+    h = h * 0x9E3779B97F4A7C15ull + (uintptr_t)ne;
+    h = h * 0x9E3779B97F4A7C15ull + (uintptr_t)sw;
+    h = h * 0x9E3779B97F4A7C15ull + (uintptr_t)se;
+    return (size_t)(h ^ (h >> 29));
+}
+
+static void hashlife_rehash(HashLife* hl, size_t bucket_count) {
+    HashNode** buckets = (HashNode**)calloc(bucket_count, sizeof(HashNode*));
+    if (!buckets) {
+        panic("Allocation of the hashlife table failed");
+        return;
+    }
+
+    for (size_t i = 0; i < hl->bucket_count; i++) {
+        HashNode* n = hl->buckets[i];
+        while (n) {
+            HashNode* next = n->chain;
+            size_t b = hashlife_hash(n->nw, n->ne, n->sw, n->se) & (bucket_count - 1);
+            n->chain = buckets[b];
+            buckets[b] = n;
+            n = next;
+        }
+    }
+
+    free(hl->buckets);
+    hl->buckets = buckets;
+    hl->bucket_count = bucket_count;
+}
+
+static HashNode* hashlife_alloc_node(HashLife* hl) {
+    if (hl->free_list) {
+        HashNode* n = hl->free_list;
+        hl->free_list = n->chain;
+        return n;
+    }
+    if (!(hl->blocks) || hl->block_used == HASHLIFE_BLOCK_NODES) {
+        HashNodeBlock* block = (HashNodeBlock*)malloc(sizeof(HashNodeBlock));
+        if (!block) {
+            panic("Allocation of a hashlife node block failed");
+            return NULL;
+        }
+        block->next = hl->blocks;
+        hl->blocks = block;
+        hl->block_used = 0;
+    }
+    return &(hl->blocks->nodes[hl->block_used++]);
+}
+
+/// The unique node with these four quadrants.
+static HashNode* hashlife_node(HashLife* hl, HashNode* nw, HashNode* ne, HashNode* sw, HashNode* se) {
+    size_t b = hashlife_hash(nw, ne, sw, se) & (hl->bucket_count - 1);
+
+    for (HashNode* n = hl->buckets[b]; n; n = n->chain) {
+        if (n->nw == nw && n->ne == ne && n->sw == sw && n->se == se) return n;
+    }
+
+    HashNode* n = hashlife_alloc_node(hl);
+    n->nw = nw;
+    n->ne = ne;
+    n->sw = sw;
+    n->se = se;
+    n->result = NULL;
+    n->population = nw->population + ne->population + sw->population + se->population;
+    n->level = nw->level + 1;
+    n->marked = 0;
+    n->chain = hl->buckets[b];
+    hl->buckets[b] = n;
+
+    if (++(hl->node_count) > hl->bucket_count) {
+        hashlife_rehash(hl, hl->bucket_count * 2);
+    }
+    return n;
+}
+
+static HashNode* hashlife_empty(HashLife* hl, uint32_t level) {
+    if (!(hl->empty[level])) {
+        HashNode* e = hashlife_empty(hl, level - 1);
+        hl->empty[level] = hashlife_node(hl, e, e, e, e);
+    }
+    return hl->empty[level];
+}
+
+HashLife* hashlife_alloc(void) {
+    HashLife* hl = (HashLife*)calloc(1, sizeof(HashLife));
+    if (!hl) {
+        panic("Allocation of hashlife_alloc failed");
+        return NULL;
+    }
+
+    hl->bucket_count = 1 << 16;
+    hl->buckets = (HashNode**)calloc(hl->bucket_count, sizeof(HashNode*));
+    if (!(hl->buckets)) panic("Allocation of the hashlife table failed");
+
+    hl->rule = rule_conway();
+    hl->leaves[Dead].population = 0;
+    hl->leaves[Alive].population = 1;
+    hl->empty[0] = &(hl->leaves[Dead]);
+    hl->root = hashlife_empty(hl, 3);
+    return hl;
+}
+
+void hashlife_free(HashLife* hl) {
+    while (hl->blocks) {
+        HashNodeBlock* next = hl->blocks->next;
+        free(hl->blocks);
+        hl->blocks = next;
+    }
+    free(hl->buckets);
+    free(hl);
+}
+
+/* building blocks of the recursion, all return a node one level below their inputs' sum */
+
+static inline HashNode* hashlife_centre(HashLife* hl, HashNode* n) {
+    return hashlife_node(hl, n->nw->se, n->ne->sw, n->sw->ne, n->se->nw);
+}
+
+static inline HashNode* hashlife_centre_h(HashLife* hl, HashNode* w, HashNode* e) {
+    return hashlife_node(hl, w->ne, e->nw, w->se, e->sw);
+}
+
+static inline HashNode* hashlife_centre_v(HashLife* hl, HashNode* n, HashNode* s) {
+    return hashlife_node(hl, n->sw, n->se, s->nw, s->ne);
+}
+
+/// One generation of the centre 2x2 of a level 2 node.
+static HashNode* hashlife_base(HashLife* hl, HashNode* n) {
+    // the 4x4 cells, row major
+    GolCell c[4][4];
+    HashNode* q[2][2] = {{n->nw, n->ne}, {n->sw, n->se}};
+
+    for (int qy = 0; qy < 2; qy++) {
+        for (int qx = 0; qx < 2; qx++) {
+            c[qy * 2][qx * 2] = q[qy][qx]->nw->population;
+            c[qy * 2][qx * 2 + 1] = q[qy][qx]->ne->population;
+            c[qy * 2 + 1][qx * 2] = q[qy][qx]->sw->population;
+            c[qy * 2 + 1][qx * 2 + 1] = q[qy][qx]->se->population;
+        }
+    }
+
+    HashNode* out[2][2];
+    for (int y = 1; y <= 2; y++) {
+        for (int x = 1; x <= 2; x++) {
+            int neighbours =
+                c[y - 1][x - 1] + c[y - 1][x] + c[y - 1][x + 1] +
+                c[y][x - 1] + c[y][x + 1] +
+                c[y + 1][x - 1] + c[y + 1][x] + c[y + 1][x + 1];
+            out[y - 1][x - 1] = &(hl->leaves[rule_next(&(hl->rule), c[y][x], neighbours)]);
+        }
+    }
+    return hashlife_node(hl, out[0][0], out[0][1], out[1][0], out[1][1]);
+}
+
+/// The centre of `n`, advanced 2^min(level - 2, step_log2) generations.
+static HashNode* hashlife_next(HashLife* hl, HashNode* n) {
+    if (n->result) return n->result;
+
+    HashNode* r;
+    if (n->population == 0) {
+        r = n->nw;
+    }
+    else if (n->level == 2) {
+        r = hashlife_base(hl, n);
+    }
+    else {
+        // nine overlapping subnodes of level - 1
+        HashNode* n00 = n->nw;
+        HashNode* n01 = hashlife_centre_h(hl, n->nw, n->ne);
+        HashNode* n02 = n->ne;
+        HashNode* n10 = hashlife_centre_v(hl, n->nw, n->sw);
+        HashNode* n11 = hashlife_centre(hl, n);
+        HashNode* n12 = hashlife_centre_v(hl, n->ne, n->se);
+        HashNode* n20 = n->sw;
+        HashNode* n21 = hashlife_centre_h(hl, n->sw, n->se);
+        HashNode* n22 = n->se;
+
+        if (hl->step_log2 >= (int)n->level - 2) {
+            // full speed: two half steps of 2^(level - 3) each
+            n00 = hashlife_next(hl, n00); n01 = hashlife_next(hl, n01); n02 = hashlife_next(hl, n02);
+            n10 = hashlife_next(hl, n10); n11 = hashlife_next(hl, n11); n12 = hashlife_next(hl, n12);
+            n20 = hashlife_next(hl, n20); n21 = hashlife_next(hl, n21); n22 = hashlife_next(hl, n22);
+        }
+        else {
+            // slower: skip the first half step, the second one does all the work
+            n00 = hashlife_centre(hl, n00); n01 = hashlife_centre(hl, n01); n02 = hashlife_centre(hl, n02);
+            n10 = hashlife_centre(hl, n10); n11 = hashlife_centre(hl, n11); n12 = hashlife_centre(hl, n12);
+            n20 = hashlife_centre(hl, n20); n21 = hashlife_centre(hl, n21); n22 = hashlife_centre(hl, n22);
+        }
+
+        r = hashlife_node(
+            hl,
+            hashlife_next(hl, hashlife_node(hl, n00, n01, n10, n11)),
+            hashlife_next(hl, hashlife_node(hl, n01, n02, n11, n12)),
+            hashlife_next(hl, hashlife_node(hl, n10, n11, n20, n21)),
+            hashlife_next(hl, hashlife_node(hl, n11, n12, n21, n22))
+        );
+    }
+
+    n->result = r;
+    return r;
+}
+
+/// Wrap the root in an empty border, doubling its size around the same centre.
+static void hashlife_expand(HashLife* hl) {
+    HashNode* r = hl->root;
+    HashNode* e = hashlife_empty(hl, r->level - 1);
+
+    hl->root = hashlife_node(
+        hl,
+        hashlife_node(hl, e, e, e, r->nw),
+        hashlife_node(hl, e, e, r->ne, e),
+        hashlife_node(hl, e, r->sw, e, e),
+        hashlife_node(hl, r->se, e, e, e)
+    );
+}
+
+static void hashlife_mark(HashNode* n) {
+    if (n->marked || n->level == 0) return;
+    n->marked = 1;
+    hashlife_mark(n->nw);
+    hashlife_mark(n->ne);
+    hashlife_mark(n->sw);
+    hashlife_mark(n->se);
+}
+
+/// Free every node that is not part of the root or the empty nodes.
+/// The memoised results of the survivors are dropped, they may point at freed nodes.
+static void hashlife_collect(HashLife* hl) {
+    hashlife_mark(hl->root);
+    for (int i = 1; i <= HASHLIFE_MAX_LEVEL && hl->empty[i]; i++) hashlife_mark(hl->empty[i]);
+
+    memset(hl->buckets, 0, hl->bucket_count * sizeof(HashNode*));
+    hl->node_count = 0;
+    hl->free_list = NULL;
+
+    for (HashNodeBlock* block = hl->blocks; block; block = block->next) {
+        size_t used = (block == hl->blocks) ? hl->block_used : HASHLIFE_BLOCK_NODES;
+
+        for (size_t i = 0; i < used; i++) {
+            HashNode* n = &(block->nodes[i]);
+            if (n->marked) {
+                size_t b = hashlife_hash(n->nw, n->ne, n->sw, n->se) & (hl->bucket_count - 1);
+                n->marked = 0;
+                n->result = NULL;
+                n->chain = hl->buckets[b];
+                hl->buckets[b] = n;
+                hl->node_count++;
+            }
+            else {
+                // also clears stale pointers of nodes already in the free list
+                memset(n, 0, sizeof(HashNode));
+                n->chain = hl->free_list;
+                hl->free_list = n;
+            }
+        }
+    }
+}
+
+static void hashlife_clear_results(HashLife* hl) {
+    for (size_t i = 0; i < hl->bucket_count; i++) {
+        for (HashNode* n = hl->buckets[i]; n; n = n->chain) n->result = NULL;
+    }
+}
+
+/// Switch to another rule, which invalidates every memoised result.
+void hashlife_set_rule(HashLife* hl, const GolRule* rule) {
+    hl->rule = *rule;
+    hashlife_clear_results(hl);
+}
+
+/// Advance the whole universe 2^step_log2 generations.
+void hashlife_step(HashLife* hl, int step_log2) {
+    step_log2 = min(max(step_log2, 0), HASHLIFE_MAX_STEP_LOG2);
+
+    if (step_log2 != hl->step_log2) {
+        hashlife_clear_results(hl);
+        hl->step_log2 = step_log2;
+    }
+
+    // the pattern has to sit in the inner quarter of a root big enough for the step,
+    // nothing can travel further than the border of its centre in 2^(level - 3) generations
+    while (
+        (int)hl->root->level < step_log2 + 3 ||
+        hashlife_centre(hl, hashlife_centre(hl, hl->root))->population != hl->root->population
+    ) {
+        if (hl->root->level >= HASHLIFE_MAX_LEVEL) return;
+        hashlife_expand(hl);
+    }
+
+    hl->root = hashlife_next(hl, hl->root);
+    hl->generation += UINT64_C(1) << step_log2;
+
+    if (hl->node_count > HASHLIFE_GC_NODES) hashlife_collect(hl);
+}
+
+GolCell hashlife_get(HashLife* hl, int64_t x, int64_t y) {
+    HashNode* n = hl->root;
+    int64_t half = INT64_C(1) << (n->level - 1);
+
+    if (x < -half || y < -half || x >= half || y >= half) return Dead;
+
+    // offset into the root square
+    x += half;
+    y += half;
+    while (n->level > 0) {
+        if (n->population == 0) return Dead;
+        half = INT64_C(1) << (n->level - 1);
+        if (y < half) n = (x < half) ? n->nw : n->ne;
+        else n = (x < half) ? n->sw : n->se;
+        x &= half - 1;
+        y &= half - 1;
+    }
+    return n->population != 0;
+}
+
+static HashNode* hashlife_set_rec(HashLife* hl, HashNode* n, int64_t x, int64_t y, GolCell to) {
+    if (n->level == 0) return &(hl->leaves[to ? Alive : Dead]);
+
+    int64_t half = INT64_C(1) << (n->level - 1);
+    HashNode* nw = n->nw; HashNode* ne = n->ne;
+    HashNode* sw = n->sw; HashNode* se = n->se;
+
+    if (y < half) {
+        if (x < half) nw = hashlife_set_rec(hl, nw, x, y, to);
+        else ne = hashlife_set_rec(hl, ne, x - half, y, to);
+    }
+    else {
+        if (x < half) sw = hashlife_set_rec(hl, sw, x, y - half, to);
+        else se = hashlife_set_rec(hl, se, x - half, y - half, to);
+    }
+    return hashlife_node(hl, nw, ne, sw, se);
+}
+
+void hashlife_set(HashLife* hl, int64_t x, int64_t y, GolCell to) {
+    for (;;) {
+        int64_t half = INT64_C(1) << (hl->root->level - 1);
+        if (x >= -half && y >= -half && x < half && y < half) break;
+        if (hl->root->level >= HASHLIFE_MAX_LEVEL) return;
+        hashlife_expand(hl);
+    }
+
+    int64_t half = INT64_C(1) << (hl->root->level - 1);
+    hl->root = hashlife_set_rec(hl, hl->root, x + half, y + half, to);
+}
+
+/* building a world from runs of cells, as decoded from pattern files */
+
+// the widest world a builder assembles, in level 3 nodes per strip that is 2^(level - 3)
+#define HASHLIFE_BUILDER_MAX_LEVEL 24
+
+/// Assembles a world from runs of live cells that arrive row by row, top to bottom.
+/// Every 8 rows become a strip of level 3 nodes, and two rows of nodes of a level are
+/// joined into a row of the level above as soon as both are there, like the carries of
+/// a binary counter. So only one strip of cells is ever held, however tall the pattern is.
+typedef struct HashlifeBuilder {
+    HashLife* hl;
+    uint32_t level;
+    int64_t half;
+    /// level 3 nodes per strip
+    size_t strip_nodes;
+    /// 8 rows of `strip_nodes` bytes, bit x of byte i is cell x of node i
+    uint8_t* strip;
+    int64_t strip_index;
+    bool strip_empty;
+    /// per level, the row waiting for the row below it, empty rows are only flagged
+    HashNode** pending[HASHLIFE_BUILDER_MAX_LEVEL + 1];
+    HashNode** joined[HASHLIFE_BUILDER_MAX_LEVEL + 1];
+    bool has_pending[HASHLIFE_BUILDER_MAX_LEVEL + 1];
+    bool pending_empty[HASHLIFE_BUILDER_MAX_LEVEL + 1];
+    /// level 2 nodes by their 16 cells, row major
+    HashNode** level2;
+    HashNode* root;
+} HashlifeBuilder;
+
+/// The level 2 node of a 4x4 block, bit x + 4 * y is the cell (x, y).
+static HashNode* hashlife_node4(HashLife* hl, HashNode** cache, uint32_t cells) {
+    if (cache[cells]) return cache[cells];
+
+    HashNode* q[4];
+    for (int i = 0; i < 4; i++) {
+        // the 2x2 quadrant i, its top left cell is at (2 * (i % 2), 2 * (i / 2))
+        uint32_t at = (i % 2) * 2 + (i / 2) * 8;
+        q[i] = hashlife_node(
+            hl,
+            &(hl->leaves[(cells >> at) & 1]), &(hl->leaves[(cells >> (at + 1)) & 1]),
+            &(hl->leaves[(cells >> (at + 4)) & 1]), &(hl->leaves[(cells >> (at + 5)) & 1])
+        );
+    }
+    return cache[cells] = hashlife_node(hl, q[0], q[1], q[2], q[3]);
+}
+
+/// The level 3 node of an 8x8 block, `rows[y]` holds the cells of row y.
+static HashNode* hashlife_node8(HashLife* hl, HashNode** cache, const uint8_t rows[8]) {
+    uint32_t q[4] = {0};
+
+    for (int y = 0; y < 8; y++) {
+        uint32_t shift = (y % 4) * 4;
+        q[(y / 4) * 2] |= (uint32_t)(rows[y] & 0x0F) << shift;
+        q[(y / 4) * 2 + 1] |= (uint32_t)(rows[y] >> 4) << shift;
+    }
+    if (!(q[0] | q[1] | q[2] | q[3])) return hashlife_empty(hl, 3);
+
+    return hashlife_node(
+        hl,
+        hashlife_node4(hl, cache, q[0]), hashlife_node4(hl, cache, q[1]),
+        hashlife_node4(hl, cache, q[2]), hashlife_node4(hl, cache, q[3])
+    );
+}
+
+/// Start a world that holds the cells in [x0, x1) x [y0, y1).
+/// Returns false when the pattern is too wide to assemble.
+bool hashlife_builder_begin(HashlifeBuilder* b, HashLife* hl, int64_t x0, int64_t y0, int64_t x1, int64_t y1) {
+    memset(b, 0, sizeof(HashlifeBuilder));
+    b->hl = hl;
+    b->level = 3;
+    while (
+        b->level <= HASHLIFE_BUILDER_MAX_LEVEL && (
+            x0 < -(INT64_C(1) << (b->level - 1)) || y0 < -(INT64_C(1) << (b->level - 1)) ||
+            x1 > (INT64_C(1) << (b->level - 1)) || y1 > (INT64_C(1) << (b->level - 1))
+        )
+    ) b->level++;
+    if (b->level > HASHLIFE_BUILDER_MAX_LEVEL) return false;
+
+    b->half = INT64_C(1) << (b->level - 1);
+    b->strip_nodes = (size_t)1 << (b->level - 3);
+    b->strip = (uint8_t*)calloc(8 * b->strip_nodes, 1);
+    b->level2 = (HashNode**)calloc(1 << 16, sizeof(HashNode*));
+    if (!(b->strip) || !(b->level2)) panic("Allocation of the hashlife builder failed");
+
+    b->strip_empty = true;
+    for (uint32_t l = 3; l <= b->level; l++) {
+        size_t nodes = (size_t)1 << (b->level - l);
+        b->pending[l] = (HashNode**)malloc(nodes * sizeof(HashNode*));
+        b->joined[l] = (HashNode**)malloc(nodes * sizeof(HashNode*));
+        if (!(b->pending[l]) || !(b->joined[l])) panic("Allocation of the hashlife builder failed");
+    }
+    return true;
+}
+
+/// Add a row of nodes of `level`, `row` can be NULL for an empty row.
+static void hashlife_builder_push(HashlifeBuilder* b, uint32_t level, HashNode** row) {
+    for (;;) {
+        size_t nodes = (size_t)1 << (b->level - level);
+
+        if (level == b->level) {
+            b->root = row ? row[0] : hashlife_empty(b->hl, level);
+            return;
+        }
+        if (!(b->has_pending[level])) {
+            if (row) memcpy(b->pending[level], row, nodes * sizeof(HashNode*));
+            b->pending_empty[level] = !row;
+            b->has_pending[level] = true;
+            return;
+        }
+
+        b->has_pending[level] = false;
+        if (!row && b->pending_empty[level]) {
+            level++;
+            continue;
+        }
+
+        HashNode* e = hashlife_empty(b->hl, level);
+        HashNode** top = b->pending_empty[level] ? NULL : b->pending[level];
+        HashNode** out = b->joined[level + 1];
+        for (size_t i = 0; i < nodes / 2; i++) {
+            out[i] = hashlife_node(
+                b->hl,
+                top ? top[2 * i] : e, top ? top[2 * i + 1] : e,
+                row ? row[2 * i] : e, row ? row[2 * i + 1] : e
+            );
+        }
+        row = out;
+        level++;
+    }
+}
+
+/// Turn the strip into a row of level 3 nodes, and start the next one.
+static void hashlife_builder_flush(HashlifeBuilder* b) {
+    if (b->strip_empty) {
+        hashlife_builder_push(b, 3, NULL);
+    }
+    else {
+        HashNode** row = b->joined[3];
+        uint8_t rows[8];
+        for (size_t i = 0; i < b->strip_nodes; i++) {
+            for (int y = 0; y < 8; y++) rows[y] = b->strip[y * b->strip_nodes + i];
+            row[i] = hashlife_node8(b->hl, b->level2, rows);
+        }
+        hashlife_builder_push(b, 3, row);
+        memset(b->strip, 0, 8 * b->strip_nodes);
+    }
+    b->strip_empty = true;
+    b->strip_index++;
+}
+
+/// Add `n` live cells from (x, y) rightwards. Runs have to come row by row, top to bottom,
+/// and lie in the rectangle given to `hashlife_builder_begin`.
+void hashlife_builder_run(HashlifeBuilder* b, int64_t x, int64_t y, int64_t n) {
+    x += b->half;
+    y += b->half;
+    if (n <= 0 || y < b->strip_index * 8 || x < 0 || y >= 2 * b->half || x + n > 2 * b->half) return;
+
+    while (y >= (b->strip_index + 1) * 8) hashlife_builder_flush(b);
+
+    uint8_t* row = b->strip + (y % 8) * b->strip_nodes;
+    int64_t end = x + n;
+    while (x < end) {
+        int64_t bits = min(8 - x % 8, end - x);
+        row[x / 8] |= (uint8_t)(((1u << bits) - 1) << (x % 8));
+        x += bits;
+    }
+    b->strip_empty = false;
+}
+
+/// Flush the last strips and make the assembled world the one of `hl`.
+void hashlife_builder_finish(HashlifeBuilder* b) {
+    while (!(b->root)) hashlife_builder_flush(b);
+
+    b->hl->root = b->root;
+    b->hl->generation = 0;
+
+    for (uint32_t l = 3; l <= b->level; l++) {
+        free(b->pending[l]);
+        free(b->joined[l]);
+    }
+    free(b->strip);
+    free(b->level2);
+}
+
+/// Build the node of `level` whose top left cell is (x0, y0) in universe coordinates.
+static HashNode* hashlife_build(HashLife* hl, Universe* uvs, uint32_t level, int64_t x0, int64_t y0) {
+    int64_t size = INT64_C(1) << level;
+
+    if (x0 >= (int64_t)uvs->width || y0 >= (int64_t)uvs->height || x0 + size <= 0 || y0 + size <= 0) {
+        return hashlife_empty(hl, level);
+    }
+    if (level == 0) return &(hl->leaves[universe_get(uvs, x0, y0) ? Alive : Dead]);
+
+    int64_t half = size / 2;
+    return hashlife_node(
+        hl,
+        hashlife_build(hl, uvs, level - 1, x0, y0),
+        hashlife_build(hl, uvs, level - 1, x0 + half, y0),
+        hashlife_build(hl, uvs, level - 1, x0, y0 + half),
+        hashlife_build(hl, uvs, level - 1, x0 + half, y0 + half)
+    );
+}
+
+/// Replace the whole world with the cells of `uvs`, placed at [0, width) x [0, height).
+void hashlife_load_universe(HashLife* hl, Universe* uvs) {
+    uint32_t level = 3;
+    while ((INT64_C(1) << (level - 1)) < (int64_t)max(uvs->width, uvs->height)) level++;
+
+    int64_t half = INT64_C(1) << (level - 1);
+    hl->root = hashlife_build(hl, uvs, level, -half, -half);
+}
+
+static void hashlife_store_rec(HashNode* n, Universe* uvs, int64_t x0, int64_t y0) {
+    int64_t size = INT64_C(1) << n->level;
+
+    if (n->population == 0) return;
+    if (x0 >= (int64_t)uvs->width || y0 >= (int64_t)uvs->height || x0 + size <= 0 || y0 + size <= 0) return;
+    if (n->level == 0) {
+        universe_set(uvs, (size_t)x0, (size_t)y0, Alive);
+        return;
+    }
+
+    int64_t half = size / 2;
+    hashlife_store_rec(n->nw, uvs, x0, y0);
+    hashlife_store_rec(n->ne, uvs, x0 + half, y0);
+    hashlife_store_rec(n->sw, uvs, x0, y0 + half);
+    hashlife_store_rec(n->se, uvs, x0 + half, y0 + half);
+}
+
+/// Copy the part of the world at [0, width) x [0, height) into `uvs`.
+void hashlife_store_universe(HashLife* hl, Universe* uvs) {
+    int64_t half = INT64_C(1) << (hl->root->level - 1);
+
+    universe_fill(uvs, Dead);
+    hashlife_store_rec(hl->root, uvs, -half, -half);
+}
+
+#endif
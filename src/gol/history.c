@@ -0,0 +1,355 @@
+#ifndef GOL_HISTORY_C_
+#define GOL_HISTORY_C_
+
+//! The past generations of the view, for rewinding. Every recorded frame is stored as the
+//! XOR of its bit-packed cells with the newest keyframe. The XOR is stored as runs of zero
+//! words and of literal words, and a literal word as a mask of its non-zero bytes followed by
+//! those bytes. So a generation costs about the cells that changed since its keyframe,
+//! and any generation is rebuilt by one copy of a decoded keyframe and one pass over its delta.
+//! A new keyframe starts when a delta would be bigger than the keyframe,
+//! or after GOL_HISTORY_KEY_INTERVAL frames.
+//! The oldest keyframe, with its deltas, is dropped when the history goes over its budget.
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sim.c"
+#include "../panic.h"
+
+#define GOL_HISTORY_KEY_INTERVAL 256
+
+typedef enum HistoryEncoding {
+    /// varints of zero words and of literal words, each literal word a byte mask and its non-zero bytes
+    HistoryEncoding_Runs = 0,
+    /// every word as is, when runs would take more space
+    HistoryEncoding_Raw,
+} HistoryEncoding;
+
+typedef struct HistoryEntry {
+    uint64_t iterations;
+    size_t width, height;
+    /// absolute index of the keyframe this entry is a delta against, its own for keyframes
+    uint64_t keyframe;
+    /// a HistoryEncoding byte and the encoded words
+    uint8_t* data;
+    size_t size;
+} HistoryEntry;
+
+typedef struct GolHistory {
+    /// ring of entries, oldest at `head`
+    HistoryEntry* ring;
+    size_t capacity;
+    size_t head;
+    /// also read by the UI while the simulation thread records
+    _Atomic size_t count;
+    /// absolute index of the oldest entry
+    uint64_t first;
+    /// bytes of encoded frames, kept under `budget`, 0 turns recording off
+    size_t bytes, budget;
+
+    /// the newest keyframe, decoded, which new frames are compared against
+    GolFrame key;
+    bool key_valid;
+    uint64_t key_index;
+    size_t key_size;
+    size_t since_key;
+
+    /// the keyframe `history_restore` decoded last
+    GolFrame cache;
+    uint64_t cache_keyframe;
+    bool cache_valid;
+
+    uint8_t* scratch;
+    size_t scratch_capacity;
+} GolHistory;
+
+GolHistory history_new(size_t budget) {
+    GolHistory h;
+    memset(&h, 0, sizeof(GolHistory));
+    h.budget = budget;
+    return h;
+}
+
+static inline size_t history_count(const GolHistory* h) {
+    return atomic_load_explicit(&(h->count), memory_order_relaxed);
+}
+
+static inline HistoryEntry* history_at(GolHistory* h, size_t i) {
+    return &(h->ring[(h->head + i) % h->capacity]);
+}
+
+/// The generation of entry `i`, 0 being the oldest one.
+static inline uint64_t history_iterations(GolHistory* h, size_t i) {
+    return history_at(h, i)->iterations;
+}
+
+static void history_pop_front(GolHistory* h) {
+    HistoryEntry* e = history_at(h, 0);
+    h->bytes -= e->size;
+    free(e->data);
+    h->head = (h->head + 1) % h->capacity;
+    h->first++;
+    atomic_store_explicit(&(h->count), history_count(h) - 1, memory_order_relaxed);
+}
+
+/// Drop every entry from `keep` on, recording goes on from the entry before it.
+void history_truncate(GolHistory* h, size_t keep) {
+    size_t count = history_count(h);
+
+    while (count > keep) {
+        HistoryEntry* e = history_at(h, --count);
+        h->bytes -= e->size;
+        free(e->data);
+    }
+    atomic_store_explicit(&(h->count), count, memory_order_relaxed);
+
+    // the keyframe may be gone, and the next frame no follow-up of the newest one
+    h->key_valid = false;
+    if (h->cache_valid && h->cache_keyframe >= h->first + count) h->cache_valid = false;
+}
+
+void history_clear(GolHistory* h) {
+    history_truncate(h, 0);
+}
+
+void history_deinit(GolHistory* h) {
+    history_clear(h);
+    free(h->ring);
+    free(h->key.words);
+    free(h->cache.words);
+    free(h->scratch);
+    memset(h, 0, sizeof(GolHistory));
+}
+
+/// Drop the oldest keyframes with their deltas until the history fits its budget,
+/// or until only the group of the newest keyframe is left if `keep_newest`.
+static void history_evict(GolHistory* h, bool keep_newest) {
+    while (h->bytes > h->budget && history_count(h) > 0) {
+        if (keep_newest && history_at(h, 0)->keyframe == h->key_index) break;
+
+        do history_pop_front(h);
+        while (history_count(h) > 0 && history_at(h, 0)->keyframe != h->first);
+    }
+    if (history_count(h) == 0) h->key_valid = false;
+}
+
+/// Change the budget, dropping the oldest entries that no longer fit.
+void history_set_budget(GolHistory* h, size_t budget) {
+    h->budget = budget;
+    history_evict(h, false);
+}
+
+static inline size_t history_put_varint(uint8_t* out, uint64_t v) {
+    size_t n = 0;
+    while (v >= 0x80) {
+        out[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    out[n++] = (uint8_t)v;
+    return n;
+}
+
+static inline uint64_t history_get_varint(const uint8_t** in) {
+    uint64_t v = 0;
+    int shift = 0;
+    while (**in & 0x80) {
+        v |= (uint64_t)(*((*in)++) & 0x7F) << shift;
+        shift += 7;
+    }
+    return v | ((uint64_t)(*((*in)++)) << shift);
+}
+
+/// Bit b is set if byte b of `w` is not zero.
+static inline uint32_t history_byte_mask(uint64_t w) {
+    const uint64_t low7 = UINT64_C(0x7F7F7F7F7F7F7F7F);
+    // the high bit of every byte that is not zero
+    uint64_t high = (((w & low7) + low7) | w) & ~low7;
+    // gather the 8 high bits into the top byte
+    return (uint32_t)(((high >> 7) * UINT64_C(0x0102040810204080)) >> 56);
+}
+
+static inline uint64_t history_diff(const uint64_t* words, const uint64_t* ref, size_t i) {
+    return words[i] ^ (ref ? ref[i] : 0);
+}
+
+/// Encode `words` XOR `ref` (or `words` alone if `ref` is NULL) into `out`,
+/// taking at most `limit` bytes. Returns the size, or 0 if it didn't fit.
+static size_t history_encode(uint8_t* out, size_t limit, const uint64_t* words, const uint64_t* ref, size_t n) {
+    size_t size = 1;
+    size_t i = 0;
+
+    out[0] = HistoryEncoding_Runs;
+    while (i < n) {
+        size_t start = i;
+        while (i < n && !history_diff(words, ref, i)) i++;
+        size_t zeros = i - start;
+
+        // a zero word inside a literal run costs a byte, less than starting a new run
+        start = i;
+        while (i < n && (
+            history_diff(words, ref, i) ||
+            (i + 1 < n && history_diff(words, ref, i + 1)) ||
+            (i + 2 < n && history_diff(words, ref, i + 2))
+        )) i++;
+        size_t literals = i - start;
+
+        uint8_t counts[20];
+        size_t counts_size = history_put_varint(counts, zeros);
+        counts_size += history_put_varint(counts + counts_size, literals);
+        if (size + counts_size > limit) return 0;
+        memcpy(out + size, counts, counts_size);
+        size += counts_size;
+
+        for (size_t k = start; k < i; k++) {
+            uint64_t w = history_diff(words, ref, k);
+            if (size + 9 > limit) return 0;
+
+            uint32_t mask = history_byte_mask(w);
+            out[size++] = (uint8_t)mask;
+            for (; mask; mask &= mask - 1) out[size++] = (uint8_t)(w >> (__builtin_ctz(mask) * 8));
+        }
+    }
+    return size;
+}
+
+/// XOR the words encoded in `data` into `words`.
+static void history_apply(const uint8_t* data, size_t size, uint64_t* words, size_t n) {
+    const uint8_t* in = data + 1;
+    const uint8_t* end = data + size;
+
+    if (data[0] == HistoryEncoding_Raw) {
+        for (size_t i = 0; i < n; i++, in += sizeof(uint64_t)) {
+            uint64_t w;
+            memcpy(&w, in, sizeof w);
+            words[i] ^= w;
+        }
+        return;
+    }
+
+    size_t i = 0;
+    while (in < end) {
+        i += history_get_varint(&in);
+        size_t literals = history_get_varint(&in);
+        for (size_t k = 0; k < literals; k++) {
+            uint64_t w = 0;
+            for (uint32_t mask = *in++; mask; mask &= mask - 1) w |= (uint64_t)(*in++) << (__builtin_ctz(mask) * 8);
+            words[i++] ^= w;
+        }
+    }
+}
+
+/// Encode `frame` as a keyframe into the scratch buffer, returns the size.
+static size_t history_encode_key(GolHistory* h, const GolFrame* frame, size_t n) {
+    size_t raw = 1 + n * sizeof(uint64_t);
+    size_t size = history_encode(h->scratch, raw, frame->words, NULL, n);
+
+    if (size == 0) {
+        h->scratch[0] = HistoryEncoding_Raw;
+        memcpy(h->scratch + 1, frame->words, n * sizeof(uint64_t));
+        size = raw;
+    }
+    return size;
+}
+
+/// Add `frame` as the newest entry.
+void history_record(GolHistory* h, const GolFrame* frame) {
+    if (h->budget == 0) return;
+
+    size_t n = frame->row_words * frame->height;
+    size_t raw = 1 + n * sizeof(uint64_t);
+    if (raw > h->scratch_capacity) {
+        free(h->scratch);
+        h->scratch = (uint8_t*)malloc(raw);
+        h->scratch_capacity = h->scratch ? raw : 0;
+        if (!(h->scratch)) {
+            panic("Allocation of the history buffer failed");
+            return;
+        }
+    }
+
+    uint64_t index = h->first + history_count(h);
+    bool delta = h->key_valid && h->since_key < GOL_HISTORY_KEY_INTERVAL &&
+        h->key.width == frame->width && h->key.height == frame->height;
+    // a delta bigger than a keyframe is worse in every way
+    size_t size = delta ? history_encode(h->scratch, h->key_size, frame->words, h->key.words, n) : 0;
+
+    if (size == 0) {
+        size = history_encode_key(h, frame, n);
+        if (!gol_frame_reserve(&(h->key), n)) return;
+        memcpy(h->key.words, frame->words, n * sizeof(uint64_t));
+        h->key.width = frame->width;
+        h->key.height = frame->height;
+        h->key.row_words = frame->row_words;
+        h->key_valid = true;
+        h->key_size = size;
+        h->key_index = index;
+        h->since_key = 0;
+    }
+    h->since_key++;
+
+    if (history_count(h) == h->capacity) {
+        size_t capacity = h->capacity ? h->capacity * 2 : 1024;
+        HistoryEntry* ring = (HistoryEntry*)malloc(capacity * sizeof(HistoryEntry));
+        if (!ring) {
+            panic("Allocation of the history failed");
+            return;
+        }
+        for (size_t i = 0; i < h->capacity; i++) ring[i] = *history_at(h, i);
+        free(h->ring);
+        h->ring = ring;
+        h->capacity = capacity;
+        h->head = 0;
+    }
+
+    HistoryEntry* e = &(h->ring[(h->head + history_count(h)) % h->capacity]);
+    e->data = (uint8_t*)malloc(size);
+    if (!(e->data)) {
+        panic("Allocation of a history entry failed");
+        return;
+    }
+    memcpy(e->data, h->scratch, size);
+    e->size = size;
+    e->iterations = frame->iterations;
+    e->width = frame->width;
+    e->height = frame->height;
+    e->keyframe = h->key_index;
+    h->bytes += size;
+    atomic_store_explicit(&(h->count), history_count(h) + 1, memory_order_relaxed);
+
+    history_evict(h, true);
+    // the newest keyframe alone is over budget, so start another one soon
+    if (h->bytes > h->budget) h->since_key = GOL_HISTORY_KEY_INTERVAL;
+}
+
+/// Rebuild entry `i` into `frame`.
+bool history_restore(GolHistory* h, size_t i, GolFrame* frame) {
+    if (i >= history_count(h)) return false;
+
+    HistoryEntry* e = history_at(h, i);
+    size_t row_words = (e->width + 63) / 64;
+    size_t n = row_words * e->height;
+
+    if (!(h->cache_valid) || h->cache_keyframe != e->keyframe) {
+        HistoryEntry* key = history_at(h, (size_t)(e->keyframe - h->first));
+        if (!gol_frame_reserve(&(h->cache), n)) return false;
+        memset(h->cache.words, 0, n * sizeof(uint64_t));
+        history_apply(key->data, key->size, h->cache.words, n);
+        h->cache_keyframe = e->keyframe;
+        h->cache_valid = true;
+    }
+
+    if (!gol_frame_reserve(frame, n)) return false;
+    memcpy(frame->words, h->cache.words, n * sizeof(uint64_t));
+    if (e->keyframe != h->first + i) history_apply(e->data, e->size, frame->words, n);
+
+    frame->width = e->width;
+    frame->height = e->height;
+    frame->row_words = row_words;
+    frame->iterations = e->iterations;
+    return true;
+}
+
+#endif
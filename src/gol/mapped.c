@@ -0,0 +1,389 @@
+#ifndef GOL_MAPPED_C_
+#define GOL_MAPPED_C_
+
+//! A bit-packed world in a memory-mapped file, for worlds larger than the memory.
+//! Both buffers of the grid are in the file, laid out like `PackedGrid`, behind a header with
+//! the generation, the rule and which buffer is current, so a world goes on where it was left
+//! after a restart. It steps in strips through scratch (see `packed_step_blocked`) and gives
+//! every strip back to the kernel once it is stepped, so only a few strips are resident while
+//! the page cache streams the rest to and from the disk. The file is sparse, dead rows that
+//! were never written take no disk space.
+//! The game shows a window of the world at `view_x`, `view_y`, see `mapped_store_universe`.
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef _WIN32
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+#include "packed.c"
+#include "pool.c"
+#include "universe.c"
+#include "../const.h"
+
+#define MAPPED_MAGIC "GOLWORLD"
+#define MAPPED_VERSION 1
+// the buffers start on a page after the header
+#define MAPPED_HEADER_SIZE 4096
+#define MAPPED_DEFAULT_PATH "multisim-world.golmap"
+#define MAPPED_DEFAULT_SIZE 65536
+// generations per pass of `mapped_run`, which reads and writes the file once per pass.
+// 1 until temporal blocking beats stepping one at a time on grids much larger than the
+// cache, see `MultiSim --bench`
+#define MAPPED_RUN_PASS 1
+// how far back a page fault may map pages that are in the page cache, with fault-around
+// or a whole large folio, at most a huge page
+#define MAPPED_FAULT_AROUND (2 << 20)
+// rows `mapped_fill_random` writes before it gives them back
+#define MAPPED_FILL_ROWS 256
+
+typedef struct MappedHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t edge;
+    uint64_t width, height;
+    uint64_t generation;
+    /// the buffer holding the cells of `generation`, 0 or 1
+    uint32_t current;
+    uint16_t birth, survive;
+} MappedHeader;
+
+typedef struct MappedLife {
+    /// the bit-packed universe, streaming from `map`
+    Universe universe;
+    MappedHeader* header;
+    void* map;
+    size_t map_size;
+    int fd;
+    /// `mapped_open` made a new file, which has no world from before
+    bool created;
+    /// the top left corner of the view in the world, `view_x` on a word
+    size_t view_x, view_y;
+} MappedLife;
+
+/// Bytes of one buffer of a `width` x `height` world, rounded up to a whole page.
+static inline size_t mapped_buffer_size(size_t width, size_t height) {
+    size_t stride = (width + 63) / 64 + 2;
+    size_t bytes = stride * (height + 2) * sizeof(uint64_t);
+    return (bytes + MAPPED_HEADER_SIZE - 1) / MAPPED_HEADER_SIZE * MAPPED_HEADER_SIZE;
+}
+
+/// Point the universe at the buffers in the mapping, `header->current` first.
+static void mapped_bind(MappedLife* ml) {
+    const MappedHeader* h = ml->header;
+    const size_t buffer_size = mapped_buffer_size(h->width, h->height);
+    uint64_t* buffers[2] = {
+        (uint64_t*)((char*)(ml->map) + MAPPED_HEADER_SIZE),
+        (uint64_t*)((char*)(ml->map) + MAPPED_HEADER_SIZE + buffer_size),
+    };
+
+    Universe* uvs = &(ml->universe);
+    uvs->backend = UniverseBackend_Packed;
+    uvs->edge = (h->edge == UniverseEdge_Wrap) ? UniverseEdge_Wrap : UniverseEdge_Dead;
+    uvs->rule = rule_new(h->birth, h->survive);
+    uvs->width = uvs->capacity_width = h->width;
+    uvs->height = uvs->capacity_height = h->height;
+    uvs->size = uvs->width * uvs->height;
+    uvs->pass_generations = 1;
+    uvs->streaming = true;
+
+    PackedGrid* g = &(uvs->packed);
+    g->width = uvs->width;
+    g->height = uvs->height;
+    g->row_words = (g->width + 63) / 64;
+    g->stride = g->row_words + 2;
+    g->capacity_height = g->height;
+    g->tail_mask = packed_tail_mask(g->width);
+    g->words = buffers[h->current & 1];
+    g->words_next = buffers[(h->current & 1) ^ 1];
+}
+
+#ifndef _WIN32
+
+/// GolPoolJob for `Universe.release`: drop the rows of a stepped tile [y0, y1), and the rows
+/// above it it read, from the process. Every page they touch goes, even the ones shared with
+/// rows still in use, as the mapping is shared: the page cache keeps what was written, and
+/// touching a page again only maps it back in. Reading a page maps the cached ones around it
+/// as well, up to MAPPED_FAULT_AROUND back into rows that were already dropped, so those go again.
+static void mapped_release_rows(void* ctx, size_t y0, size_t y1) {
+    const Universe* uvs = (const Universe*)ctx;
+    const PackedGrid* g = &(uvs->packed);
+    const uintptr_t page = MAPPED_HEADER_SIZE;
+    const size_t k = uvs->pass_generations;
+
+    const uint64_t* from[2] = { g->words, g->words_next };
+    const size_t rows[2][2] = { { (y0 > k) ? y0 - k : 0, y1 }, { y0, y1 } };
+    for (size_t b = 0; b < 2; b++) {
+        uintptr_t start = (uintptr_t)(PACKED_ROW(g, from[b], rows[b][0]) - 1);
+        uintptr_t end = (uintptr_t)(PACKED_ROW(g, from[b], rows[b][1]) - 1);
+        uintptr_t first = (uintptr_t)(from[b]);
+        start = (start - first > MAPPED_FAULT_AROUND) ? start - MAPPED_FAULT_AROUND : first;
+        start = start / page * page;
+        end = (end + page - 1) / page * page;
+        madvise((void*)start, end - start, MADV_DONTNEED);
+    }
+}
+
+/// Give up opening `ml`, with `errno` set to `error`.
+static MappedLife* mapped_fail(MappedLife* ml, int error) {
+    if (ml->fd >= 0) close(ml->fd);
+    free(ml);
+    errno = error;
+    return NULL;
+}
+
+/// Open the world in the file at `path`, or create an empty `width` x `height` one with the
+/// rule `rule` if there is no such file. NULL with `errno` set if that fails.
+MappedLife* mapped_open(const char* path, size_t width, size_t height, const GolRule* rule) {
+    MappedLife* ml = (MappedLife*)calloc(1, sizeof(MappedLife));
+    if (!ml) return NULL;
+
+    struct stat st;
+    ml->fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (ml->fd < 0 || fstat(ml->fd, &st) != 0) return mapped_fail(ml, errno);
+
+    MappedHeader header = {0};
+    const bool created = st.st_size == 0;
+    if (created) {
+        if (width == 0 || height == 0) return mapped_fail(ml, EINVAL);
+
+        memcpy(header.magic, MAPPED_MAGIC, sizeof header.magic);
+        header.version = MAPPED_VERSION;
+        header.edge = UniverseEdge_Dead;
+        header.width = width;
+        header.height = height;
+        header.birth = rule->birth;
+        header.survive = rule->survive;
+    }
+    else {
+        bool valid = pread(ml->fd, &header, sizeof header, 0) == (ssize_t)(sizeof header) &&
+            memcmp(header.magic, MAPPED_MAGIC, sizeof header.magic) == 0 &&
+            header.version == MAPPED_VERSION && header.width != 0 && header.height != 0;
+        if (!valid) return mapped_fail(ml, EINVAL);
+    }
+
+    ml->map_size = MAPPED_HEADER_SIZE + 2 * mapped_buffer_size(header.width, header.height);
+    if (!created && (uint64_t)(st.st_size) < ml->map_size) return mapped_fail(ml, EINVAL);
+    // the file stays sparse, the kernel reads the holes as dead cells
+    if (created && ftruncate(ml->fd, (off_t)(ml->map_size)) != 0) return mapped_fail(ml, errno);
+
+    ml->map = mmap(NULL, ml->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, ml->fd, 0);
+    if (ml->map == MAP_FAILED) return mapped_fail(ml, errno);
+    madvise(ml->map, ml->map_size, MADV_SEQUENTIAL);
+
+    ml->header = (MappedHeader*)(ml->map);
+    if (created) *(ml->header) = header;
+    mapped_bind(ml);
+    ml->universe.counting = false;
+    ml->universe.release = mapped_release_rows;
+    ml->created = created;
+    return ml;
+}
+
+/// Write the world back to the file and close it.
+void mapped_close(MappedLife* ml) {
+    if (!ml) return;
+
+    Universe* uvs = &(ml->universe);
+    // the buffers belong to the mapping
+    uvs->packed.words = uvs->packed.words_next = NULL;
+    universe_deinit(uvs);
+
+    msync(ml->map, ml->map_size, MS_SYNC);
+    munmap(ml->map, ml->map_size);
+    close(ml->fd);
+    free(ml);
+}
+
+#else
+
+// without mmap() there are no file-backed worlds
+MappedLife* mapped_open(const char* path, size_t width, size_t height, const GolRule* rule) {
+    (void)path; (void)width; (void)height; (void)rule;
+    errno = ENOSYS;
+    return NULL;
+}
+
+void mapped_close(MappedLife* ml) {
+    (void)ml;
+}
+
+#endif
+
+/// Step `k` generations in one pass over the file, with temporal blocking if `k` > 1.
+void mapped_step(MappedLife* ml, size_t k) {
+    universe_update_generations(&(ml->universe), k);
+    // nothing was stepped, the world stays at its generation
+    if (paniced) return;
+    ml->header->current ^= 1;
+    ml->header->generation += k;
+}
+
+void mapped_set_rule(MappedLife* ml, const GolRule* rule) {
+    ml->universe.rule = *rule;
+    ml->header->birth = rule->birth;
+    ml->header->survive = rule->survive;
+}
+
+void mapped_set_edge(MappedLife* ml, UniverseEdge edge) {
+    ml->universe.edge = edge;
+    ml->header->edge = (uint32_t)edge;
+}
+
+/// Move the top left corner of the view to (x, y), which stays within the world.
+/// `x` is rounded down to a whole word, so the view copies whole words.
+void mapped_move_view(MappedLife* ml, int64_t x, int64_t y) {
+    const Universe* uvs = &(ml->universe);
+    x = min(max(x, 0), (int64_t)(uvs->width) - 1);
+    y = min(max(y, 0), (int64_t)(uvs->height) - 1);
+    ml->view_x = (size_t)x / 64 * 64;
+    ml->view_y = (size_t)y;
+}
+
+/// Words of the view and rows that lie within the world.
+static inline void mapped_view_extent(const MappedLife* ml, const Universe* view, size_t* words, size_t* rows) {
+    const PackedGrid* g = &(ml->universe.packed);
+    *words = min((view->width + 63) / 64, g->row_words - ml->view_x / 64);
+    *rows = min(view->height, g->height - ml->view_y);
+}
+
+/// Copy the cells of the world under the view into `view`, the cells past the world are dead.
+void mapped_store_universe(const MappedLife* ml, Universe* view) {
+    const PackedGrid* g = &(ml->universe.packed);
+    size_t words, rows;
+    mapped_view_extent(ml, view, &words, &rows);
+
+    universe_fill(view, Dead);
+    for (size_t y = 0; y < rows; y++) {
+        const uint64_t* in = PACKED_ROW(g, g->words, ml->view_y + y) + ml->view_x / 64;
+
+        switch (view->backend) {
+        case UniverseBackend_Bytes: {
+            GolCell* row = UNIVERSE_ROW(view, view->cells, y);
+            size_t width = min(view->width, words * 64);
+            for (size_t x = 0; x < width; x++) row[x] = (in[x / 64] >> (x % 64)) & 1;
+        } break;
+        case UniverseBackend_Packed: {
+            uint64_t* row = PACKED_ROW(&(view->packed), view->packed.words, y);
+            memcpy(row, in, words * sizeof(uint64_t));
+            row[view->packed.row_words - 1] &= view->packed.tail_mask;
+        } break;
+        }
+    }
+}
+
+/// Copy `view` into the world under it, the rest of the world stays as it is.
+void mapped_load_universe(MappedLife* ml, const Universe* view) {
+    PackedGrid* g = &(ml->universe.packed);
+    size_t words, rows;
+    mapped_view_extent(ml, view, &words, &rows);
+
+    for (size_t y = 0; y < rows; y++) {
+        uint64_t* out = PACKED_ROW(g, g->words, ml->view_y + y) + ml->view_x / 64;
+
+        for (size_t k = 0; k < words; k++) {
+            // the last word of the view or of the world may be partly outside the other one
+            uint64_t mask = ~UINT64_C(0);
+            if ((k + 1) * 64 > view->width) mask &= packed_tail_mask(view->width);
+            if (ml->view_x / 64 + k + 1 == g->row_words) mask &= g->tail_mask;
+            out[k] = (out[k] & ~mask) | (universe_word(view, false, y, k) & mask);
+        }
+    }
+}
+
+/// Set the cell at (x, y) of the view in the world.
+void mapped_set(MappedLife* ml, size_t x, size_t y, GolCell to) {
+    x += ml->view_x;
+    y += ml->view_y;
+    if (x < ml->universe.width && y < ml->universe.height) packed_set(&(ml->universe.packed), x, y, to);
+}
+
+/// Fill the world with a random soup like `universe_fill_random`, giving the rows back as it goes.
+void mapped_fill_random(MappedLife* ml, uint64_t seed, float density) {
+    PackedGrid* g = &(ml->universe.packed);
+    GolRng rng = rng_new(seed);
+    const uint32_t steps = rng_density(density);
+
+    for (size_t y = 0, released = 0; y < g->height; y++) {
+        uint64_t* row = PACKED_ROW(g, g->words, y);
+        for (size_t i = 0; i < g->row_words; i++) row[i] = rng_cells(&rng, steps);
+        row[g->row_words - 1] &= g->tail_mask;
+
+        if (ml->universe.release && (y + 1 - released >= MAPPED_FILL_ROWS || y + 1 == g->height)) {
+            ml->universe.release(&(ml->universe), released, y + 1);
+            released = y + 1;
+        }
+    }
+}
+
+static double mapped_now(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+/// `MultiSim --world <generations> [width] [height]` steps the world in MAPPED_DEFAULT_PATH
+/// without opening a window, with all hardware threads. Without the file, it starts one of
+/// `width` x `height` cells from a random soup. Running it again goes on where it stopped.
+int mapped_run(int argc, char** argv) {
+    uint64_t generations = (argc > 0) ? strtoull(argv[0], NULL, 10) : 0;
+    size_t width = (argc > 1) ? strtoull(argv[1], NULL, 10) : MAPPED_DEFAULT_SIZE;
+    size_t height = (argc > 2) ? strtoull(argv[2], NULL, 10) : width;
+    if (generations == 0) {
+        fprintf(stderr, "usage: --world <generations> [width] [height]\n");
+        return 1;
+    }
+
+    GolRule rule = rule_conway();
+    MappedLife* ml = mapped_open(MAPPED_DEFAULT_PATH, width, height, &rule);
+    if (!ml) {
+        fprintf(stderr, "Opening the world %s failed: %s\n", MAPPED_DEFAULT_PATH, strerror(errno));
+        return 1;
+    }
+
+    Universe* uvs = &(ml->universe);
+    const bool created = ml->created;
+    if (created) mapped_fill_random(ml, (uint64_t)time(NULL), GOL_DEFAULT_SOUP_DENSITY);
+    universe_set_threads(uvs, gol_pool_hardware_threads());
+    printf(
+        "%s: %zu x %zu cells, %s, %s at generation %llu, %zu threads\n",
+        MAPPED_DEFAULT_PATH, uvs->width, uvs->height, uvs->rule.name,
+        created ? "new soup" : "resumed", (unsigned long long)(ml->header->generation), universe_threads(uvs)
+    );
+
+    const double start = mapped_now();
+    double last_report = start;
+    for (uint64_t done = 0; done < generations && !paniced;) {
+        size_t k = (size_t)min(generations - done, MAPPED_RUN_PASS);
+        mapped_step(ml, k);
+        done += k;
+
+        double now = mapped_now();
+        if (now - last_report >= 1.0 || done == generations) {
+            last_report = now;
+            printf(
+                "generation %llu, %.2f gen/s\n",
+                (unsigned long long)(ml->header->generation), (double)done / (now - start)
+            );
+            fflush(stdout);
+        }
+    }
+
+    mapped_close(ml);
+    if (paniced) {
+        fprintf(stderr, "%s\n", panic_msg);
+        return 1;
+    }
+    return 0;
+}
+
+#endif
@@ -0,0 +1,356 @@
+#ifndef GOL_PACKED_C_
+#define GOL_PACKED_C_
+
+//! Bit-packed storage for the universe, 64 cells per `uint64_t` word.
+//! Bit `i` of word `w` in a row is the cell at x = w * 64 + i.
+//! Every row is padded with one word on each side and the grid with one row above
+//! and below, so the stepping kernel never has to bounds check. That halo is dead,
+//! or holds the opposite edge when the grid wraps, see `packed_fill_halo`.
+//! The bits past `width` in the last word of a row are kept dead outside of a step.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cell.c"
+#include "rule.c"
+#include "../const.h"
+#include "../panic.h"
+
+typedef struct PackedGrid {
+    uint64_t* words;
+    uint64_t* words_next;
+    size_t width, height;
+    /// number of words holding cells in one row
+    size_t row_words;
+    /// distance in words between two rows, the padding words and room to grow
+    size_t stride;
+    /// rows allocated, the grid grows into them and the spare words of every row in place
+    size_t capacity_height;
+    /// the valid bits of the last word of a row
+    uint64_t tail_mask;
+} PackedGrid;
+
+#define PACKED_ROW(G, BUF, Y) ((BUF) + ((Y) + 1) * (G)->stride + 1)
+
+// what a tile of `packed_step_blocked` should fit in, about the L2 cache
+#define PACKED_TILE_BYTES (256 << 10)
+
+static inline uint64_t packed_tail_mask(size_t width) {
+    return (width % 64) ? (UINT64_C(1) << (width % 64)) - 1 : ~UINT64_C(0);
+}
+
+/// A grid with room to grow to `capacity_width` x `capacity_height` cells without reallocating.
+PackedGrid packed_new_capacity(size_t width, size_t height, size_t capacity_width, size_t capacity_height) {
+    PackedGrid g;
+    g.width = width;
+    g.height = height;
+    g.row_words = (width + 63) / 64;
+    g.stride = (max(width, capacity_width) + 63) / 64 + 2;
+    g.capacity_height = max(height, capacity_height);
+    g.tail_mask = packed_tail_mask(width);
+
+    size_t total = g.stride * (g.capacity_height + 2);
+    g.words = (uint64_t*)calloc(total, sizeof(uint64_t));
+    g.words_next = (uint64_t*)calloc(total, sizeof(uint64_t));
+
+    if (!(g.words) || !(g.words_next)) {
+        panic("Allocation of packed_new failed");
+    }
+
+    return g;
+}
+
+PackedGrid packed_new(size_t width, size_t height) {
+    return packed_new_capacity(width, height, width, height);
+}
+
+void packed_deinit(PackedGrid* g) {
+    free(g->words);
+    free(g->words_next);
+    g->words = g->words_next = NULL;
+}
+
+static inline GolCell packed_get(const PackedGrid* g, size_t x, size_t y) {
+    return (PACKED_ROW(g, g->words, y)[x / 64] >> (x % 64)) & 1;
+}
+
+static inline void packed_set(PackedGrid* g, size_t x, size_t y, GolCell to) {
+    uint64_t* w = &PACKED_ROW(g, g->words, y)[x / 64];
+    uint64_t bit = UINT64_C(1) << (x % 64);
+    *w = to ? (*w | bit) : (*w & ~bit);
+}
+
+/// Set the `n` cells from (x, y) rightwards alive, a word at a time. The run has to fit the row.
+void packed_set_run(PackedGrid* g, size_t x, size_t y, size_t n) {
+    uint64_t* row = PACKED_ROW(g, g->words, y);
+    size_t end = x + n;
+
+    while (x < end) {
+        size_t bits = min(64 - x % 64, end - x);
+        uint64_t mask = (bits == 64) ? ~UINT64_C(0) : ((UINT64_C(1) << bits) - 1) << (x % 64);
+        row[x / 64] |= mask;
+        x += bits;
+    }
+}
+
+void packed_fill(PackedGrid* g, GolCell with) {
+    for (size_t y = 0; y < g->height; y++) {
+        uint64_t* row = PACKED_ROW(g, g->words, y);
+        memset(row, with ? 0xFF : 0x00, g->row_words * sizeof(uint64_t));
+        row[g->row_words - 1] &= g->tail_mask;
+    }
+}
+
+void packed_invert(PackedGrid* g) {
+    for (size_t y = 0; y < g->height; y++) {
+        uint64_t* row = PACKED_ROW(g, g->words, y);
+        for (size_t i = 0; i < g->row_words; i++) row[i] = ~row[i];
+        row[g->row_words - 1] &= g->tail_mask;
+    }
+}
+
+/// Copy a byte-per-cell array of `g->width * g->height` cells, `stride` cells per row, into the grid.
+void packed_load_bytes(PackedGrid* g, const GolCell* cells, size_t stride) {
+    for (size_t y = 0; y < g->height; y++) {
+        uint64_t* row = PACKED_ROW(g, g->words, y);
+        const GolCell* src = cells + y * stride;
+        memset(row, 0, g->row_words * sizeof(uint64_t));
+        for (size_t x = 0; x < g->width; x++) {
+            row[x / 64] |= (uint64_t)(src[x] != 0) << (x % 64);
+        }
+    }
+}
+
+/// Expand the grid into a byte-per-cell array of `g->width * g->height` cells, `stride` cells per row.
+void packed_store_bytes(const PackedGrid* g, GolCell* cells, size_t stride) {
+    for (size_t y = 0; y < g->height; y++) {
+        const uint64_t* row = PACKED_ROW(g, g->words, y);
+        GolCell* dst = cells + y * stride;
+        for (size_t x = 0; x < g->width; x++) {
+            dst[x] = (row[x / 64] >> (x % 64)) & 1;
+        }
+    }
+}
+
+/// Grow the grid, keeping the cells anchored at the top left corner. Within the capacity
+/// only the cells coming into view are cleared, otherwise the grid is reallocated
+/// with room for `capacity_width` x `capacity_height` cells.
+void packed_resize(PackedGrid* g, size_t new_width, size_t new_height, size_t capacity_width, size_t capacity_height) {
+    new_width = max(new_width, g->width);
+    new_height = max(new_height, g->height);
+    size_t new_row_words = (new_width + 63) / 64;
+
+    if (new_row_words + 2 <= g->stride && new_height <= g->capacity_height) {
+        // the bits past the old width, and the padding word that held the halo
+        for (size_t y = 0; y < g->height; y++) {
+            uint64_t* row = PACKED_ROW(g, g->words, y);
+            row[g->row_words - 1] &= g->tail_mask;
+            memset(row + g->row_words, 0, (new_row_words + 1 - g->row_words) * sizeof(uint64_t));
+        }
+        // the rows below, starting with the old bottom halo
+        memset(PACKED_ROW(g, g->words, g->height) - 1, 0, (new_height - g->height) * g->stride * sizeof(uint64_t));
+
+        g->width = new_width;
+        g->height = new_height;
+        g->row_words = new_row_words;
+        g->tail_mask = packed_tail_mask(new_width);
+        return;
+    }
+
+    PackedGrid to = packed_new_capacity(new_width, new_height, capacity_width, capacity_height);
+
+    size_t copy_words = min(g->row_words, to.row_words);
+    size_t copy_rows = min(g->height, to.height);
+
+    for (size_t y = 0; y < copy_rows; y++) {
+        uint64_t* dst = PACKED_ROW(&to, to.words, y);
+        memcpy(dst, PACKED_ROW(g, g->words, y), copy_words * sizeof(uint64_t));
+        dst[to.row_words - 1] &= to.tail_mask;
+    }
+
+    packed_deinit(g);
+    *g = to;
+}
+
+/// Fill the padding words on both sides of one row of cells, see `packed_fill_halo`.
+static inline void packed_pad_row(const PackedGrid* g, uint64_t* row, bool wrap) {
+    const size_t last = g->row_words - 1;
+    const size_t tail = g->width % 64;
+
+    row[last] &= g->tail_mask;
+    row[-1] = 0;
+    row[last + 1] = 0;
+    if (!wrap) return;
+
+    uint64_t first_cell = row[0] & 1;
+    row[-1] = ((row[last] >> ((g->width - 1) % 64)) & 1) << 63;
+    if (tail) row[last] |= first_cell << tail;
+    else row[last + 1] = first_cell;
+}
+
+/// Fill the halo of `words` before a step, dead or with the opposite edges when `wrap`.
+/// Wrapping puts cell `width - 1` in bit 63 of the left padding word, and cell 0 in the
+/// bit right after the last cell, which the step masks off again.
+void packed_fill_halo(PackedGrid* g, bool wrap) {
+    uint64_t* top = g->words;
+    uint64_t* bottom = g->words + (g->height + 1) * g->stride;
+
+    for (size_t y = 0; y < g->height; y++) packed_pad_row(g, PACKED_ROW(g, g->words, y), wrap);
+
+    if (wrap) {
+        // whole rows including their padding, that also covers the corners
+        memcpy(top, g->words + g->height * g->stride, g->stride * sizeof(uint64_t));
+        memcpy(bottom, g->words + g->stride, g->stride * sizeof(uint64_t));
+    }
+    else {
+        memset(top, 0, g->stride * sizeof(uint64_t));
+        memset(bottom, 0, g->stride * sizeof(uint64_t));
+    }
+}
+
+/// Next state of the 64 cells in `b`, given the words around it.
+/// `a*` is the row above, `c*` the row below, `*p` / `*n` the previous / next word.
+/// The eight neighbours are summed with bit-sliced full adders, so every bit
+/// position holds its own 4 bit neighbour count across `s0`..`s3`.
+static inline uint64_t packed_step_word(
+    const GolRule* rule,
+    uint64_t ap, uint64_t a, uint64_t an,
+    uint64_t bp, uint64_t b, uint64_t bn,
+    uint64_t cp, uint64_t c, uint64_t cn
+) {
+    // west (x - 1) and east (x + 1) neighbours, aligned to the cell bit
+    uint64_t aw = (a << 1) | (ap >> 63), ae = (a >> 1) | (an << 63);
+    uint64_t bw = (b << 1) | (bp >> 63), be = (b >> 1) | (bn << 63);
+    uint64_t cw = (c << 1) | (cp >> 63), ce = (c >> 1) | (cn << 63);
+
+    // row above and below: 3 bits each -> 2 bit sums
+    uint64_t a0 = aw ^ a ^ ae, a1 = (aw & a) | (ae & (aw ^ a));
+    uint64_t c0 = cw ^ c ^ ce, c1 = (cw & c) | (ce & (cw ^ c));
+    // middle row: 2 bits -> 2 bit sum
+    uint64_t b0 = bw ^ be, b1 = bw & be;
+
+    // ones
+    uint64_t s0 = a0 ^ b0 ^ c0;
+    uint64_t carry = (a0 & b0) | (c0 & (a0 ^ b0));
+    // twos: a1 + b1 + c1 + carry
+    uint64_t t0 = a1 ^ b1 ^ c1, t1 = (a1 & b1) | (c1 & (a1 ^ b1));
+    uint64_t s1 = t0 ^ carry;
+    uint64_t u = t0 & carry;
+    // fours and eights
+    uint64_t s2 = t1 ^ u;
+    uint64_t s3 = t1 & u;
+
+    return rule_next_sliced(rule, b, s0, s1, s2, s3);
+}
+
+/// Step the rows [y0, y1) from `words` into `words_next`.
+/// Safe to call concurrently on disjoint row ranges.
+void packed_step_rows(PackedGrid* g, const GolRule* rule, size_t y0, size_t y1) {
+    const size_t last = g->row_words - 1;
+
+    for (size_t y = y0; y < y1; y++) {
+        const uint64_t* a = PACKED_ROW(g, g->words, y) - g->stride;
+        const uint64_t* b = PACKED_ROW(g, g->words, y);
+        const uint64_t* c = PACKED_ROW(g, g->words, y) + g->stride;
+        uint64_t* out = PACKED_ROW(g, g->words_next, y);
+
+        for (size_t i = 0; i <= last; i++) {
+            out[i] = packed_step_word(
+                rule,
+                a[i - 1], a[i], a[i + 1],
+                b[i - 1], b[i], b[i + 1],
+                c[i - 1], c[i], c[i + 1]
+            );
+        }
+        out[last] &= g->tail_mask;
+    }
+}
+
+static inline void packed_swap(PackedGrid* g) {
+    uint64_t* tmp = g->words;
+    g->words = g->words_next;
+    g->words_next = tmp;
+}
+
+/// Rows per tile of `packed_step_blocked`: a tile with its halo of `k` rows on both sides
+/// fits in about PACKED_TILE_BYTES, but has at least 4k rows so the halo stays a small part of it.
+size_t packed_tile_rows(const PackedGrid* g, size_t k) {
+    size_t row_bytes = 2 * (g->row_words + 2) * sizeof(uint64_t);
+    size_t fit = PACKED_TILE_BYTES / row_bytes;
+    return max(fit > 2 * k ? fit - 2 * k : 0, 4 * k);
+}
+
+/// Scratch for one tile of `tile_rows` rows of `packed_step_blocked`, free with free().
+uint64_t* packed_tile_alloc(const PackedGrid* g, size_t tile_rows, size_t k) {
+    uint64_t* scratch = (uint64_t*)calloc(2 * (tile_rows + 2 * k) * (g->row_words + 2), sizeof(uint64_t));
+    if (!scratch) panic("Allocation of packed_tile_alloc failed");
+    return scratch;
+}
+
+/// Step the rows [y0, y1) of `words` `k` generations at once into `words_next`, as one tile.
+/// The rows are copied into `scratch` with `k` more rows above and below, which is the most
+/// any cell can be influenced from in `k` generations. Each generation steps one row fewer
+/// at both ends (a trapezoid), so after `k` the rows of the tile are exact and can be stored.
+/// While the tile fits in the cache, the grid is read and written once every `k` generations
+/// instead of every generation. `wrap` takes the place of `packed_fill_halo`.
+/// Safe to call concurrently on disjoint row ranges with their own scratch.
+void packed_step_blocked(PackedGrid* g, const GolRule* rule, bool wrap, size_t k, size_t y0, size_t y1, uint64_t* scratch) {
+    // a local bound: through `g` the compiler has to assume the stores to `out` change it,
+    // which keeps the word loop from being vectorised
+    const size_t row_words = g->row_words;
+    const uint64_t tail_mask = g->tail_mask;
+    const size_t rows = y1 - y0 + 2 * k;
+    const size_t stride = row_words + 2;
+    const int64_t height = (int64_t)(g->height);
+    uint64_t* from = scratch + 1;
+    uint64_t* to = scratch + rows * stride + 1;
+
+    // local row i is the grid row y0 - k + i
+    for (size_t i = 0; i < rows; i++) {
+        int64_t y = (int64_t)y0 - (int64_t)k + (int64_t)i;
+        if (wrap) y = ((y % height) + height) % height;
+
+        if (y < 0 || y >= height) memset(from + i * stride, 0, row_words * sizeof(uint64_t));
+        else memcpy(from + i * stride, PACKED_ROW(g, g->words, (size_t)y), row_words * sizeof(uint64_t));
+    }
+
+    for (size_t s = 1; s <= k; s++) {
+        for (size_t i = s - 1; i < rows - s + 1; i++) packed_pad_row(g, from + i * stride, wrap);
+
+        for (size_t i = s; i < rows - s; i++) {
+            int64_t y = (int64_t)y0 - (int64_t)k + (int64_t)i;
+            uint64_t* out = to + i * stride;
+
+            // past a dead edge the cells stay dead
+            if (!wrap && (y < 0 || y >= height)) {
+                memset(out, 0, row_words * sizeof(uint64_t));
+                continue;
+            }
+
+            const uint64_t* a = from + (i - 1) * stride;
+            const uint64_t* b = from + i * stride;
+            const uint64_t* c = from + (i + 1) * stride;
+            for (size_t w = 0; w < row_words; w++) {
+                out[w] = packed_step_word(
+                    rule,
+                    a[w - 1], a[w], a[w + 1],
+                    b[w - 1], b[w], b[w + 1],
+                    c[w - 1], c[w], c[w + 1]
+                );
+            }
+            out[row_words - 1] &= tail_mask;
+        }
+
+        uint64_t* tmp = from;
+        from = to;
+        to = tmp;
+    }
+
+    for (size_t y = y0; y < y1; y++) {
+        memcpy(PACKED_ROW(g, g->words_next, y), from + (y - y0 + k) * stride, row_words * sizeof(uint64_t));
+    }
+}
+
+#endif
@@ -0,0 +1,646 @@
+#ifndef GOL_PATTERN_C_
+#define GOL_PATTERN_C_
+
+//! Import and export of patterns in the RLE, plaintext (.cells) and Macrocell (.mc) formats.
+//! Files are parsed as a stream through a fixed buffer, so a pattern of hundreds of MB
+//! never sits in memory as text. The parsers hand runs of live cells straight to a
+//! `PatternSink`, which writes them into the storage of the universe, the sparse tiles
+//! or a hashlife builder. Macrocell files are hashlife trees and become hashlife nodes directly.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "cell.c"
+#include "rule.c"
+#include "universe.c"
+#include "hashlife.c"
+#include "sparse.c"
+#include "../const.h"
+
+#define PATTERN_BUFFER_SIZE (1 << 16)
+// lines of RLE files are at most this long
+#define PATTERN_RLE_LINE 70
+
+typedef enum PatternFormat {
+    PatternFormat_Unknown = 0,
+    PatternFormat_RLE,
+    PatternFormat_Cells,
+    PatternFormat_Macrocell,
+} PatternFormat;
+
+static const char* PATTERN_FORMAT_NAMES[] = {
+    [PatternFormat_Unknown] = "unknown",
+    [PatternFormat_RLE] = "RLE",
+    [PatternFormat_Cells] = "plaintext",
+    [PatternFormat_Macrocell] = "Macrocell",
+};
+
+/// What a pattern file says about itself.
+typedef struct PatternInfo {
+    PatternFormat format;
+    /// the size of the pattern, 0 when the file doesn't tell
+    int64_t width, height;
+    bool has_rule;
+    GolRule rule;
+} PatternInfo;
+
+/// Receives `n` live cells from (x, y) rightwards. The text formats deliver the rows top
+/// to bottom, which the hashlife builder relies on.
+typedef struct PatternSink {
+    void (*run)(void* ctx, int64_t x, int64_t y, int64_t n);
+    void* ctx;
+} PatternSink;
+
+typedef struct PatternReader {
+    FILE* file;
+    size_t len, pos;
+    unsigned char buffer[PATTERN_BUFFER_SIZE];
+} PatternReader;
+
+static inline int pattern_getc(PatternReader* r) {
+    if (r->pos == r->len) {
+        r->len = fread(r->buffer, 1, sizeof r->buffer, r->file);
+        r->pos = 0;
+        if (r->len == 0) return EOF;
+    }
+    return r->buffer[r->pos++];
+}
+
+static inline int pattern_peek(PatternReader* r) {
+    int c = pattern_getc(r);
+    if (c != EOF) r->pos--;
+    return c;
+}
+
+/// Read the rest of the line into `line`, cut to `size` - 1 characters.
+static void pattern_read_line(PatternReader* r, char* line, size_t size) {
+    size_t len = 0;
+    int c;
+    while ((c = pattern_getc(r)) != EOF && c != '\n') {
+        if (c != '\r' && len + 1 < size) line[len++] = (char)c;
+    }
+    line[len] = '\0';
+}
+
+static void pattern_skip_line(PatternReader* r) {
+    int c;
+    while ((c = pattern_getc(r)) != EOF && c != '\n') {}
+}
+
+PatternFormat pattern_format_from_path(const char* path) {
+    const char* ext = strrchr(path, '.');
+    if (!ext) return PatternFormat_Unknown;
+
+    if (strcasecmp(ext, ".rle") == 0) return PatternFormat_RLE;
+    if (strcasecmp(ext, ".cells") == 0) return PatternFormat_Cells;
+    if (strcasecmp(ext, ".mc") == 0) return PatternFormat_Macrocell;
+    return PatternFormat_Unknown;
+}
+
+/* RLE */
+
+/// Read the comments and the "x = 3, y = 3, rule = B3/S23" header line.
+static bool pattern_rle_header(PatternReader* r, PatternInfo* info) {
+    char line[256];
+
+    for (;;) {
+        int c = pattern_peek(r);
+        if (c == EOF) return false;
+        if (c == '#' || c == '\n' || c == '\r') {
+            pattern_skip_line(r);
+            continue;
+        }
+        break;
+    }
+    pattern_read_line(r, line, sizeof line);
+
+    long long w = 0, h = 0;
+    if (sscanf(line, " x = %lld , y = %lld", &w, &h) != 2 || w < 0 || h < 0) return false;
+    info->width = w;
+    info->height = h;
+
+    const char* rule = strstr(line, "rule");
+    if (rule && (rule = strchr(rule, '='))) {
+        char text[64] = "";
+        sscanf(rule + 1, " %63[^, \t]", text);
+        info->has_rule = rule_parse(text, &(info->rule));
+    }
+    return true;
+}
+
+/// Decode the cells, with the top left corner of the pattern at (x0, y0).
+static bool pattern_rle_body(PatternReader* r, const PatternSink* sink, int64_t x0, int64_t y0) {
+    int64_t x = 0, y = 0, count = 0;
+    int c;
+
+    while ((c = pattern_getc(r)) != EOF) {
+        if (c >= '0' && c <= '9') {
+            count = count * 10 + (c - '0');
+            continue;
+        }
+
+        int64_t n = count ? count : 1;
+        count = 0;
+        switch (c) {
+        case 'b': case '.': x += n; break;
+        case '$': {
+            y += n;
+            x = 0;
+        } break;
+        case '!': return true;
+        case ' ': case '\t': case '\r': case '\n': break;
+        default: {
+            // 'o', and the letters of multi-state rules, which are all alive here
+            if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')) {
+                sink->run(sink->ctx, x0 + x, y0 + y, n);
+                x += n;
+            }
+            else return false;
+        }
+        }
+    }
+    // a missing '!' is common enough to forgive
+    return true;
+}
+
+/* plaintext */
+
+/// Plaintext files don't say how big they are, so the size takes a pass over the file.
+static void pattern_cells_measure(PatternReader* r, PatternInfo* info) {
+    int64_t x = 0, y = 0;
+    bool comment = false, line_start = true;
+    int c;
+
+    while ((c = pattern_getc(r)) != EOF) {
+        if (line_start) comment = (c == '!');
+        line_start = (c == '\n');
+
+        if (comment) continue;
+        if (c == '\n') {
+            y++;
+            x = 0;
+        }
+        else if (c == 'O' || c == '*') {
+            info->width = max(info->width, x + 1);
+            info->height = y + 1;
+            x++;
+        }
+        else if (c != '\r') x++;
+    }
+}
+
+static bool pattern_cells_body(PatternReader* r, const PatternSink* sink, int64_t x0, int64_t y0) {
+    int64_t x = 0, y = 0, run = 0;
+    bool comment = false, line_start = true;
+    int c;
+
+    for (;;) {
+        c = pattern_getc(r);
+        if (line_start) comment = (c == '!');
+        line_start = (c == '\n');
+
+        if (!comment && (c == 'O' || c == '*')) {
+            run++;
+            x++;
+            continue;
+        }
+        if (run) {
+            sink->run(sink->ctx, x0 + x - run, y0 + y, run);
+            run = 0;
+        }
+        if (c == EOF) return true;
+        if (comment) continue;
+
+        switch (c) {
+        case '\n': {
+            y++;
+            x = 0;
+        } break;
+        case '.': x++; break;
+        case ' ': case '\t': case '\r': break;
+        default: return false;
+        }
+    }
+}
+
+/* Macrocell */
+
+/// Build the hashlife tree of a Macrocell file in `hl`. The origin of the file
+/// becomes the origin of the world.
+static bool pattern_mc_load(PatternReader* r, HashLife* hl, PatternInfo* info) {
+    char line[512];
+    HashNode** nodes = NULL;
+    size_t count = 1, capacity = 0;
+    HashNode** level2 = (HashNode**)calloc(1 << 16, sizeof(HashNode*));
+    bool ok = true;
+
+    if (!level2) {
+        panic("Allocation of the macrocell cache failed");
+        return false;
+    }
+
+    pattern_read_line(r, line, sizeof line);
+    if (strncmp(line, "[M2]", 4) != 0) ok = false;
+
+    while (ok && pattern_peek(r) != EOF) {
+        pattern_read_line(r, line, sizeof line);
+
+        HashNode* node = NULL;
+        if (line[0] == '#') {
+            if (line[1] == 'R') info->has_rule = rule_parse(line + 2, &(info->rule));
+            continue;
+        }
+        else if (line[0] == '.' || line[0] == '*' || line[0] == '$') {
+            // a level 3 leaf, 8 rows of '.' and '*' ended by '$'
+            uint8_t rows[8] = {0};
+            int x = 0, y = 0;
+            for (const char* c = line; *c && ok; c++) {
+                if (*c == '$') {
+                    y++;
+                    x = 0;
+                }
+                else if (x >= 8 || y >= 8) ok = false;
+                else if (*c == '*') rows[y] |= 1 << x++;
+                else if (*c == '.') x++;
+                else ok = false;
+            }
+            node = hashlife_node8(hl, level2, rows);
+        }
+        else if (line[0] >= '1' && line[0] <= '9') {
+            unsigned long level;
+            unsigned long long child[4];
+            if (sscanf(line, "%lu %llu %llu %llu %llu", &level, &child[0], &child[1], &child[2], &child[3]) != 5) {
+                ok = false;
+                break;
+            }
+            if (level < 4 || level > HASHLIFE_MAX_LEVEL) {
+                ok = false;
+                break;
+            }
+
+            HashNode* q[4];
+            for (int i = 0; i < 4 && ok; i++) {
+                if (child[i] >= count) ok = false;
+                else if (child[i] == 0) q[i] = hashlife_empty(hl, level - 1);
+                else if ((q[i] = nodes[child[i]])->level != level - 1) ok = false;
+            }
+            if (ok) node = hashlife_node(hl, q[0], q[1], q[2], q[3]);
+        }
+        else if (line[0] == '\0') continue;
+        else ok = false;
+
+        if (!ok) break;
+        if (count >= capacity) {
+            capacity = capacity ? capacity * 2 : 4096;
+            HashNode** grown = (HashNode**)realloc(nodes, capacity * sizeof(HashNode*));
+            if (!grown) {
+                panic("Allocation of the macrocell nodes failed");
+                ok = false;
+                break;
+            }
+            nodes = grown;
+        }
+        nodes[count++] = node;
+    }
+
+    if (ok && count > 1) {
+        hl->root = nodes[count - 1];
+        hl->generation = 0;
+        info->width = info->height = INT64_C(1) << hl->root->level;
+    }
+    free(nodes);
+    free(level2);
+    return ok && count > 1;
+}
+
+/// Emit the live cells of `n`, whose top left cell is at (x0, y0), in runs of up to 8.
+/// Only the part that overlaps [cx0, cx1) x [cy0, cy1) is walked.
+static void pattern_emit_node(
+    const HashNode* n, int64_t x0, int64_t y0, const PatternSink* sink,
+    int64_t cx0, int64_t cy0, int64_t cx1, int64_t cy1
+) {
+    int64_t size = INT64_C(1) << n->level;
+
+    if (n->population == 0) return;
+    if (x0 >= cx1 || y0 >= cy1 || x0 + size <= cx0 || y0 + size <= cy0) return;
+    if (n->level == 0) {
+        sink->run(sink->ctx, x0, y0, 1);
+        return;
+    }
+
+    int64_t half = size / 2;
+    pattern_emit_node(n->nw, x0, y0, sink, cx0, cy0, cx1, cy1);
+    pattern_emit_node(n->ne, x0 + half, y0, sink, cx0, cy0, cx1, cy1);
+    pattern_emit_node(n->sw, x0, y0 + half, sink, cx0, cy0, cx1, cy1);
+    pattern_emit_node(n->se, x0 + half, y0 + half, sink, cx0, cy0, cx1, cy1);
+}
+
+/* sinks */
+
+static void pattern_universe_run(void* ctx, int64_t x, int64_t y, int64_t n) {
+    Universe* uvs = (Universe*)ctx;
+
+    if (y < 0 || y >= (int64_t)uvs->height) return;
+    int64_t x1 = min(x + n, (int64_t)uvs->width);
+    x = max(x, 0);
+    if (x >= x1) return;
+
+    switch (uvs->backend) {
+    case UniverseBackend_Bytes: memset(UNIVERSE_ROW(uvs, uvs->cells, y) + x, Alive, (size_t)(x1 - x)); break;
+    case UniverseBackend_Packed: packed_set_run(&(uvs->packed), (size_t)x, (size_t)y, (size_t)(x1 - x)); break;
+    }
+}
+
+/// Writes the cells that fall into [0, width) x [0, height) into the universe.
+static inline PatternSink pattern_universe_sink(Universe* uvs) {
+    return (PatternSink){ .run = pattern_universe_run, .ctx = uvs };
+}
+
+static void pattern_sparse_run(void* ctx, int64_t x, int64_t y, int64_t n) {
+    for (int64_t i = 0; i < n; i++) sparse_set((SparseLife*)ctx, x + i, y, Alive);
+}
+
+static inline PatternSink pattern_sparse_sink(SparseLife* sl) {
+    return (PatternSink){ .run = pattern_sparse_run, .ctx = sl };
+}
+
+static void pattern_builder_run(void* ctx, int64_t x, int64_t y, int64_t n) {
+    hashlife_builder_run((HashlifeBuilder*)ctx, x, y, n);
+}
+
+static inline PatternSink pattern_builder_sink(HashlifeBuilder* b) {
+    return (PatternSink){ .run = pattern_builder_run, .ctx = b };
+}
+
+/* loading */
+
+/// Where a pattern goes, exactly one of the targets is set.
+typedef struct PatternTarget {
+    Universe* universe;
+    HashLife* hashlife;
+    SparseLife* sparse;
+    /// the RLE and plaintext patterns are centred on this cell,
+    /// Macrocell files keep their own coordinates
+    int64_t centre_x, centre_y;
+} PatternTarget;
+
+/// Replace the cells of `target` with the pattern in the file at `path`.
+/// Returns false when the file can't be read, and leaves `target` in some state in between
+/// when it is not a valid pattern.
+bool pattern_load(const char* path, PatternTarget* target, PatternInfo* info) {
+    memset(info, 0, sizeof(PatternInfo));
+    info->format = pattern_format_from_path(path);
+    if (info->format == PatternFormat_Unknown) return false;
+
+    PatternReader* r = (PatternReader*)malloc(sizeof(PatternReader));
+    if (!r) {
+        panic("Allocation of the pattern reader failed");
+        return false;
+    }
+    r->len = r->pos = 0;
+    r->file = fopen(path, "rb");
+    if (!(r->file)) {
+        free(r);
+        return false;
+    }
+
+    bool ok = false;
+    switch (info->format) {
+    case PatternFormat_Macrocell: {
+        HashLife* hl = target->hashlife ? target->hashlife : hashlife_alloc();
+
+        ok = pattern_mc_load(r, hl, info);
+        if (ok && !(target->hashlife)) {
+            int64_t half = INT64_C(1) << (hl->root->level - 1);
+            int64_t cx0 = INT64_MIN, cy0 = INT64_MIN, cx1 = INT64_MAX, cy1 = INT64_MAX;
+            PatternSink sink;
+            if (target->universe) {
+                sink = pattern_universe_sink(target->universe);
+                cx0 = cy0 = 0;
+                cx1 = (int64_t)target->universe->width;
+                cy1 = (int64_t)target->universe->height;
+            }
+            else sink = pattern_sparse_sink(target->sparse);
+            pattern_emit_node(hl->root, -half, -half, &sink, cx0, cy0, cx1, cy1);
+        }
+        if (!(target->hashlife)) hashlife_free(hl);
+    } break;
+    case PatternFormat_RLE:
+    case PatternFormat_Cells: {
+        if (info->format == PatternFormat_RLE) {
+            if (!pattern_rle_header(r, info)) break;
+        }
+        else {
+            pattern_cells_measure(r, info);
+            rewind(r->file);
+            r->len = r->pos = 0;
+        }
+
+        int64_t x0 = target->centre_x - info->width / 2;
+        int64_t y0 = target->centre_y - info->height / 2;
+        HashlifeBuilder* builder = NULL;
+        PatternSink sink;
+
+        if (target->hashlife) {
+            builder = (HashlifeBuilder*)malloc(sizeof(HashlifeBuilder));
+            if (!builder) {
+                panic("Allocation of the hashlife builder failed");
+                break;
+            }
+            if (!hashlife_builder_begin(builder, target->hashlife, x0, y0, x0 + info->width, y0 + info->height)) {
+                free(builder);
+                break;
+            }
+            sink = pattern_builder_sink(builder);
+        }
+        else if (target->universe) sink = pattern_universe_sink(target->universe);
+        else sink = pattern_sparse_sink(target->sparse);
+
+        ok = (info->format == PatternFormat_RLE) ?
+            pattern_rle_body(r, &sink, x0, y0) :
+            pattern_cells_body(r, &sink, x0, y0);
+
+        if (builder) {
+            hashlife_builder_finish(builder);
+            free(builder);
+        }
+    } break;
+    default: {}
+    }
+
+    fclose(r->file);
+    free(r);
+    return ok;
+}
+
+/* saving */
+
+/// The bounding box of the live cells of `uvs`, false if there are none.
+static bool pattern_universe_bounds(Universe* uvs, size_t* x0, size_t* y0, size_t* x1, size_t* y1) {
+    *x0 = uvs->width;
+    *y0 = uvs->height;
+    *x1 = *y1 = 0;
+
+    for (size_t y = 0; y < uvs->height; y++) {
+        for (size_t x = 0; x < uvs->width; x++) {
+            if (!universe_get(uvs, x, y)) continue;
+            *x0 = min(*x0, x);
+            *x1 = max(*x1, x + 1);
+            *y0 = min(*y0, y);
+            *y1 = y + 1;
+        }
+    }
+    return *x1 > 0;
+}
+
+typedef struct PatternRleWriter {
+    FILE* file;
+    size_t line_len;
+} PatternRleWriter;
+
+static void pattern_rle_put(PatternRleWriter* w, size_t count, char tag) {
+    char item[24];
+    int len = (count > 1) ? snprintf(item, sizeof item, "%zu%c", count, tag) : snprintf(item, sizeof item, "%c", tag);
+
+    if (w->line_len + len > PATTERN_RLE_LINE) {
+        fputc('\n', w->file);
+        w->line_len = 0;
+    }
+    fputs(item, w->file);
+    w->line_len += len;
+}
+
+/// Save the live cells of `uvs` as RLE.
+bool pattern_save_rle(const char* path, Universe* uvs) {
+    FILE* file = fopen(path, "wb");
+    if (!file) return false;
+
+    size_t x0, y0, x1, y1;
+    if (!pattern_universe_bounds(uvs, &x0, &y0, &x1, &y1)) x0 = y0 = x1 = y1 = 0;
+
+    fprintf(file, "#C Saved by MultiSim\nx = %zu, y = %zu, rule = %s\n", x1 - x0, y1 - y0, uvs->rule.name);
+
+    PatternRleWriter w = { .file = file, .line_len = 0 };
+    // row ends not written yet, they are merged into one "n$"
+    size_t row_ends = 0;
+    for (size_t y = y0; y < y1; y++) {
+        size_t x = x0;
+        while (x < x1) {
+            GolCell tag = universe_get(uvs, x, y);
+            size_t run = 1;
+            while (x + run < x1 && universe_get(uvs, x + run, y) == tag) run++;
+            // dead cells at the end of a row are left out
+            if (!tag && x + run == x1) break;
+
+            if (row_ends) pattern_rle_put(&w, row_ends, '$');
+            row_ends = 0;
+            pattern_rle_put(&w, run, tag ? 'o' : 'b');
+            x += run;
+        }
+        row_ends++;
+    }
+    pattern_rle_put(&w, 1, '!');
+    fputc('\n', file);
+
+    bool ok = !ferror(file);
+    fclose(file);
+    return ok;
+}
+
+/// Save the live cells of `uvs` as plaintext.
+bool pattern_save_cells(const char* path, Universe* uvs) {
+    FILE* file = fopen(path, "wb");
+    if (!file) return false;
+
+    size_t x0, y0, x1, y1;
+    if (!pattern_universe_bounds(uvs, &x0, &y0, &x1, &y1)) x0 = y0 = x1 = y1 = 0;
+
+    fprintf(file, "!Name: MultiSim\n!Rule: %s\n", uvs->rule.name);
+    for (size_t y = y0; y < y1; y++) {
+        size_t end = x0;
+        for (size_t x = x0; x < x1; x++) {
+            if (universe_get(uvs, x, y)) end = x + 1;
+        }
+        for (size_t x = x0; x < end; x++) fputc(universe_get(uvs, x, y) ? 'O' : '.', file);
+        fputc('\n', file);
+    }
+
+    bool ok = !ferror(file);
+    fclose(file);
+    return ok;
+}
+
+/// Write the nodes below `n` children first, numbering them from `*next` on in `marked`.
+/// Empty nodes are 0 and not written.
+static uint32_t pattern_mc_write(FILE* file, HashNode* n, uint32_t* next) {
+    if (n->population == 0) return 0;
+    if (n->marked) return n->marked;
+
+    if (n->level == 3) {
+        // 8 rows of '.' and '*', each ended by '$', empty rows at the end left out
+        char line[8 * 9 + 2];
+        size_t len = 0, end = 0;
+        for (int y = 0; y < 8; y++) {
+            size_t row_end = len;
+            for (int x = 0; x < 8; x++) {
+                HashNode* q = (y < 4) ? ((x < 4) ? n->nw : n->ne) : ((x < 4) ? n->sw : n->se);
+                HashNode* c = ((y % 4) < 2) ? (((x % 4) < 2) ? q->nw : q->ne) : (((x % 4) < 2) ? q->sw : q->se);
+                HashNode* leaf = ((y % 2) == 0) ? (((x % 2) == 0) ? c->nw : c->ne) : (((x % 2) == 0) ? c->sw : c->se);
+                line[len++] = leaf->population ? '*' : '.';
+                if (leaf->population) row_end = len;
+            }
+            len = row_end;
+            line[len++] = '$';
+            if (row_end > 0 && line[row_end - 1] == '*') end = len;
+        }
+        line[end] = '\0';
+        fprintf(file, "%s\n", line);
+    }
+    else {
+        uint32_t nw = pattern_mc_write(file, n->nw, next);
+        uint32_t ne = pattern_mc_write(file, n->ne, next);
+        uint32_t sw = pattern_mc_write(file, n->sw, next);
+        uint32_t se = pattern_mc_write(file, n->se, next);
+        fprintf(file, "%u %u %u %u %u\n", n->level, nw, ne, sw, se);
+    }
+    return n->marked = (*next)++;
+}
+
+static void pattern_mc_unmark(HashNode* n) {
+    if (!(n->marked)) return;
+    n->marked = 0;
+    if (n->level > 3) {
+        pattern_mc_unmark(n->nw);
+        pattern_mc_unmark(n->ne);
+        pattern_mc_unmark(n->sw);
+        pattern_mc_unmark(n->se);
+    }
+}
+
+/// Save the whole world of `hl` as Macrocell, the origin of the world is the origin of the file.
+bool pattern_save_mc(const char* path, HashLife* hl) {
+    FILE* file = fopen(path, "wb");
+    if (!file) return false;
+
+    fprintf(file, "[M2] (MultiSim)\n#R %s\n", hl->rule.name);
+
+    if (hl->root->population == 0) {
+        // a file needs at least one node, an empty leaf
+        fputs("$\n", file);
+    }
+    else {
+        uint32_t next = 1;
+        pattern_mc_write(file, hl->root, &next);
+        pattern_mc_unmark(hl->root);
+    }
+
+    bool ok = !ferror(file);
+    fclose(file);
+    return ok;
+}
+
+#endif
@@ -0,0 +1,171 @@
+#ifndef GOL_POOL_C_
+#define GOL_POOL_C_
+
+//! A persistent pool of worker threads that split a grid into row bands.
+//! The threads are created once and sleep on a condition variable between jobs,
+//! so running a generation costs a wake-up instead of a thread creation.
+//! The calling thread works on bands too, `gol_pool_run` returns once all are done.
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "../const.h"
+#include "../panic.h"
+
+#ifdef _WIN32
+// avoid <windows.h>, it clashes with raylib
+__declspec(dllimport) unsigned long __stdcall GetActiveProcessorCount(unsigned short group);
+#else
+#  include <unistd.h>
+#endif
+
+#define GOL_POOL_MAX_THREADS 64
+// bands per thread, more bands balance uneven rows better
+#define GOL_POOL_BANDS_PER_THREAD 4
+
+/// Process the rows [y0, y1) of the grid in `ctx`.
+typedef void (*GolPoolJob)(void* ctx, size_t y0, size_t y1);
+
+typedef struct GolPool {
+    pthread_t threads[GOL_POOL_MAX_THREADS];
+    /// total threads working on a job, including the caller of `gol_pool_run`
+    size_t thread_count;
+
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t done;
+
+    // the current job, written under `lock` before bumping `generation`
+    // and left alone until every worker has reported back in `workers_done`
+    GolPoolJob job;
+    void* ctx;
+    size_t rows;
+    size_t band_rows;
+    size_t bands;
+    uint64_t generation;
+    size_t workers_done;
+    bool quit;
+
+    atomic_size_t next_band;
+} GolPool;
+
+/// Number of hardware threads available to the process.
+size_t gol_pool_hardware_threads(void) {
+#ifdef _WIN32
+    long n = (long)GetActiveProcessorCount(0xffff);
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    return (size_t)min(max(n, 1), GOL_POOL_MAX_THREADS);
+}
+
+/// Grab bands until there are none left.
+static void gol_pool_work(GolPool* p) {
+    size_t band;
+
+    while ((band = atomic_fetch_add(&(p->next_band), 1)) < p->bands) {
+        size_t y0 = band * p->band_rows;
+        size_t y1 = min(y0 + p->band_rows, p->rows);
+        p->job(p->ctx, y0, y1);
+    }
+}
+
+static void* gol_pool_worker(void* arg) {
+    GolPool* p = (GolPool*)arg;
+    uint64_t seen = 0;
+
+    pthread_mutex_lock(&(p->lock));
+    for (;;) {
+        while (p->generation == seen && !(p->quit)) {
+            pthread_cond_wait(&(p->wake), &(p->lock));
+        }
+        if (p->quit) break;
+        seen = p->generation;
+        pthread_mutex_unlock(&(p->lock));
+
+        gol_pool_work(p);
+
+        pthread_mutex_lock(&(p->lock));
+        if (++(p->workers_done) == p->thread_count - 1) {
+            pthread_cond_signal(&(p->done));
+        }
+    }
+    pthread_mutex_unlock(&(p->lock));
+    return NULL;
+}
+
+/// Start a pool of `thread_count` threads (the caller counts as one of them).
+GolPool* gol_pool_new(size_t thread_count) {
+    GolPool* p = (GolPool*)calloc(1, sizeof(GolPool));
+    if (!p) {
+        panic("Allocation of gol_pool_new failed");
+        return NULL;
+    }
+
+    p->thread_count = min(max(thread_count, 1), GOL_POOL_MAX_THREADS);
+    pthread_mutex_init(&(p->lock), NULL);
+    pthread_cond_init(&(p->wake), NULL);
+    pthread_cond_init(&(p->done), NULL);
+
+    for (size_t i = 1; i < p->thread_count; i++) {
+        if (pthread_create(&(p->threads[i]), NULL, gol_pool_worker, p) != 0) {
+            // run with the threads that did start
+            p->thread_count = i;
+            break;
+        }
+    }
+    return p;
+}
+
+void gol_pool_free(GolPool* p) {
+    if (!p) return;
+
+    pthread_mutex_lock(&(p->lock));
+    p->quit = true;
+    pthread_cond_broadcast(&(p->wake));
+    pthread_mutex_unlock(&(p->lock));
+
+    for (size_t i = 1; i < p->thread_count; i++) {
+        pthread_join(p->threads[i], NULL);
+    }
+
+    pthread_cond_destroy(&(p->done));
+    pthread_cond_destroy(&(p->wake));
+    pthread_mutex_destroy(&(p->lock));
+    free(p);
+}
+
+/// Run `job` over the rows [0, rows) split into bands and wait for it to finish.
+void gol_pool_run(GolPool* p, GolPoolJob job, void* ctx, size_t rows) {
+    if (p->thread_count <= 1 || rows < p->thread_count) {
+        job(ctx, 0, rows);
+        return;
+    }
+
+    size_t bands = min(rows, p->thread_count * GOL_POOL_BANDS_PER_THREAD);
+
+    pthread_mutex_lock(&(p->lock));
+    p->job = job;
+    p->ctx = ctx;
+    p->rows = rows;
+    p->band_rows = (rows + bands - 1) / bands;
+    p->bands = (rows + p->band_rows - 1) / p->band_rows;
+    p->workers_done = 0;
+    atomic_store(&(p->next_band), 0);
+    p->generation++;
+    pthread_cond_broadcast(&(p->wake));
+    pthread_mutex_unlock(&(p->lock));
+
+    gol_pool_work(p);
+
+    pthread_mutex_lock(&(p->lock));
+    while (p->workers_done < p->thread_count - 1) {
+        pthread_cond_wait(&(p->done), &(p->lock));
+    }
+    pthread_mutex_unlock(&(p->lock));
+}
+
+#endif
@@ -0,0 +1,218 @@
+#ifndef GOL_REGION_C_
+#define GOL_REGION_C_
+
+//! Rectangles of cells cut out of the universe, for the selection of the editor.
+//! A region holds its cells bit-packed like the packed backend, 64 to a word, and moves
+//! them in and out of the universe a word at a time: a row of the packed backend is read
+//! and written with shifted words, one of the byte backend is packed and unpacked 64
+//! cells at a time. Rotating goes through 64 x 64 bit transposes, flipping left to right
+//! through reversed words.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "packed.c"
+#include "universe.c"
+#include "../const.h"
+#include "../panic.h"
+
+#define Cell GolCell
+
+typedef struct GolRegion {
+    size_t width, height;
+    /// words per row, the bits past `width` are dead
+    size_t row_words;
+    uint64_t* words;
+} GolRegion;
+
+#define REGION_ROW(R, Y) ((R)->words + (Y) * (R)->row_words)
+
+/// An empty region of `width` x `height` dead cells.
+GolRegion region_new(size_t width, size_t height) {
+    GolRegion r = { .width = width, .height = height, .row_words = (width + 63) / 64 };
+    if (r.row_words * height == 0) return r;
+
+    r.words = (uint64_t*)calloc(r.row_words * height, sizeof(uint64_t));
+    if (!(r.words)) {
+        panic("Allocation of region_new failed");
+        r.width = r.height = r.row_words = 0;
+    }
+    return r;
+}
+
+void region_deinit(GolRegion* r) {
+    free(r->words);
+    *r = (GolRegion){0};
+}
+
+static inline bool region_empty(const GolRegion* r) {
+    return r->width == 0 || r->height == 0;
+}
+
+/// Clip the rectangle at (x, y) to the universe, false if nothing of it is left.
+static inline bool region_clip(const Universe* uvs, size_t x, size_t y, size_t* w, size_t* h) {
+    if (x >= uvs->width || y >= uvs->height) return false;
+    *w = min(*w, uvs->width - x);
+    *h = min(*h, uvs->height - y);
+    return *w > 0 && *h > 0;
+}
+
+/// Read the `w` cells from (x, y) rightwards into the words `out`.
+static void region_read_row(const Universe* uvs, size_t x, size_t y, size_t w, uint64_t* out) {
+    const size_t words = (w + 63) / 64;
+
+    switch (uvs->backend) {
+    case UniverseBackend_Bytes: {
+        const Cell* row = UNIVERSE_ROW(uvs, uvs->cells, y) + x;
+        for (size_t k = 0; k < words; k++) out[k] = universe_pack_word(row + k * 64, min(w - k * 64, 64));
+    } break;
+    case UniverseBackend_Packed: {
+        // the word past the last one is padding, so reading it is safe
+        const uint64_t* row = PACKED_ROW(&(uvs->packed), uvs->packed.words, y) + x / 64;
+        const unsigned s = x % 64;
+        for (size_t k = 0; k < words; k++) out[k] = s ? (row[k] >> s) | (row[k + 1] << (64 - s)) : row[k];
+        out[words - 1] &= packed_tail_mask(w);
+    } break;
+    }
+}
+
+/// Write the words `in` over the `w` cells from (x, y) rightwards.
+static void region_write_row(Universe* uvs, size_t x, size_t y, size_t w, const uint64_t* in) {
+    const size_t words = (w + 63) / 64;
+
+    switch (uvs->backend) {
+    case UniverseBackend_Bytes: {
+        Cell* row = UNIVERSE_ROW(uvs, uvs->cells, y) + x;
+        for (size_t k = 0; k < words; k++) universe_unpack_word(row + k * 64, in[k], min(w - k * 64, 64));
+    } break;
+    case UniverseBackend_Packed: {
+        uint64_t* row = PACKED_ROW(&(uvs->packed), uvs->packed.words, y) + x / 64;
+        const unsigned s = x % 64;
+        for (size_t k = 0; k < words; k++) {
+            const uint64_t mask = (k + 1 == words) ? packed_tail_mask(w) : ~UINT64_C(0);
+            const uint64_t bits = in[k] & mask;
+            row[k] = (row[k] & ~(mask << s)) | (bits << s);
+            if (s) row[k + 1] = (row[k + 1] & ~(mask >> (64 - s))) | (bits >> (64 - s));
+        }
+    } break;
+    }
+}
+
+/// Copy the `w` x `h` cells at (x, y) of the universe into `r`, as much of them as there is.
+void region_copy(GolRegion* r, const Universe* uvs, size_t x, size_t y, size_t w, size_t h) {
+    region_deinit(r);
+    if (!region_clip(uvs, x, y, &w, &h)) return;
+
+    *r = region_new(w, h);
+    if (region_empty(r)) return;
+    for (size_t j = 0; j < h; j++) region_read_row(uvs, x, y + j, w, REGION_ROW(r, j));
+}
+
+/// Overwrite the cells of the universe at (x, y) with `r`, dead cells too, clipped at its edges.
+void region_paste(const GolRegion* r, Universe* uvs, size_t x, size_t y) {
+    size_t w = r->width, h = r->height;
+    if (region_empty(r) || !region_clip(uvs, x, y, &w, &h)) return;
+
+    universe_changed(uvs);
+    for (size_t j = 0; j < h; j++) region_write_row(uvs, x, y + j, w, REGION_ROW(r, j));
+}
+
+/// Set the `w` x `h` cells at (x, y) of the universe to `with`, clipped at its edges.
+void region_fill(Universe* uvs, size_t x, size_t y, size_t w, size_t h, Cell with) {
+    if (!region_clip(uvs, x, y, &w, &h)) return;
+
+    universe_changed(uvs);
+    for (size_t j = 0; j < h; j++) {
+        switch (uvs->backend) {
+        case UniverseBackend_Bytes: memset(UNIVERSE_ROW(uvs, uvs->cells, y + j) + x, with, w); break;
+        case UniverseBackend_Packed: {
+            uint64_t* row = PACKED_ROW(&(uvs->packed), uvs->packed.words, y + j);
+            for (size_t i = x / 64; i <= (x + w - 1) / 64; i++) {
+                const size_t lo = max(x, i * 64) - i * 64, hi = min(x + w, i * 64 + 64) - i * 64;
+                const uint64_t mask = ((hi - lo == 64) ? ~UINT64_C(0) : (UINT64_C(1) << (hi - lo)) - 1) << lo;
+                row[i] = with ? (row[i] | mask) : (row[i] & ~mask);
+            }
+        } break;
+        }
+    }
+}
+
+/// Transpose a 64 x 64 bit matrix in place: bit c of word r goes to bit r of word c.
+static void region_transpose64(uint64_t a[64]) {
+    uint64_t m = UINT64_C(0x00000000FFFFFFFF);
+    for (unsigned j = 32; j; j >>= 1, m ^= m << j) {
+        for (unsigned k = 0; k < 64; k = ((k | j) + 1) & ~j) {
+            const uint64_t t = ((a[k] >> j) ^ a[k | j]) & m;
+            a[k | j] ^= t;
+            a[k] ^= t << j;
+        }
+    }
+}
+
+static inline uint64_t region_reverse64(uint64_t v) {
+    v = ((v >> 1) & UINT64_C(0x5555555555555555)) | ((v & UINT64_C(0x5555555555555555)) << 1);
+    v = ((v >> 2) & UINT64_C(0x3333333333333333)) | ((v & UINT64_C(0x3333333333333333)) << 2);
+    v = ((v >> 4) & UINT64_C(0x0F0F0F0F0F0F0F0F)) | ((v & UINT64_C(0x0F0F0F0F0F0F0F0F)) << 4);
+    return __builtin_bswap64(v);
+}
+
+/// Mirror the cells of every row, left to right.
+void region_flip_x(GolRegion* r) {
+    const size_t n = r->row_words;
+    // the reversed row starts with the dead bits past `width`
+    const unsigned pad = (unsigned)(n * 64 - r->width);
+
+    for (size_t y = 0; y < r->height; y++) {
+        uint64_t* row = REGION_ROW(r, y);
+        for (size_t k = 0; k < n / 2; k++) {
+            const uint64_t t = region_reverse64(row[k]);
+            row[k] = region_reverse64(row[n - 1 - k]);
+            row[n - 1 - k] = t;
+        }
+        if (n % 2) row[n / 2] = region_reverse64(row[n / 2]);
+        if (!pad) continue;
+
+        for (size_t k = 0; k + 1 < n; k++) row[k] = (row[k] >> pad) | (row[k + 1] << (64 - pad));
+        row[n - 1] >>= pad;
+    }
+}
+
+/// Mirror the rows, top to bottom.
+void region_flip_y(GolRegion* r) {
+    for (size_t y = 0; y < r->height / 2; y++) {
+        uint64_t* a = REGION_ROW(r, y);
+        uint64_t* b = REGION_ROW(r, r->height - 1 - y);
+        for (size_t k = 0; k < r->row_words; k++) {
+            const uint64_t t = a[k];
+            a[k] = b[k];
+            b[k] = t;
+        }
+    }
+}
+
+/// Turn the region a quarter clockwise, its width and height swap.
+void region_rotate(GolRegion* r) {
+    if (region_empty(r)) return;
+    GolRegion to = region_new(r->height, r->width);
+    if (region_empty(&to)) return;
+
+    // a 64 x 64 block of cells at a time: transposed, the rows of the block come out as
+    // the columns, then mirroring the rows left to right turns it clockwise
+    uint64_t block[64];
+    for (size_t by = 0; by < r->height; by += 64) {
+        for (size_t k = 0; k < r->row_words; k++) {
+            for (size_t i = 0; i < 64; i++) block[i] = (by + i < r->height) ? REGION_ROW(r, by + i)[k] : 0;
+            region_transpose64(block);
+            for (size_t i = 0; i < 64 && k * 64 + i < to.height; i++) REGION_ROW(&to, k * 64 + i)[by / 64] = block[i];
+        }
+    }
+    region_flip_x(&to);
+
+    region_deinit(r);
+    *r = to;
+}
+
+#undef Cell
+#endif
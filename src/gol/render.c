@@ -0,0 +1,363 @@
+#ifndef GOL_RENDER_C_
+#define GOL_RENDER_C_
+
+//! Drawing the cells of a frame as one quad. The cells go into a texture of a byte per
+//! cell, updated with `UpdateTexture` every frame, and a fragment shader picks the glyph
+//! of every cell out of the font atlas. Every pixel looks at the cells whose glyph can
+//! reach it, in the order the per-cell text draws used to go, and blends their glyphs
+//! the same way, so the picture doesn't change, only the draw calls: one instead of
+//! one per cell.
+//! The picture is kept in a render texture between frames. A new frame is diffed against
+//! the last one drawn a word of cells at a time, and only the cells that changed, and
+//! the ones their glyphs reach, are drawn again. The theme or size changing draws it all.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "raylib.h"
+
+#include "packed.c"
+#include "sim.c"
+#include "theme.c"
+#include "universe.c"
+#include "../const.h"
+#include "../panic.h"
+#include "../ui/font.c"
+
+#define Cell GolCell
+
+// how many cells away a glyph may still draw over, further ones are cut off
+#define RENDER_MAX_REACH 4
+
+/// Cells [x0, x1] of row y.
+typedef struct RenderSpan {
+    size_t y, x0, x1;
+} RenderSpan;
+
+static const char* RENDER_SHADER =
+    "#version 330\n"
+    "in vec2 fragTexCoord;\n"
+    "out vec4 finalColor;\n"
+    // the cells, a byte each
+    "uniform sampler2D texture0;\n"
+    "uniform sampler2D atlas;\n"
+    // per state, dead and alive: where the glyph is in the atlas, where it goes
+    // relative to the corner of its cell and what it's tinted with
+    "uniform vec4 glyph_src[2];\n"
+    "uniform vec4 glyph_dst[2];\n"
+    "uniform vec4 glyph_tint[2];\n"
+    "uniform float cell_size;\n"
+    "uniform int reach;\n"
+    // Midnight fills the dead cells with the background, the live ones and their glyph
+    // with the color of their position
+    "uniform int fill;\n"
+    "uniform vec4 background;\n"
+    "void main() {\n"
+    "    ivec2 grid = textureSize(texture0, 0);\n"
+    "    vec2 atlas_size = vec2(textureSize(atlas, 0));\n"
+    "    vec2 p = fragTexCoord * vec2(grid) * cell_size;\n"
+    "    ivec2 here = ivec2(floor(fragTexCoord * vec2(grid)));\n"
+    // blended premultiplied, like drawing one over the other on the background would
+    "    vec3 rgb = vec3(0.0);\n"
+    "    float a = 0.0;\n"
+    "    for (int dy = -reach; dy <= reach; dy++) {\n"
+    "        for (int dx = -reach; dx <= reach; dx++) {\n"
+    "            ivec2 c = here + ivec2(dx, dy);\n"
+    "            if (any(lessThan(c, ivec2(0))) || any(greaterThanEqual(c, grid))) continue;\n"
+    "            int alive = texelFetch(texture0, c, 0).r > 0.0 ? 1 : 0;\n"
+    "            vec4 position_color = vec4(mod(vec2(c), 256.0) / 255.0, 100.0 / 255.0, 1.0);\n"
+    "            if (fill != 0 && dx == 0 && dy == 0) {\n"
+    "                rgb = (alive == 1) ? position_color.rgb : background.rgb;\n"
+    "                a = 1.0;\n"
+    "            }\n"
+    "            vec4 dst = glyph_dst[alive];\n"
+    "            if (dst.z <= 0.0) continue;\n"
+    "            vec2 q = (p - vec2(c) * cell_size - dst.xy) / dst.zw;\n"
+    "            if (any(lessThan(q, vec2(0.0))) || any(greaterThanEqual(q, vec2(1.0)))) continue;\n"
+    "            vec4 src = glyph_src[alive];\n"
+    "            vec4 tint = (fill != 0 && alive == 1) ? position_color : glyph_tint[alive];\n"
+    "            vec4 g = texture(atlas, (src.xy + q * src.zw) / atlas_size) * tint;\n"
+    "            rgb = rgb * (1.0 - g.a) + g.rgb * g.a;\n"
+    "            a = a + g.a * (1.0 - a);\n"
+    "        }\n"
+    "    }\n"
+    // opaque, so drawing a cell again replaces what was there
+    "    finalColor = vec4(rgb + background.rgb * (1.0 - a), 1.0);\n"
+    "}\n";
+
+typedef struct GolRender {
+    Shader shader;
+    // false when the shader didn't compile, the cells are drawn one by one then
+    bool ready;
+    int loc_atlas, loc_glyph_src, loc_glyph_dst, loc_glyph_tint;
+    int loc_cell_size, loc_reach, loc_fill, loc_background;
+    Texture2D cells;
+    // what goes into `cells`, a byte per cell
+    Cell* bytes;
+    // the cells as they were last drawn into `target`, the next frame is diffed against them
+    uint64_t* shown;
+    RenderTexture2D target;
+    size_t width, height, row_words;
+    // what `target` was drawn with, it's drawn again from scratch when that changes
+    bool drawn;
+    GolTheme theme;
+    // the cells that changed, runs of a row
+    RenderSpan* spans;
+    size_t span_count, span_capacity;
+} GolRender;
+
+/// Compile the shader, needs the window to be open.
+GolRender render_new(void) {
+    GolRender r = {0};
+
+    r.shader = LoadShaderFromMemory(NULL, RENDER_SHADER);
+    r.loc_atlas = GetShaderLocation(r.shader, "atlas");
+    r.loc_glyph_src = GetShaderLocation(r.shader, "glyph_src");
+    r.loc_glyph_dst = GetShaderLocation(r.shader, "glyph_dst");
+    r.loc_glyph_tint = GetShaderLocation(r.shader, "glyph_tint");
+    r.loc_cell_size = GetShaderLocation(r.shader, "cell_size");
+    r.loc_reach = GetShaderLocation(r.shader, "reach");
+    r.loc_fill = GetShaderLocation(r.shader, "fill");
+    r.loc_background = GetShaderLocation(r.shader, "background");
+
+    // a shader that fails to compile is replaced by the default one, which has none of these
+    r.ready = IsShaderReady(r.shader) && r.loc_atlas >= 0 && r.loc_glyph_dst >= 0;
+    if (!(r.ready)) TraceLog(LOG_WARNING, "GOL: cell shader unavailable, drawing the cells one by one");
+    return r;
+}
+
+static void render_unload(GolRender* r) {
+    if (r->cells.id) UnloadTexture(r->cells);
+    if (r->target.id) UnloadRenderTexture(r->target);
+    free(r->bytes);
+    free(r->shown);
+    r->cells = (Texture2D){0};
+    r->target = (RenderTexture2D){0};
+    r->bytes = NULL;
+    r->shown = NULL;
+    r->width = r->height = r->row_words = 0;
+    r->drawn = false;
+}
+
+void render_deinit(GolRender* r) {
+    render_unload(r);
+    if (r->shader.id) UnloadShader(r->shader);
+    free(r->spans);
+    *r = (GolRender){0};
+}
+
+/// Draw everything again next frame.
+static inline void render_invalidate(GolRender* r) {
+    r->drawn = false;
+}
+
+/// Make the textures fit `width` x `height` cells, new ones only if the size changed.
+static bool render_resize(GolRender* r, size_t width, size_t height) {
+    if (r->cells.id && r->target.id && r->width == width && r->height == height) return true;
+    render_unload(r);
+
+    const size_t row_words = (width + 63) / 64;
+    r->bytes = (Cell*)calloc(width * height, sizeof(Cell));
+    r->shown = (uint64_t*)calloc(row_words * height, sizeof(uint64_t));
+    if (!(r->bytes) || !(r->shown)) {
+        panic("Allocation of render_resize failed");
+        render_unload(r);
+        return false;
+    }
+    Image image = {
+        .data = r->bytes,
+        .width = (int)width,
+        .height = (int)height,
+        .mipmaps = 1,
+        .format = PIXELFORMAT_UNCOMPRESSED_GRAYSCALE,
+    };
+    r->cells = LoadTextureFromImage(image);
+    r->target = LoadRenderTexture((int)(width * GOL_SCALE), (int)(height * GOL_SCALE));
+    if (!IsTextureReady(r->cells) || !IsRenderTextureReady(r->target)) {
+        TraceLog(LOG_WARNING, "GOL: couldn't make the textures for %zu x %zu cells", width, height);
+        render_unload(r);
+        return false;
+    }
+
+    r->width = width;
+    r->height = height;
+    r->row_words = row_words;
+    return true;
+}
+
+static bool render_push(GolRender* r, RenderSpan span) {
+    if (r->span_count == r->span_capacity) {
+        const size_t capacity = r->span_capacity ? r->span_capacity * 2 : 64;
+        RenderSpan* spans = (RenderSpan*)realloc(r->spans, capacity * sizeof(RenderSpan));
+        if (!spans) {
+            panic("Allocation of render_push failed");
+            return false;
+        }
+        r->spans = spans;
+        r->span_capacity = capacity;
+    }
+    r->spans[r->span_count++] = span;
+    return true;
+}
+
+/// Take in the cells of `frame` that differ from `shown`, as spans of the rows they're in.
+/// Spans closer than `gap` cells are joined, their redraws would overlap anyway.
+/// False if the spans didn't fit, then the cells have to be drawn again from scratch.
+static bool render_diff(GolRender* r, const GolFrame* frame, size_t gap, size_t* y0, size_t* y1) {
+    const uint64_t tail = packed_tail_mask(frame->width);
+    *y0 = SIZE_MAX;
+    *y1 = 0;
+
+    for (size_t y = 0; y < frame->height; y++) {
+        const uint64_t* words = frame->words + y * frame->row_words;
+        uint64_t* shown = r->shown + y * r->row_words;
+        Cell* row = r->bytes + y * frame->width;
+        bool open = false;
+
+        for (size_t k = 0; k < r->row_words; k++) {
+            // the bits past the last cell may hold a copy of the first one
+            const uint64_t word = (k + 1 == r->row_words) ? words[k] & tail : words[k];
+            const uint64_t changed = word ^ shown[k];
+            if (!changed) continue;
+
+            shown[k] = word;
+            universe_unpack_word(row + k * 64, word, min(frame->width - k * 64, 64));
+            const size_t x0 = k * 64 + (size_t)__builtin_ctzll(changed);
+            const size_t x1 = k * 64 + 63 - (size_t)__builtin_clzll(changed);
+
+            RenderSpan* last = r->span_count ? &(r->spans[r->span_count - 1]) : NULL;
+            if (open && last->x1 + gap >= x0) last->x1 = x1;
+            else if (!render_push(r, (RenderSpan){ .y = y, .x0 = x0, .x1 = x1 })) return false;
+            open = true;
+        }
+        if (open) {
+            *y0 = min(*y0, y);
+            *y1 = y;
+        }
+    }
+    return true;
+}
+
+/// Where DrawTextEx would put the glyph of `text` in a cell of `size` pixels,
+/// the way `DrawTextCodepoint` works it out. Nothing is drawn for empty text and spaces.
+static void render_glyph(const char* text, Color tint, float size, float src[4], float dst[4], float rgba[4]) {
+    int bytes = 0;
+    const int codepoint = text[0] ? GetCodepointNext(text, &bytes) : ' ';
+    if (codepoint == ' ' || codepoint == '\t') {
+        for (int i = 0; i < 4; i++) src[i] = dst[i] = rgba[i] = 0.0f;
+        return;
+    }
+
+    const int index = GetGlyphIndex(font, codepoint);
+    const float scale = size / (float)font.baseSize;
+    const float pad = (float)font.glyphPadding;
+    const Rectangle rec = font.recs[index];
+
+    src[0] = rec.x - pad;
+    src[1] = rec.y - pad;
+    src[2] = rec.width + 2.0f * pad;
+    src[3] = rec.height + 2.0f * pad;
+    dst[0] = ((float)font.glyphs[index].offsetX - pad) * scale;
+    dst[1] = ((float)font.glyphs[index].offsetY - pad) * scale;
+    dst[2] = src[2] * scale;
+    dst[3] = src[3] * scale;
+    rgba[0] = tint.r / 255.0f;
+    rgba[1] = tint.g / 255.0f;
+    rgba[2] = tint.b / 255.0f;
+    rgba[3] = tint.a / 255.0f;
+}
+
+/// How many cells past its own the glyph at `dst` draws over.
+static int render_reach(const float dst[4], float size) {
+    if (dst[2] <= 0.0f) return 0;
+    const float over = fmaxf(fmaxf(-dst[0], dst[0] + dst[2] - size), fmaxf(-dst[1], dst[1] + dst[3] - size));
+    return (over > 0.0f) ? (int)ceilf(over / size) : 0;
+}
+
+/// Draw the cells of `frame` at the corner of the window in the colors of `theme`,
+/// only the ones that changed since the last frame when the theme and size are the same.
+/// False if it couldn't, then nothing was drawn.
+bool render_draw(GolRender* r, const GolFrame* frame, GolTheme theme, const GolThemeStyle* style) {
+    if (!(r->ready) || frame->width == 0 || frame->height == 0) return false;
+    if (!render_resize(r, frame->width, frame->height)) return false;
+
+    const float size = (float)GOL_SCALE;
+    float src[2][4], dst[2][4], tint[2][4];
+    render_glyph(style->bg_char, style->bg_char_color, size, src[0], dst[0], tint[0]);
+    render_glyph(style->fg_char, style->fg_color, size, src[1], dst[1], tint[1]);
+    const int reach = min(max(render_reach(dst[0], size), render_reach(dst[1], size)), RENDER_MAX_REACH);
+
+    // a new theme or size draws everything, otherwise just what changed since the last frame
+    const bool all = !(r->drawn) || r->theme != theme;
+    r->span_count = 0;
+    if (all) {
+        const uint64_t tail = packed_tail_mask(frame->width);
+        for (size_t y = 0; y < frame->height; y++) {
+            const uint64_t* words = frame->words + y * frame->row_words;
+            uint64_t* shown = r->shown + y * r->row_words;
+            for (size_t k = 0; k < r->row_words; k++) {
+                shown[k] = (k + 1 == r->row_words) ? words[k] & tail : words[k];
+                universe_unpack_word(r->bytes + y * frame->width + k * 64, shown[k], min(frame->width - k * 64, 64));
+            }
+        }
+        UpdateTexture(r->cells, r->bytes);
+        if (!render_push(r, (RenderSpan){ .y = 0, .x0 = 0, .x1 = frame->width - 1 })) return false;
+    }
+    else {
+        size_t y0, y1;
+        if (!render_diff(r, frame, 2 * (size_t)reach + 1, &y0, &y1)) {
+            render_invalidate(r);
+            return false;
+        }
+        if (y0 <= y1) UpdateTextureRec(r->cells, rect(0, y0, frame->width, y1 - y0 + 1), r->bytes + y0 * frame->width);
+    }
+
+    if (r->span_count) {
+        const int fill = theme == GOLTheme_Midnight;
+        const float background[4] = {
+            style->bg_color.r / 255.0f, style->bg_color.g / 255.0f, style->bg_color.b / 255.0f, 1.0f,
+        };
+
+        BeginTextureMode(r->target);
+        BeginShaderMode(r->shader);
+        // after BeginShaderMode, which draws what came before and lets go of the atlas
+        SetShaderValueTexture(r->shader, r->loc_atlas, font.texture);
+        SetShaderValueV(r->shader, r->loc_glyph_src, src, SHADER_UNIFORM_VEC4, 2);
+        SetShaderValueV(r->shader, r->loc_glyph_dst, dst, SHADER_UNIFORM_VEC4, 2);
+        SetShaderValueV(r->shader, r->loc_glyph_tint, tint, SHADER_UNIFORM_VEC4, 2);
+        SetShaderValue(r->shader, r->loc_cell_size, &size, SHADER_UNIFORM_FLOAT);
+        SetShaderValue(r->shader, r->loc_reach, &reach, SHADER_UNIFORM_INT);
+        SetShaderValue(r->shader, r->loc_fill, &fill, SHADER_UNIFORM_INT);
+        SetShaderValue(r->shader, r->loc_background, background, SHADER_UNIFORM_VEC4);
+        for (size_t i = 0; i < r->span_count; i++) {
+            const RenderSpan span = r->spans[i];
+            // a changed cell changes the pixels of every cell its glyph reaches, and those
+            // are made of the glyphs of every cell that reaches them
+            const size_t x0 = all ? 0 : (span.x0 > (size_t)reach ? span.x0 - reach : 0);
+            const size_t x1 = all ? frame->width - 1 : min(span.x1 + reach, frame->width - 1);
+            const size_t sy0 = all ? 0 : (span.y > (size_t)reach ? span.y - reach : 0);
+            const size_t sy1 = all ? frame->height - 1 : min(span.y + reach, frame->height - 1);
+            DrawTexturePro(
+                r->cells,
+                rect(x0, sy0, x1 - x0 + 1, sy1 - sy0 + 1),
+                rect(x0 * size, sy0 * size, (x1 - x0 + 1) * size, (sy1 - sy0 + 1) * size),
+                vec2(0, 0),
+                0.0f,
+                WHITE
+            );
+        }
+        EndShaderMode();
+        EndTextureMode();
+    }
+    r->drawn = true;
+    r->theme = theme;
+
+    // render textures are upside down
+    DrawTextureRec(r->target.texture, rect(0, 0, frame->width * size, -(frame->height * size)), vec2(0, 0), WHITE);
+    return true;
+}
+
+#undef Cell
+#endif
@@ -0,0 +1,75 @@
+#ifndef GOL_RNG_C_
+#define GOL_RNG_C_
+
+//! A small seedable random number generator (xoshiro256**) for generating soups.
+//! `rng_cells` draws 64 cells at once, each alive with a given density, by combining
+//! a few random words bit by bit, so a soup costs a fraction of a draw per cell.
+//! The same seed always gives the same cells.
+
+#include <stdint.h>
+
+typedef struct GolRng {
+    uint64_t s[4];
+} GolRng;
+
+/// densities are in steps of 1 / RNG_DENSITY_ONE
+#define RNG_DENSITY_BITS 8
+#define RNG_DENSITY_ONE (1 << RNG_DENSITY_BITS)
+
+static inline uint64_t rng_splitmix(uint64_t* x) {
+    uint64_t z = (*x += UINT64_C(0x9E3779B97F4A7C15));
+    z = (z ^ (z >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+    z = (z ^ (z >> 27)) * UINT64_C(0x94D049BB133111EB);
+    return z ^ (z >> 31);
+}
+
+GolRng rng_new(uint64_t seed) {
+    GolRng rng;
+    // splitmix spreads any seed, including 0, over the whole state
+    for (int i = 0; i < 4; i++) rng.s[i] = rng_splitmix(&seed);
+    return rng;
+}
+
+static inline uint64_t rng_rotl(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+static inline uint64_t rng_next(GolRng* rng) {
+    uint64_t* s = rng->s;
+    uint64_t result = rng_rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rng_rotl(s[3], 45);
+    return result;
+}
+
+/// Convert a density in [0, 1] to the steps `rng_cells` takes.
+static inline uint32_t rng_density(float density) {
+    if (!(density > 0.0f)) return 0;
+    if (density >= 1.0f) return RNG_DENSITY_ONE;
+    return (uint32_t)(density * RNG_DENSITY_ONE + 0.5f);
+}
+
+/// 64 random cells, each alive with a probability of `density / RNG_DENSITY_ONE`.
+/// Going from the lowest set bit of the density to the highest, a 1 bit ORs in a random
+/// word and a 0 bit ANDs one in, each halving the chance of a dead or a live cell.
+/// That takes one draw per bit, a density of 50% is a single draw.
+static inline uint64_t rng_cells(GolRng* rng, uint32_t density) {
+    if (density == 0) return 0;
+    if (density >= RNG_DENSITY_ONE) return ~UINT64_C(0);
+
+    uint64_t cells = 0;
+    int bit = __builtin_ctz(density);
+    for (; bit < RNG_DENSITY_BITS; bit++) {
+        uint64_t r = rng_next(rng);
+        cells = ((density >> bit) & 1) ? (cells | r) : (cells & r);
+    }
+    return cells;
+}
+
+#endif
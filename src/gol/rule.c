@@ -0,0 +1,150 @@
+#ifndef GOL_RULE_C_
+#define GOL_RULE_C_
+
+//! Life-like rules in B/S notation, e.g. B3/S23 for Conway's Game of Life.
+//! A rule is compiled once into the tables every kernel steps with, so no rule
+//! is slower than another: a lookup table for the byte kernels and hashlife,
+//! and masks for a branchless bit-sliced evaluation in the packed kernels.
+//! NOTE: rules with B0 are rejected, the unbounded engines need empty space to stay empty.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "cell.c"
+
+typedef struct GolRule {
+    /// bit n set: a dead cell with n neighbours is born
+    uint16_t birth;
+    /// bit n set: a live cell with n neighbours survives
+    uint16_t survive;
+    /// next state indexed [alive][neighbours], counts past 8 stay Dead.
+    /// Each half is 16 bytes so the SIMD kernels can use it as a shuffle table.
+    GolCell table[2][16];
+    /// masks for `rule_next_sliced`, index = alive * 4 + s2 * 2 + s1
+    uint64_t slice_even[8];
+    uint64_t slice_flip[8];
+    uint64_t eight_dead, eight_flip;
+    /// the canonical rulestring
+    char name[24];
+} GolRule;
+
+/// Some well known rules, cycled through in the game.
+static const char* RULE_PRESETS[] = {
+    "B3/S23",           // Conway's Game of Life
+    "B36/S23",          // HighLife
+    "B3678/S34678",     // Day & Night
+    "B2/S",             // Seeds
+    "B3/S012345678",    // Life without Death
+    "B36/S125",         // 2x2
+    "B3/S12345",        // Maze
+    "B1357/S1357",      // Replicator
+    "B368/S245",        // Morley
+    "B35678/S5678",     // Diamoeba
+    "B4678/S35678",     // Anneal
+};
+#define RULE_PRESET_COUNT (sizeof(RULE_PRESETS) / sizeof(RULE_PRESETS[0]))
+
+static inline uint64_t rule_mask(uint16_t counts, int n) {
+    return ((counts >> n) & 1) ? ~UINT64_C(0) : 0;
+}
+
+/// Compile the rule with the given birth and survival neighbour counts.
+GolRule rule_new(uint16_t birth, uint16_t survive) {
+    GolRule rule = {0};
+    rule.birth = birth & 0x1FE;
+    rule.survive = survive & 0x1FF;
+
+    for (int n = 0; n <= 8; n++) {
+        rule.table[Dead][n] = (rule.birth >> n) & 1;
+        rule.table[Alive][n] = (rule.survive >> n) & 1;
+    }
+
+    for (int i = 0; i < 8; i++) {
+        uint16_t counts = (i & 4) ? rule.survive : rule.birth;
+        int even = (i & 2) * 2 + (i & 1) * 2;
+        rule.slice_even[i] = rule_mask(counts, even);
+        rule.slice_flip[i] = rule_mask(counts, even) ^ rule_mask(counts, even + 1);
+    }
+    rule.eight_dead = rule_mask(rule.birth, 8);
+    rule.eight_flip = rule_mask(rule.birth, 8) ^ rule_mask(rule.survive, 8);
+
+    int len = snprintf(rule.name, sizeof rule.name, "B");
+    for (int n = 0; n <= 8; n++) {
+        if ((rule.birth >> n) & 1) len += snprintf(rule.name + len, sizeof rule.name - len, "%d", n);
+    }
+    len += snprintf(rule.name + len, sizeof rule.name - len, "/S");
+    for (int n = 0; n <= 8; n++) {
+        if ((rule.survive >> n) & 1) len += snprintf(rule.name + len, sizeof rule.name - len, "%d", n);
+    }
+    return rule;
+}
+
+static inline GolRule rule_conway(void) {
+    return rule_new(1 << 3, (1 << 2) | (1 << 3));
+}
+
+/// Parse "B3/S23", "b3s23", "S23/B3" or the older "23/3" (survival/birth) notation.
+/// Returns false, leaving `out` alone, if `text` is not a valid B0-free rule.
+bool rule_parse(const char* text, GolRule* out) {
+    uint16_t birth = 0, survive = 0;
+    uint16_t* counts = NULL;
+    bool has_letters = false, has_slash = false;
+
+    for (const char* c = text; *c; c++) {
+        if (*c == 'B' || *c == 'b' || *c == 'S' || *c == 's') has_letters = true;
+    }
+    // the older notation starts with the survival counts
+    if (!has_letters) counts = &survive;
+
+    for (const char* c = text; *c; c++) {
+        switch (*c) {
+        case 'B': case 'b': counts = &birth; break;
+        case 'S': case 's': counts = &survive; break;
+        case '/': {
+            if (!has_letters) {
+                if (has_slash) return false;
+                counts = &birth;
+            }
+            has_slash = true;
+        } break;
+        case ' ': break;
+        default: {
+            if (*c < '0' || *c > '8' || !counts) return false;
+            *counts |= 1 << (*c - '0');
+        }
+        }
+    }
+
+    if (!has_letters && !has_slash) return false;
+    if (birth & 1) return false;
+
+    *out = rule_new(birth, survive);
+    return true;
+}
+
+static inline GolCell rule_next(const GolRule* rule, GolCell old, int neighbours) {
+    return rule->table[old][neighbours];
+}
+
+/// Next state of 64 cells at once from their bit-sliced neighbour counts `s0`..`s3`.
+/// A mux tree over the count bits, whose leaves are the compiled masks of the rule.
+static inline uint64_t rule_next_sliced(
+    const GolRule* rule, uint64_t alive,
+    uint64_t s0, uint64_t s1, uint64_t s2, uint64_t s3
+) {
+    uint64_t m[8];
+    for (int i = 0; i < 8; i++) m[i] = rule->slice_even[i] ^ (s0 & rule->slice_flip[i]);
+
+    uint64_t d0 = m[0] ^ ((m[0] ^ m[1]) & s1), d1 = m[2] ^ ((m[2] ^ m[3]) & s1);
+    uint64_t l0 = m[4] ^ ((m[4] ^ m[5]) & s1), l1 = m[6] ^ ((m[6] ^ m[7]) & s1);
+    uint64_t dead = d0 ^ ((d0 ^ d1) & s2);
+    uint64_t live = l0 ^ ((l0 ^ l1) & s2);
+    uint64_t next = dead ^ ((dead ^ live) & alive);
+
+    // s3 is only set for 8 neighbours, when all the lower bits are clear
+    uint64_t eight = rule->eight_dead ^ (alive & rule->eight_flip);
+    return next ^ ((next ^ eight) & s3);
+}
+
+#endif
@@ -0,0 +1,321 @@
+#ifndef GOL_SIM_C_
+#define GOL_SIM_C_
+
+//! Runs the simulation on its own thread, so slow generations don't drop frames
+//! and slow frames don't throttle the simulation.
+//! Finished generations are published as bit-packed frames through a lock-free triple buffer,
+//! the UI renders the newest one. Cell edits go the other way through a single producer,
+//! single consumer ring of commands. Anything else that changes the world is done by the UI
+//! while the thread is held with `gol_sim_stop`, which is cheap as those are rare.
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "universe.c"
+#include "../panic.h"
+
+#define Cell GolCell
+
+// must be a power of two
+#define GOL_COMMAND_QUEUE_SIZE 4096
+
+/// A generation as the UI sees it.
+typedef struct GolFrame {
+    size_t width, height;
+    // 64 cells per word, rows start on a word
+    size_t row_words;
+    size_t capacity;
+    uint64_t* words;
+    uint64_t iterations;
+    double gens_per_sec;
+    // the period the world repeats with, 0 if it doesn't (yet)
+    uint32_t period;
+    // how many repetitions were found so far
+    uint64_t cycles_found;
+    UniverseStats stats;
+} GolFrame;
+
+static inline Cell gol_frame_get(const GolFrame* frame, size_t x, size_t y) {
+    return (frame->words[y * frame->row_words + x / 64] >> (x % 64)) & 1;
+}
+
+/// Make room for `words` words of cells, the old cells are lost.
+bool gol_frame_reserve(GolFrame* frame, size_t words) {
+    if (words <= frame->capacity) return true;
+
+    free(frame->words);
+    frame->capacity = 0;
+    frame->words = (uint64_t*)malloc(words * sizeof(uint64_t));
+    if (!(frame->words)) {
+        panic("Allocation of a frame failed");
+        return false;
+    }
+    frame->capacity = words;
+    return true;
+}
+
+/// Copy the cells of `uvs` into `frame`.
+void gol_frame_store(GolFrame* frame, Universe* uvs) {
+    size_t row_words = (uvs->width + 63) / 64;
+
+    if (!gol_frame_reserve(frame, row_words * uvs->height)) return;
+    frame->width = uvs->width;
+    frame->height = uvs->height;
+    frame->row_words = row_words;
+
+    for (size_t y = 0; y < uvs->height; y++) {
+        uint64_t* out = frame->words + y * row_words;
+
+        switch (uvs->backend) {
+        case UniverseBackend_Bytes: {
+            const Cell* row = UNIVERSE_ROW(uvs, uvs->cells, y);
+            for (size_t i = 0; i < row_words; i++) out[i] = universe_pack_word(row + i * 64, min(uvs->width - i * 64, 64));
+        } break;
+        case UniverseBackend_Packed: {
+            memcpy(out, PACKED_ROW(&(uvs->packed), uvs->packed.words, y), row_words * sizeof(uint64_t));
+        } break;
+        }
+    }
+}
+
+/// The population and bounding box of the cells, births and deaths are 0.
+/// For when the kernel didn't count them.
+UniverseStats gol_frame_stats(const GolFrame* frame) {
+    UniverseStats stats = { .min_x = SIZE_MAX, .min_y = SIZE_MAX };
+
+    for (size_t y = 0; y < frame->height; y++) {
+        const uint64_t* row = frame->words + y * frame->row_words;
+        for (size_t k = 0; k < frame->row_words; k++) {
+            if (!row[k]) continue;
+
+            stats.population += (uint64_t)__builtin_popcountll(row[k]);
+            stats.min_x = min(stats.min_x, k * 64 + (size_t)__builtin_ctzll(row[k]));
+            stats.max_x = max(stats.max_x, k * 64 + 63 - (size_t)__builtin_clzll(row[k]));
+            stats.min_y = min(stats.min_y, y);
+            stats.max_y = y;
+        }
+    }
+    return stats;
+}
+
+/// Replace the cells of `uvs` with the ones of `frame`, from the top left corner.
+/// Cells past the frame are dead, cells past the universe are dropped.
+void gol_frame_load(const GolFrame* frame, Universe* uvs) {
+    universe_fill(uvs, Dead);
+
+    size_t width = min(frame->width, uvs->width);
+    size_t words = (width + 63) / 64;
+    uint64_t tail = (width % 64) ? (UINT64_C(1) << (width % 64)) - 1 : ~UINT64_C(0);
+
+    for (size_t y = 0; y < min(frame->height, uvs->height); y++) {
+        const uint64_t* in = frame->words + y * frame->row_words;
+
+        switch (uvs->backend) {
+        case UniverseBackend_Bytes: {
+            Cell* row = UNIVERSE_ROW(uvs, uvs->cells, y);
+            for (size_t x = 0; x < width; x++) row[x] = (in[x / 64] >> (x % 64)) & 1;
+        } break;
+        case UniverseBackend_Packed: {
+            uint64_t* row = PACKED_ROW(&(uvs->packed), uvs->packed.words, y);
+            if (words == 0) break;
+            memcpy(row, in, words * sizeof(uint64_t));
+            row[words - 1] &= tail;
+        } break;
+        }
+    }
+}
+
+/// Three frames: one being written, one being read and the newest finished one in the middle.
+/// Writer and reader each swap their frame with the middle one, so neither ever waits.
+typedef struct GolTripleBuffer {
+    GolFrame frames[3];
+    // index of the middle frame, GOL_TRIPLE_FRESH is set when the writer swapped it in
+    atomic_uint middle;
+    // owned by the writer
+    unsigned back;
+    // owned by the reader
+    unsigned front;
+} GolTripleBuffer;
+
+#define GOL_TRIPLE_FRESH 4u
+
+/// The frame the writer fills next.
+static inline GolFrame* gol_triple_back(GolTripleBuffer* tb) {
+    return &(tb->frames[tb->back]);
+}
+
+/// Make the back frame the newest one.
+static inline void gol_triple_publish(GolTripleBuffer* tb) {
+    unsigned old = atomic_exchange_explicit(&(tb->middle), tb->back | GOL_TRIPLE_FRESH, memory_order_acq_rel);
+    tb->back = old & ~GOL_TRIPLE_FRESH;
+}
+
+/// The newest frame, which stays valid until the next call.
+static inline const GolFrame* gol_triple_front(GolTripleBuffer* tb) {
+    if (atomic_load_explicit(&(tb->middle), memory_order_relaxed) & GOL_TRIPLE_FRESH) {
+        unsigned old = atomic_exchange_explicit(&(tb->middle), tb->front, memory_order_acq_rel);
+        tb->front = old & ~GOL_TRIPLE_FRESH;
+    }
+    return &(tb->frames[tb->front]);
+}
+
+typedef enum GolCommandType {
+    GolCommand_SetCell = 0,
+} GolCommandType;
+
+typedef struct GolCommand {
+    GolCommandType type;
+    size_t x, y;
+    Cell cell;
+} GolCommand;
+
+/// A ring of commands with one writer (the UI) and one reader (the simulation thread).
+typedef struct GolCommandQueue {
+    GolCommand ring[GOL_COMMAND_QUEUE_SIZE];
+    // next slot to read, written by the reader
+    atomic_size_t head;
+    // next slot to write, written by the writer
+    atomic_size_t tail;
+} GolCommandQueue;
+
+/// Returns false if the queue is full.
+static inline bool gol_command_push(GolCommandQueue* q, GolCommand cmd) {
+    size_t tail = atomic_load_explicit(&(q->tail), memory_order_relaxed);
+    if (tail - atomic_load_explicit(&(q->head), memory_order_acquire) == GOL_COMMAND_QUEUE_SIZE) return false;
+
+    q->ring[tail & (GOL_COMMAND_QUEUE_SIZE - 1)] = cmd;
+    atomic_store_explicit(&(q->tail), tail + 1, memory_order_release);
+    return true;
+}
+
+/// Returns false if the queue is empty.
+static inline bool gol_command_pop(GolCommandQueue* q, GolCommand* cmd) {
+    size_t head = atomic_load_explicit(&(q->head), memory_order_relaxed);
+    if (head == atomic_load_explicit(&(q->tail), memory_order_acquire)) return false;
+
+    *cmd = q->ring[head & (GOL_COMMAND_QUEUE_SIZE - 1)];
+    atomic_store_explicit(&(q->head), head + 1, memory_order_release);
+    return true;
+}
+
+/// One round of the simulation thread: apply the commands, step and publish a frame.
+typedef void (*GolSimTick)(void* ctx);
+
+typedef struct GolSim {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t idle_changed;
+    // guarded by `lock`
+    bool running;
+    bool idle;
+    bool quit;
+
+    GolSimTick tick;
+    void* ctx;
+
+    GolTripleBuffer frames;
+    GolCommandQueue commands;
+} GolSim;
+
+static void* gol_sim_thread(void* arg) {
+    GolSim* sim = (GolSim*)arg;
+
+    pthread_mutex_lock(&(sim->lock));
+    for (;;) {
+        if (!(sim->running) && !(sim->quit)) {
+            sim->idle = true;
+            pthread_cond_broadcast(&(sim->idle_changed));
+            while (!(sim->running) && !(sim->quit)) pthread_cond_wait(&(sim->wake), &(sim->lock));
+        }
+        if (sim->quit) break;
+        sim->idle = false;
+        pthread_mutex_unlock(&(sim->lock));
+
+        sim->tick(sim->ctx);
+
+        pthread_mutex_lock(&(sim->lock));
+    }
+    sim->idle = true;
+    pthread_mutex_unlock(&(sim->lock));
+    return NULL;
+}
+
+/// Start the thread, held until `gol_sim_start`.
+GolSim* gol_sim_alloc(GolSimTick tick, void* ctx) {
+    GolSim* sim = (GolSim*)calloc(1, sizeof(GolSim));
+    if (!sim) {
+        panic("Allocation of gol_sim_alloc failed");
+        return NULL;
+    }
+
+    sim->tick = tick;
+    sim->ctx = ctx;
+    sim->frames.back = 0;
+    sim->frames.front = 1;
+    atomic_init(&(sim->frames.middle), 2);
+
+    pthread_mutex_init(&(sim->lock), NULL);
+    pthread_cond_init(&(sim->wake), NULL);
+    pthread_cond_init(&(sim->idle_changed), NULL);
+    if (pthread_create(&(sim->thread), NULL, gol_sim_thread, sim) != 0) {
+        panic("Starting the simulation thread failed");
+    }
+    return sim;
+}
+
+void gol_sim_free(GolSim* sim) {
+    if (!sim) return;
+
+    pthread_mutex_lock(&(sim->lock));
+    sim->quit = true;
+    pthread_cond_broadcast(&(sim->wake));
+    pthread_mutex_unlock(&(sim->lock));
+    pthread_join(sim->thread, NULL);
+
+    for (int i = 0; i < 3; i++) free(sim->frames.frames[i].words);
+    pthread_cond_destroy(&(sim->idle_changed));
+    pthread_cond_destroy(&(sim->wake));
+    pthread_mutex_destroy(&(sim->lock));
+    free(sim);
+}
+
+/// Let the thread run ticks until `gol_sim_stop`.
+void gol_sim_start(GolSim* sim) {
+    pthread_mutex_lock(&(sim->lock));
+    if (!(sim->running)) {
+        sim->running = true;
+        pthread_cond_signal(&(sim->wake));
+    }
+    pthread_mutex_unlock(&(sim->lock));
+}
+
+/// Hold the thread and wait for its tick to finish, after which the caller owns the world.
+void gol_sim_stop(GolSim* sim) {
+    pthread_mutex_lock(&(sim->lock));
+    sim->running = false;
+    while (!(sim->idle)) pthread_cond_wait(&(sim->idle_changed), &(sim->lock));
+    pthread_mutex_unlock(&(sim->lock));
+}
+
+/// Whether the simulation thread owns the world. Only meaningful to the thread calling start and stop.
+static inline bool gol_sim_running(GolSim* sim) {
+    pthread_mutex_lock(&(sim->lock));
+    bool running = sim->running;
+    pthread_mutex_unlock(&(sim->lock));
+    return running;
+}
+
+/// Sleep for a bit when there is nothing to step yet.
+static inline void gol_sim_nap(void) {
+    struct timespec nap = { .tv_sec = 0, .tv_nsec = 500000 };
+    nanosleep(&nap, NULL);
+}
+
+#undef Cell
+#endif
@@ -0,0 +1,209 @@
+#ifndef GOL_SIMD_C_
+#define GOL_SIMD_C_
+
+//! Row kernels for the byte-per-cell universe, stepping 16 to 64 cells per instruction.
+//! The neighbour count is the sum of eight shifted unaligned loads of the rows above,
+//! at and below, which works because the universe pads every row with a halo cell.
+//! The next state is looked up in the rule's table with a byte shuffle (SSSE3 and up),
+//! plain SSE2 compares the count against every count of the rule instead.
+//! The widest kernel the CPU supports is picked once at startup via cpuid,
+//! on other architectures the scalar kernel is used.
+
+#include <stddef.h>
+
+#include "cell.c"
+#include "rule.c"
+
+#if defined(__x86_64__) || defined(__i386__)
+#  define GOL_SIMD_X86
+#  include <immintrin.h>
+#endif
+
+/// Step one row of `width` cells. `a`, `b` and `c` point at the first cell of the rows
+/// above, at and below, and may be read one cell past either end.
+typedef void (*GolRowKernel)(
+    const GolRule* rule,
+    const GolCell* a, const GolCell* b, const GolCell* c,
+    GolCell* out, size_t width
+);
+
+typedef enum SimdLevel {
+    SimdLevel_Scalar = 0,
+    SimdLevel_SSE2,
+    SimdLevel_SSSE3,
+    SimdLevel_AVX2,
+    SimdLevel_AVX512,
+} SimdLevel;
+
+static const char* SIMD_LEVEL_NAMES[] = {
+    [SimdLevel_Scalar] = "scalar",
+    [SimdLevel_SSE2] = "SSE2",
+    [SimdLevel_SSSE3] = "SSSE3",
+    [SimdLevel_AVX2] = "AVX2",
+    [SimdLevel_AVX512] = "AVX-512",
+};
+
+static void simd_step_row_scalar(
+    const GolRule* rule,
+    const GolCell* a, const GolCell* b, const GolCell* c,
+    GolCell* out, size_t width
+) {
+    for (size_t x = 0; x < width; x++) {
+        int neighbours =
+            a[x - 1] + a[x] + a[x + 1] +
+            b[x - 1] +        b[x + 1] +
+            c[x - 1] + c[x] + c[x + 1];
+        out[x] = rule_next(rule, b[x], neighbours);
+    }
+}
+
+#ifdef GOL_SIMD_X86
+
+__attribute__((target("sse2")))
+static void simd_step_row_sse2(
+    const GolRule* rule,
+    const GolCell* a, const GolCell* b, const GolCell* c,
+    GolCell* out, size_t width
+) {
+    #define LOAD(P) _mm_loadu_si128((const __m128i*)(P))
+    const __m128i one = _mm_set1_epi8(1);
+    size_t x = 0;
+
+    for (; x + 16 <= width; x += 16) {
+        __m128i n = _mm_add_epi8(_mm_add_epi8(LOAD(a + x - 1), LOAD(a + x)), LOAD(a + x + 1));
+        n = _mm_add_epi8(n, _mm_add_epi8(LOAD(b + x - 1), LOAD(b + x + 1)));
+        n = _mm_add_epi8(n, _mm_add_epi8(_mm_add_epi8(LOAD(c + x - 1), LOAD(c + x)), LOAD(c + x + 1)));
+
+        __m128i alive = _mm_cmpeq_epi8(LOAD(b + x), one);
+        __m128i born = _mm_setzero_si128(), survives = _mm_setzero_si128();
+        for (int k = 0; k <= 8; k++) {
+            if (!((rule->birth | rule->survive) >> k & 1)) continue;
+            __m128i is_k = _mm_cmpeq_epi8(n, _mm_set1_epi8(k));
+            if (rule->birth >> k & 1) born = _mm_or_si128(born, is_k);
+            if (rule->survive >> k & 1) survives = _mm_or_si128(survives, is_k);
+        }
+        __m128i next = _mm_or_si128(_mm_and_si128(alive, survives), _mm_andnot_si128(alive, born));
+        _mm_storeu_si128((__m128i*)(out + x), _mm_and_si128(next, one));
+    }
+    #undef LOAD
+    simd_step_row_scalar(rule, a + x, b + x, c + x, out + x, width - x);
+}
+
+__attribute__((target("ssse3")))
+static void simd_step_row_ssse3(
+    const GolRule* rule,
+    const GolCell* a, const GolCell* b, const GolCell* c,
+    GolCell* out, size_t width
+) {
+    #define LOAD(P) _mm_loadu_si128((const __m128i*)(P))
+    const __m128i one = _mm_set1_epi8(1);
+    const __m128i born = LOAD(rule->table[Dead]), survives = LOAD(rule->table[Alive]);
+    size_t x = 0;
+
+    for (; x + 16 <= width; x += 16) {
+        __m128i n = _mm_add_epi8(_mm_add_epi8(LOAD(a + x - 1), LOAD(a + x)), LOAD(a + x + 1));
+        n = _mm_add_epi8(n, _mm_add_epi8(LOAD(b + x - 1), LOAD(b + x + 1)));
+        n = _mm_add_epi8(n, _mm_add_epi8(_mm_add_epi8(LOAD(c + x - 1), LOAD(c + x)), LOAD(c + x + 1)));
+
+        __m128i alive = _mm_cmpeq_epi8(LOAD(b + x), one);
+        __m128i next = _mm_or_si128(
+            _mm_and_si128(alive, _mm_shuffle_epi8(survives, n)),
+            _mm_andnot_si128(alive, _mm_shuffle_epi8(born, n))
+        );
+        _mm_storeu_si128((__m128i*)(out + x), next);
+    }
+    #undef LOAD
+    simd_step_row_scalar(rule, a + x, b + x, c + x, out + x, width - x);
+}
+
+__attribute__((target("avx2")))
+static void simd_step_row_avx2(
+    const GolRule* rule,
+    const GolCell* a, const GolCell* b, const GolCell* c,
+    GolCell* out, size_t width
+) {
+    #define LOAD(P) _mm256_loadu_si256((const __m256i*)(P))
+    const __m256i one = _mm256_set1_epi8(1);
+    // the shuffle works within each 128 bit lane, so both lanes get the table
+    const __m256i born = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)(rule->table[Dead])));
+    const __m256i survives = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)(rule->table[Alive])));
+    size_t x = 0;
+
+    for (; x + 32 <= width; x += 32) {
+        __m256i n = _mm256_add_epi8(_mm256_add_epi8(LOAD(a + x - 1), LOAD(a + x)), LOAD(a + x + 1));
+        n = _mm256_add_epi8(n, _mm256_add_epi8(LOAD(b + x - 1), LOAD(b + x + 1)));
+        n = _mm256_add_epi8(n, _mm256_add_epi8(_mm256_add_epi8(LOAD(c + x - 1), LOAD(c + x)), LOAD(c + x + 1)));
+
+        __m256i alive = _mm256_cmpeq_epi8(LOAD(b + x), one);
+        __m256i next = _mm256_blendv_epi8(
+            _mm256_shuffle_epi8(born, n),
+            _mm256_shuffle_epi8(survives, n),
+            alive
+        );
+        _mm256_storeu_si256((__m256i*)(out + x), next);
+    }
+    #undef LOAD
+    simd_step_row_ssse3(rule, a + x, b + x, c + x, out + x, width - x);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static void simd_step_row_avx512(
+    const GolRule* rule,
+    const GolCell* a, const GolCell* b, const GolCell* c,
+    GolCell* out, size_t width
+) {
+    #define LOAD(P) _mm512_loadu_si512((const void*)(P))
+    const __m512i one = _mm512_set1_epi8(1);
+    const __m512i born = _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i*)(rule->table[Dead])));
+    const __m512i survives = _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i*)(rule->table[Alive])));
+    size_t x = 0;
+
+    for (; x + 64 <= width; x += 64) {
+        __m512i n = _mm512_add_epi8(_mm512_add_epi8(LOAD(a + x - 1), LOAD(a + x)), LOAD(a + x + 1));
+        n = _mm512_add_epi8(n, _mm512_add_epi8(LOAD(b + x - 1), LOAD(b + x + 1)));
+        n = _mm512_add_epi8(n, _mm512_add_epi8(_mm512_add_epi8(LOAD(c + x - 1), LOAD(c + x)), LOAD(c + x + 1)));
+
+        __mmask64 alive = _mm512_cmpeq_epi8_mask(LOAD(b + x), one);
+        __m512i next = _mm512_mask_blend_epi8(
+            alive,
+            _mm512_shuffle_epi8(born, n),
+            _mm512_shuffle_epi8(survives, n)
+        );
+        _mm512_storeu_si512((void*)(out + x), next);
+    }
+    #undef LOAD
+    simd_step_row_avx2(rule, a + x, b + x, c + x, out + x, width - x);
+}
+
+#endif
+
+/// The widest kernel this CPU supports, detected on the first call.
+SimdLevel simd_detect(void) {
+    static int detected = -1;
+
+    if (detected < 0) {
+        detected = SimdLevel_Scalar;
+#ifdef GOL_SIMD_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512bw")) detected = SimdLevel_AVX512;
+        else if (__builtin_cpu_supports("avx2")) detected = SimdLevel_AVX2;
+        else if (__builtin_cpu_supports("ssse3")) detected = SimdLevel_SSSE3;
+        else if (__builtin_cpu_supports("sse2")) detected = SimdLevel_SSE2;
+#endif
+    }
+    return (SimdLevel)detected;
+}
+
+GolRowKernel simd_row_kernel(SimdLevel level) {
+    switch (level) {
+#ifdef GOL_SIMD_X86
+    case SimdLevel_SSE2: return simd_step_row_sse2;
+    case SimdLevel_SSSE3: return simd_step_row_ssse3;
+    case SimdLevel_AVX2: return simd_step_row_avx2;
+    case SimdLevel_AVX512: return simd_step_row_avx512;
+#endif
+    default: return simd_step_row_scalar;
+    }
+}
+
+#endif
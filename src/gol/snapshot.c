@@ -0,0 +1,396 @@
+#ifndef GOL_SNAPSHOT_C_
+#define GOL_SNAPSHOT_C_
+
+//! Compact binary snapshots of the game: the cells of the view, the generation, the rule,
+//! the edge mode and the theme. The cells are stored bit-packed in tiles of 64x64, a run of
+//! empty tiles takes a few bytes and a tile only stores its rows with live cells, so a
+//! snapshot is a small fraction of the byte-per-cell grid. A CRC-32 at the end of the file
+//! catches truncated or damaged files before anything is loaded.
+//! `SnapshotWriter` compresses and writes a copy of the cells on its own thread, so saving
+//! only costs the UI the time to copy the cells.
+//!
+//! Layout, little endian:
+//!   header  "MSIMSNAP", u32 version, u64 width, u64 height, u64 iterations,
+//!           u16 birth mask, u16 survive mask, u8 edge, u8 theme, 4 bytes reserved
+//!   tiles   row major, each a tag byte, see `SnapshotTile`
+//!   trailer u32 CRC-32 of everything before it
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sim.c"
+#include "../panic.h"
+
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_HEADER_SIZE 46
+#define SNAPSHOT_BUFFER_SIZE (1 << 16)
+
+static const char SNAPSHOT_MAGIC[8] = { 'M', 'S', 'I', 'M', 'S', 'N', 'A', 'P' };
+
+typedef enum SnapshotTile {
+    /// followed by a varint, the number of empty tiles from this one on
+    SnapshotTile_Empty = 0,
+    /// every cell of the tile is alive
+    SnapshotTile_Full,
+    /// followed by a u64 mask of the rows with live cells, and a u64 for each of those rows
+    SnapshotTile_Rows,
+} SnapshotTile;
+
+/// Everything a snapshot holds.
+typedef struct GolSnapshot {
+    GolFrame cells;
+    uint64_t iterations;
+    uint16_t birth, survive;
+    uint8_t edge;
+    uint8_t theme;
+} GolSnapshot;
+
+void snapshot_deinit(GolSnapshot* snap) {
+    free(snap->cells.words);
+    memset(snap, 0, sizeof(GolSnapshot));
+}
+
+/* CRC-32 (IEEE) */
+
+static uint32_t SNAPSHOT_CRC_TABLE[256];
+static pthread_once_t snapshot_crc_once = PTHREAD_ONCE_INIT;
+
+static void snapshot_crc_init(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) c = (c & 1) ? (c >> 1) ^ 0xEDB88320u : c >> 1;
+        SNAPSHOT_CRC_TABLE[i] = c;
+    }
+}
+
+/// Continue `crc` over `n` bytes, start with 0.
+static uint32_t snapshot_crc(uint32_t crc, const uint8_t* data, size_t n) {
+    pthread_once(&snapshot_crc_once, snapshot_crc_init);
+
+    crc = ~crc;
+    for (size_t i = 0; i < n; i++) crc = SNAPSHOT_CRC_TABLE[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+/* writing */
+
+typedef struct SnapshotOut {
+    FILE* file;
+    uint32_t crc;
+    bool failed;
+    size_t len;
+    uint8_t buffer[SNAPSHOT_BUFFER_SIZE];
+} SnapshotOut;
+
+static void snapshot_flush(SnapshotOut* out) {
+    out->crc = snapshot_crc(out->crc, out->buffer, out->len);
+    if (fwrite(out->buffer, 1, out->len, out->file) != out->len) out->failed = true;
+    out->len = 0;
+}
+
+static void snapshot_put(SnapshotOut* out, const void* data, size_t n) {
+    const uint8_t* bytes = (const uint8_t*)data;
+    while (n > 0) {
+        if (out->len == SNAPSHOT_BUFFER_SIZE) snapshot_flush(out);
+        size_t part = min(n, SNAPSHOT_BUFFER_SIZE - out->len);
+        memcpy(out->buffer + out->len, bytes, part);
+        out->len += part;
+        bytes += part;
+        n -= part;
+    }
+}
+
+static inline void snapshot_put_u8(SnapshotOut* out, uint8_t v) {
+    if (out->len == SNAPSHOT_BUFFER_SIZE) snapshot_flush(out);
+    out->buffer[out->len++] = v;
+}
+
+static void snapshot_put_le(SnapshotOut* out, uint64_t v, int bytes) {
+    for (int i = 0; i < bytes; i++) snapshot_put_u8(out, (uint8_t)(v >> (i * 8)));
+}
+
+static void snapshot_put_varint(SnapshotOut* out, uint64_t v) {
+    while (v >= 0x80) {
+        snapshot_put_u8(out, (uint8_t)(v | 0x80));
+        v >>= 7;
+    }
+    snapshot_put_u8(out, (uint8_t)v);
+}
+
+/// The valid bits of word `tx` of a row.
+static inline uint64_t snapshot_tile_mask(const GolFrame* f, size_t tx) {
+    if (tx + 1 < f->row_words || f->width % 64 == 0) return ~UINT64_C(0);
+    return (UINT64_C(1) << (f->width % 64)) - 1;
+}
+
+/// The rows of tile row `ty`.
+static inline size_t snapshot_tile_rows(const GolFrame* f, size_t ty) {
+    return min(f->height - ty * 64, 64);
+}
+
+/// Write `snap` to the file at `path`.
+bool snapshot_write(const char* path, const GolSnapshot* snap) {
+    const GolFrame* f = &(snap->cells);
+    SnapshotOut* out = (SnapshotOut*)malloc(sizeof(SnapshotOut));
+    if (!out) {
+        panic("Allocation of the snapshot buffer failed");
+        return false;
+    }
+    out->file = fopen(path, "wb");
+    out->crc = 0;
+    out->failed = false;
+    out->len = 0;
+    if (!(out->file)) {
+        free(out);
+        return false;
+    }
+
+    snapshot_put(out, SNAPSHOT_MAGIC, sizeof SNAPSHOT_MAGIC);
+    snapshot_put_le(out, SNAPSHOT_VERSION, 4);
+    snapshot_put_le(out, f->width, 8);
+    snapshot_put_le(out, f->height, 8);
+    snapshot_put_le(out, snap->iterations, 8);
+    snapshot_put_le(out, snap->birth, 2);
+    snapshot_put_le(out, snap->survive, 2);
+    snapshot_put_u8(out, snap->edge);
+    snapshot_put_u8(out, snap->theme);
+    snapshot_put_le(out, 0, 4);
+
+    uint64_t empty_run = 0;
+    for (size_t ty = 0; ty * 64 < f->height; ty++) {
+        size_t rows = snapshot_tile_rows(f, ty);
+
+        for (size_t tx = 0; tx < f->row_words; tx++) {
+            const uint64_t* words = f->words + ty * 64 * f->row_words + tx;
+            uint64_t mask = snapshot_tile_mask(f, tx);
+            uint64_t live_rows = 0;
+            bool full = true;
+
+            for (size_t r = 0; r < rows; r++) {
+                uint64_t w = words[r * f->row_words] & mask;
+                if (w) live_rows |= UINT64_C(1) << r;
+                if (w != mask) full = false;
+            }
+            if (!live_rows) {
+                empty_run++;
+                continue;
+            }
+
+            if (empty_run) {
+                snapshot_put_u8(out, SnapshotTile_Empty);
+                snapshot_put_varint(out, empty_run);
+                empty_run = 0;
+            }
+            if (full) {
+                snapshot_put_u8(out, SnapshotTile_Full);
+                continue;
+            }
+            snapshot_put_u8(out, SnapshotTile_Rows);
+            snapshot_put_le(out, live_rows, 8);
+            for (size_t r = 0; r < rows; r++) {
+                if ((live_rows >> r) & 1) snapshot_put_le(out, words[r * f->row_words] & mask, 8);
+            }
+        }
+    }
+    if (empty_run) {
+        snapshot_put_u8(out, SnapshotTile_Empty);
+        snapshot_put_varint(out, empty_run);
+    }
+
+    snapshot_flush(out);
+    uint8_t crc[4] = { (uint8_t)out->crc, (uint8_t)(out->crc >> 8), (uint8_t)(out->crc >> 16), (uint8_t)(out->crc >> 24) };
+    if (fwrite(crc, 1, sizeof crc, out->file) != sizeof crc) out->failed = true;
+
+    bool ok = !(out->failed);
+    if (fclose(out->file) != 0) ok = false;
+    free(out);
+    return ok;
+}
+
+/* reading */
+
+typedef struct SnapshotIn {
+    const uint8_t* data;
+    size_t len, pos;
+    bool failed;
+} SnapshotIn;
+
+static uint64_t snapshot_get_le(SnapshotIn* in, int bytes) {
+    if (in->len - in->pos < (size_t)bytes) {
+        in->failed = true;
+        return 0;
+    }
+    uint64_t v = 0;
+    for (int i = 0; i < bytes; i++) v |= (uint64_t)(in->data[in->pos++]) << (i * 8);
+    return v;
+}
+
+static uint64_t snapshot_get_varint(SnapshotIn* in) {
+    uint64_t v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        uint64_t byte = snapshot_get_le(in, 1);
+        v |= (byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return v;
+    }
+    in->failed = true;
+    return 0;
+}
+
+/// Read the snapshot at `path` into `snap`, which owns the cells afterwards.
+/// Returns false, and leaves `snap` empty, when the file is not a valid snapshot.
+bool snapshot_read(const char* path, GolSnapshot* snap) {
+    memset(snap, 0, sizeof(GolSnapshot));
+
+    FILE* file = fopen(path, "rb");
+    if (!file) return false;
+
+    uint8_t* data = NULL;
+    size_t len = 0, capacity = 0;
+    for (;;) {
+        if (len == capacity) {
+            capacity = capacity ? capacity * 2 : SNAPSHOT_BUFFER_SIZE;
+            uint8_t* grown = (uint8_t*)realloc(data, capacity);
+            if (!grown) {
+                panic("Allocation of the snapshot buffer failed");
+                break;
+            }
+            data = grown;
+        }
+        size_t n = fread(data + len, 1, capacity - len, file);
+        if (n == 0) break;
+        len += n;
+    }
+    fclose(file);
+
+    SnapshotIn in = { .data = data, .len = len, .pos = 0, .failed = false };
+    bool ok = data && len >= SNAPSHOT_HEADER_SIZE + 4 && memcmp(data, SNAPSHOT_MAGIC, sizeof SNAPSHOT_MAGIC) == 0;
+    if (ok) {
+        in.pos = len - 4;
+        ok = snapshot_crc(0, data, len - 4) == (uint32_t)snapshot_get_le(&in, 4);
+        in.len = len - 4;
+        in.pos = sizeof SNAPSHOT_MAGIC;
+    }
+    if (ok) ok = snapshot_get_le(&in, 4) == SNAPSHOT_VERSION;
+
+    GolFrame* f = &(snap->cells);
+    if (ok) {
+        f->width = snapshot_get_le(&in, 8);
+        f->height = snapshot_get_le(&in, 8);
+        snap->iterations = snapshot_get_le(&in, 8);
+        snap->birth = (uint16_t)snapshot_get_le(&in, 2);
+        snap->survive = (uint16_t)snapshot_get_le(&in, 2);
+        snap->edge = (uint8_t)snapshot_get_le(&in, 1);
+        snap->theme = (uint8_t)snapshot_get_le(&in, 1);
+        snapshot_get_le(&in, 4);
+
+        f->row_words = (f->width + 63) / 64;
+        ok = f->width && f->height && f->row_words <= SIZE_MAX / sizeof(uint64_t) / f->height;
+    }
+    if (ok) {
+        f->capacity = f->row_words * f->height;
+        f->words = (uint64_t*)calloc(f->capacity, sizeof(uint64_t));
+        if (!(f->words)) {
+            panic("Allocation of the snapshot cells failed");
+            ok = false;
+        }
+    }
+
+    size_t tiles = f->row_words * ((f->height + 63) / 64);
+    size_t tile = 0;
+    while (ok && !(in.failed) && tile < tiles) {
+        size_t tx = tile % f->row_words, ty = tile / f->row_words;
+        uint64_t* words = f->words + ty * 64 * f->row_words + tx;
+        uint64_t mask = snapshot_tile_mask(f, tx);
+        size_t rows = snapshot_tile_rows(f, ty);
+
+        switch (snapshot_get_le(&in, 1)) {
+        case SnapshotTile_Empty: {
+            uint64_t run = snapshot_get_varint(&in);
+            if (run == 0 || run > tiles - tile) ok = false;
+            tile += run;
+        } break;
+        case SnapshotTile_Full: {
+            for (size_t r = 0; r < rows; r++) words[r * f->row_words] = mask;
+            tile++;
+        } break;
+        case SnapshotTile_Rows: {
+            uint64_t live_rows = snapshot_get_le(&in, 8);
+            if (rows < 64 && (live_rows >> rows)) ok = false;
+            for (size_t r = 0; r < rows && ok; r++) {
+                if ((live_rows >> r) & 1) words[r * f->row_words] = snapshot_get_le(&in, 8) & mask;
+            }
+            tile++;
+        } break;
+        default: ok = false;
+        }
+    }
+    ok = ok && !(in.failed) && in.pos == in.len;
+
+    free(data);
+    if (!ok) snapshot_deinit(snap);
+    return ok;
+}
+
+/* writing in the background */
+
+typedef enum SnapshotStatus {
+    SnapshotStatus_Idle = 0,
+    SnapshotStatus_Writing,
+    SnapshotStatus_Written,
+    SnapshotStatus_Failed,
+} SnapshotStatus;
+
+/// Writes one snapshot at a time on its own thread.
+typedef struct SnapshotWriter {
+    /// filled in by the caller before `snapshot_writer_start`, owned by the thread until it is done
+    GolSnapshot snap;
+    char path[256];
+    pthread_t thread;
+    bool started;
+    _Atomic SnapshotStatus status;
+} SnapshotWriter;
+
+static void* snapshot_writer_thread(void* arg) {
+    SnapshotWriter* w = (SnapshotWriter*)arg;
+    bool ok = snapshot_write(w->path, &(w->snap));
+    atomic_store_explicit(&(w->status), ok ? SnapshotStatus_Written : SnapshotStatus_Failed, memory_order_release);
+    return NULL;
+}
+
+static inline bool snapshot_writer_busy(SnapshotWriter* w) {
+    return atomic_load_explicit(&(w->status), memory_order_acquire) == SnapshotStatus_Writing;
+}
+
+/// Wait for the running write, if any.
+void snapshot_writer_wait(SnapshotWriter* w) {
+    if (!(w->started)) return;
+    pthread_join(w->thread, NULL);
+    w->started = false;
+}
+
+/// Write `w->snap` to `path` in the background. Returns false if a write is still running.
+bool snapshot_writer_start(SnapshotWriter* w, const char* path) {
+    if (snapshot_writer_busy(w)) return false;
+    snapshot_writer_wait(w);
+
+    snprintf(w->path, sizeof w->path, "%s", path);
+    atomic_store_explicit(&(w->status), SnapshotStatus_Writing, memory_order_relaxed);
+    if (pthread_create(&(w->thread), NULL, snapshot_writer_thread, w) != 0) {
+        atomic_store_explicit(&(w->status), SnapshotStatus_Failed, memory_order_relaxed);
+        return false;
+    }
+    w->started = true;
+    return true;
+}
+
+void snapshot_writer_deinit(SnapshotWriter* w) {
+    snapshot_writer_wait(w);
+    snapshot_deinit(&(w->snap));
+}
+
+#endif
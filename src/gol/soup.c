@@ -0,0 +1,520 @@
+#ifndef GOL_SOUP_C_
+#define GOL_SOUP_C_
+
+//! `MultiSim --soup <soups> [seed] [rule]` runs a soup search without opening a window:
+//! thousands of random SOUP_SIZE x SOUP_SIZE soups, each stepped on its own board until it
+//! repeats itself, spread over all cores. It reports what the soups end as and how long they
+//! lived, what objects they leave behind (see census.c), with the longest lived ones
+//! (methuselahs) as RLE to reproduce them.
+//! A board is a few KiB of bit-packed words on the stack of the thread stepping it and is
+//! reused for every soup, so a soup costs no allocation, and only the rows between its live
+//! cells are stepped and hashed. Soup `i` is made from the seed `seed + i`, so any soup of
+//! a search comes back with `--soup 1 <its seed>`.
+//! The edges of the board are dead. A spaceship that flies off is taken off the board when it
+//! comes near the edge, and counted with the objects. A soup that still reaches the edge (with
+//! a puffer, a gun or a spaceship the census doesn't recognise) is reported on its own, its
+//! lifespan and what it leaves behind are not what they would be on an unbounded board.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "census.c"
+#include "cycle.c"
+#include "packed.c"
+#include "pool.c"
+#include "rng.c"
+#include "rule.c"
+#include "universe.c"
+#include "../const.h"
+#include "../panic.h"
+
+#define SOUP_SIZE 16
+#define SOUP_DENSITY 0.5f
+// the side of the board a soup settles on, the soup starts at its centre.
+// Whole words, and fewer than 64 of them for the bits of `soup_run`.
+#define SOUP_BOARD 256
+#define SOUP_X ((SOUP_BOARD - SOUP_SIZE) / 2)
+#define SOUP_STRIDE (SOUP_BOARD / 64 + 2)
+// a spaceship this close to the edge of the board has left the soup behind
+#define SOUP_ESCAPE_MARGIN 32
+// generations between two looks for escaping spaceships, while something moves that close.
+// Even a c/2 spaceship goes only 8 cells in that time.
+#define SOUP_ESCAPE_INTERVAL 16
+// a soup that doesn't repeat itself by then is counted as unsettled
+#define SOUP_MAX_GENERATIONS 65536
+// soups between two progress reports
+#define SOUP_ROUND 8192
+#define SOUP_METHUSELAHS 8
+// the most common kinds of objects in the report
+#define SOUP_OBJECTS 16
+// lifespans in [2^(b - 1), 2^b) go to bucket b, up to SOUP_MAX_GENERATIONS
+#define SOUP_LIFESPAN_BUCKETS 18
+
+typedef enum SoupOutcome {
+    SoupOutcome_Died = 0,
+    SoupOutcome_Still,
+    SoupOutcome_Oscillating,
+    SoupOutcome_Unsettled,
+    SoupOutcome_Edge,
+    SoupOutcome_Count,
+} SoupOutcome;
+
+static const char* SOUP_OUTCOME_NAMES[] = {
+    [SoupOutcome_Died] = "died out",
+    [SoupOutcome_Still] = "still life",
+    [SoupOutcome_Oscillating] = "oscillating",
+    [SoupOutcome_Unsettled] = "unsettled",
+    [SoupOutcome_Edge] = "hit the edge",
+};
+
+typedef struct SoupResult {
+    uint64_t seed;
+    /// generations until the soup repeats itself
+    uint32_t lifespan;
+    /// 0 when unsettled, 1 for still lifes and empty boards
+    uint32_t period;
+    /// live cells at the end
+    uint32_t population;
+    /// spaceships taken off the board
+    uint32_t escaped;
+    bool reached_edge;
+} SoupResult;
+
+typedef struct SoupCensus {
+    uint64_t soups;
+    uint64_t generations;
+    uint64_t outcomes[SoupOutcome_Count];
+    uint64_t periods[GOL_CYCLE_WINDOW + 1];
+    uint64_t lifespans[SOUP_LIFESPAN_BUCKETS];
+    uint64_t population;
+    uint64_t escaped;
+    /// the longest lived soups that didn't reach the edge, longest first
+    SoupResult methuselahs[SOUP_METHUSELAHS];
+    size_t methuselah_count;
+} SoupCensus;
+
+/// What the pool steps: soup `i` of a round is made from `first_seed + i`.
+typedef struct SoupSearch {
+    GolRule rule;
+    uint32_t density;
+    uint64_t first_seed;
+    SoupResult* results;
+    /// the objects the soups leave behind
+    Census* objects;
+} SoupSearch;
+
+/// A board to run soups on and its scratch, one per thread.
+typedef struct SoupBoard {
+    PackedGrid g;
+    GolCycle cycle;
+    /// a bit per word of every row, with a dead row above and below: the words that changed
+    /// in the last generation, and the ones changing in this one
+    uint64_t* changed;
+    uint64_t* changes;
+    /// finds the spaceships near the edge, and the objects at the end
+    CensusScan* scan;
+} SoupBoard;
+
+/// The rows of the soup made from `seed`, bit x of a row is the cell at x.
+static void soup_rows(uint64_t seed, uint32_t density, uint16_t rows[SOUP_SIZE]) {
+    GolRng rng = rng_new(seed);
+    for (size_t y = 0; y < SOUP_SIZE; y += 4) {
+        uint64_t cells = rng_cells(&rng, density);
+        for (size_t i = 0; i < 4; i++) rows[y + i] = (uint16_t)(cells >> (16 * i));
+    }
+}
+
+/// Take the spaceships within SOUP_ESCAPE_MARGIN of the edge off the board, and count them.
+/// They came from the soup at the centre, so they fly away from it and would only hit the edge.
+/// Keeps the hash and the changed words up to date, and widens the rows [lo, hi) with changes.
+/// Returns how many were taken off.
+static uint32_t soup_escape(SoupBoard* b, const SoupSearch* search, uint64_t* hash, size_t* lo, size_t* hi) {
+    PackedGrid* g = &(b->g);
+    const CensusSource src = { .packed = g, .width = SOUP_BOARD, .height = SOUP_BOARD };
+    census_scan(b->scan, &src, NULL);
+    if (paniced) return 0;
+
+    uint32_t escaped = 0;
+    for (size_t o = 0; o < b->scan->object_count; o++) {
+        const CensusObject* obj = b->scan->objects + o;
+        const bool near_edge =
+            obj->min_x < SOUP_ESCAPE_MARGIN || obj->min_y < SOUP_ESCAPE_MARGIN ||
+            obj->max_x >= SOUP_BOARD - SOUP_ESCAPE_MARGIN || obj->max_y >= SOUP_BOARD - SOUP_ESCAPE_MARGIN;
+        CensusClass cls;
+        if (!near_edge || !census_identify(search->objects, b->scan, o, &(search->rule), &cls)) continue;
+        if (cls.kind != CensusKind_Spaceship) continue;
+
+        census_count_object(search->objects, b->scan, o, &(search->rule));
+        escaped++;
+        const CensusRun* runs = b->scan->sorted + obj->first_run;
+        for (uint32_t r = 0; r < obj->run_count; r++) {
+            const size_t y = runs[r].y;
+            uint64_t* row = PACKED_ROW(g, g->words, y);
+            for (size_t k = runs[r].x0 / 64; k <= runs[r].x1 / 64; k++) {
+                const size_t from = max(runs[r].x0, k * 64) - k * 64, to = min(runs[r].x1, k * 64 + 63) - k * 64;
+                const uint64_t mask = ((to - from == 63) ? ~UINT64_C(0) : (UINT64_C(1) << (to - from + 1)) - 1) << from;
+                const uint64_t word = row[k] & ~mask;
+                *hash ^= universe_hash_key(y * g->row_words + k, row[k]) ^ universe_hash_key(y * g->row_words + k, word);
+                row[k] = word;
+                b->changed[y + 1] |= UINT64_C(1) << k;
+            }
+            *lo = min(*lo, y);
+            *hi = max(*hi, y + 1);
+        }
+    }
+    return escaped;
+}
+
+/// Step the soup made from `seed` on the board `g` until it repeats itself.
+/// Debris that settled costs nothing: a word is only stepped when it or one of the eight words
+/// around it changed in the last generation, any other word stays as it is. `changed` and
+/// `changes` have a bit per word of every row, with a dead row above and below.
+static void soup_run(SoupBoard* board, const SoupSearch* search, uint64_t seed, SoupResult* out) {
+    PackedGrid* g = &(board->g);
+    GolCycle* cycle = &(board->cycle);
+    const GolRule* rule = &(search->rule);
+    uint16_t rows[SOUP_SIZE];
+    soup_rows(seed, search->density, rows);
+
+    memset(g->words, 0, SOUP_STRIDE * (SOUP_BOARD + 2) * sizeof(uint64_t));
+    memset(g->words_next, 0, SOUP_STRIDE * (SOUP_BOARD + 2) * sizeof(uint64_t));
+    memset(board->changed, 0, (SOUP_BOARD + 2) * sizeof(uint64_t));
+    memset(board->changes, 0, (SOUP_BOARD + 2) * sizeof(uint64_t));
+    cycle_reset(cycle);
+
+    // the soup changed from an empty board
+    uint64_t hash = 0;
+    for (size_t y = SOUP_X; y < SOUP_X + SOUP_SIZE; y++) {
+        uint64_t* row = PACKED_ROW(g, g->words, y);
+        row[SOUP_X / 64] |= (uint64_t)rows[y - SOUP_X] << (SOUP_X % 64);
+        if (SOUP_X % 64 + SOUP_SIZE > 64) row[SOUP_X / 64 + 1] |= (uint64_t)rows[y - SOUP_X] >> (64 - SOUP_X % 64);
+
+        for (size_t k = 0; k < g->row_words; k++) {
+            if (!row[k]) continue;
+            hash ^= universe_hash_key(y * g->row_words + k, row[k]);
+            board->changed[y + 1] |= UINT64_C(1) << k;
+        }
+    }
+    // the rows with changes
+    size_t lo = SOUP_X, hi = SOUP_X + SOUP_SIZE;
+    const uint64_t all_words = (UINT64_C(1) << g->row_words) - 1;
+    const size_t last = g->row_words - 1;
+    bool reached_edge = false;
+    // something changed within SOUP_ESCAPE_MARGIN rows or in the outer words of the board,
+    // and the generation the spaceships were last looked for
+    bool near_edge = false;
+    uint32_t escape_gen = 0;
+
+    *out = (SoupResult){ .seed = seed };
+    for (uint32_t gen = 0;; gen++) {
+        // stepping on would only tell what the edge makes of it
+        if (reached_edge) {
+            out->lifespan = gen;
+            break;
+        }
+        if (near_edge && gen - escape_gen >= SOUP_ESCAPE_INTERVAL && board->scan) {
+            escape_gen = gen;
+            near_edge = false;
+            const uint32_t escaped = soup_escape(board, search, &hash, &lo, &hi);
+            // the world before the spaceships left can't come back
+            if (escaped) cycle_reset(cycle);
+            out->escaped += escaped;
+        }
+
+        if (cycle_push(cycle, hash) || gen == SOUP_MAX_GENERATIONS) {
+            out->period = cycle->period;
+            out->lifespan = gen - cycle->period;
+            break;
+        }
+
+        // the rows next to a change can change too
+        const size_t y0 = lo ? lo - 1 : 0, y1 = min(hi + 1, SOUP_BOARD);
+        size_t next_lo = SIZE_MAX, next_hi = 0;
+        uint64_t* changed = board->changed;
+        for (size_t y = y0; y < y1; y++) {
+            uint64_t near = changed[y] | changed[y + 1] | changed[y + 2];
+            near = (near | (near << 1) | (near >> 1)) & all_words;
+            if (!near) continue;
+
+            const uint64_t* a = PACKED_ROW(g, g->words, y) - g->stride;
+            const uint64_t* b = PACKED_ROW(g, g->words, y);
+            const uint64_t* c = PACKED_ROW(g, g->words, y) + g->stride;
+            uint64_t* next = PACKED_ROW(g, g->words_next, y);
+            uint64_t row_changes = 0;
+
+            for (; near; near &= near - 1) {
+                const size_t i = (size_t)__builtin_ctzll(near);
+                next[i] = packed_step_word(
+                    rule,
+                    a[i - 1], a[i], a[i + 1],
+                    b[i - 1], b[i], b[i + 1],
+                    c[i - 1], c[i], c[i + 1]
+                );
+                if (next[i] == b[i]) continue;
+
+                hash ^= universe_hash_key(y * g->row_words + i, b[i]) ^ universe_hash_key(y * g->row_words + i, next[i]);
+                row_changes |= UINT64_C(1) << i;
+            }
+            board->changes[y + 1] = row_changes;
+            if (!row_changes) continue;
+
+            next_lo = min(next_lo, y);
+            next_hi = y + 1;
+            reached_edge |= y == 0 || y == SOUP_BOARD - 1 || (next[0] & 1) || (next[last] >> 63);
+            near_edge |= y < SOUP_ESCAPE_MARGIN || y >= SOUP_BOARD - SOUP_ESCAPE_MARGIN ||
+                (row_changes & 1) || (row_changes >> last);
+        }
+
+        // the words that were not stepped are the same in both generations
+        packed_swap(g);
+        memset(changed + y0 + 1, 0, (y1 - y0) * sizeof(uint64_t));
+        board->changed = board->changes;
+        board->changes = changed;
+
+        lo = next_lo;
+        hi = next_hi;
+        if (lo == SIZE_MAX) lo = hi = 0;
+    }
+
+    for (size_t y = 0; y < SOUP_BOARD; y++) {
+        const uint64_t* row = PACKED_ROW(g, g->words, y);
+        for (size_t k = 0; k < g->row_words; k++) out->population += (uint32_t)__builtin_popcountll(row[k]);
+    }
+    out->reached_edge = reached_edge;
+}
+
+/// Run the soups [y0, y1) of a round, each thread on a board of its own.
+static void soup_job(void* ctx, size_t y0, size_t y1) {
+    const SoupSearch* search = (const SoupSearch*)ctx;
+    uint64_t words[2][SOUP_STRIDE * (SOUP_BOARD + 2)];
+    uint64_t changed[2][SOUP_BOARD + 2];
+    SoupBoard board = {
+        .g = {
+            .words = words[0],
+            .words_next = words[1],
+            .width = SOUP_BOARD,
+            .height = SOUP_BOARD,
+            .row_words = SOUP_BOARD / 64,
+            .stride = SOUP_STRIDE,
+            .capacity_height = SOUP_BOARD,
+            .tail_mask = packed_tail_mask(SOUP_BOARD),
+        },
+        .changed = changed[0],
+        .changes = changed[1],
+        .scan = census_scan_alloc(),
+    };
+    const CensusSource src = { .packed = &(board.g), .width = SOUP_BOARD, .height = SOUP_BOARD };
+
+    for (size_t i = y0; i < y1; i++) {
+        SoupResult* r = search->results + i;
+        soup_run(&board, search, search->first_seed + i, r);
+        // debris piled up at the edge is not what the soup leaves behind
+        if (!(board.scan) || r->reached_edge) continue;
+        census_scan(board.scan, &src, NULL);
+        census_count(search->objects, board.scan, &(search->rule));
+    }
+    census_scan_free(board.scan);
+}
+
+/// Count one soup in the census.
+static void soup_census_add(SoupCensus* census, const SoupResult* r) {
+    SoupOutcome outcome = SoupOutcome_Oscillating;
+    if (r->reached_edge) outcome = SoupOutcome_Edge;
+    else if (r->period == 0) outcome = SoupOutcome_Unsettled;
+    else if (r->population == 0) outcome = SoupOutcome_Died;
+    else if (r->period == 1) outcome = SoupOutcome_Still;
+
+    census->soups++;
+    census->generations += r->lifespan + r->period;
+    census->outcomes[outcome]++;
+    census->escaped += r->escaped;
+    // what a soup does after hitting the edge says nothing about it
+    if (outcome == SoupOutcome_Edge) return;
+    census->periods[r->period]++;
+    census->population += r->population;
+
+    size_t bucket = 0;
+    while (bucket + 1 < SOUP_LIFESPAN_BUCKETS && (UINT64_C(1) << bucket) <= r->lifespan) bucket++;
+    census->lifespans[bucket]++;
+
+    // insertion into the few longest, the shorter ones drop off the end
+    size_t i = census->methuselah_count;
+    if (i == SOUP_METHUSELAHS) {
+        if (census->methuselahs[i - 1].lifespan >= r->lifespan) return;
+        i--;
+    }
+    else census->methuselah_count++;
+    for (; i > 0 && census->methuselahs[i - 1].lifespan < r->lifespan; i--) {
+        census->methuselahs[i] = census->methuselahs[i - 1];
+    }
+    census->methuselahs[i] = *r;
+}
+
+/// Print the soup made from `seed` as RLE, to paste into the game or any other Life program.
+static void soup_print_rle(uint64_t seed, uint32_t density, const GolRule* rule) {
+    uint16_t rows[SOUP_SIZE];
+    soup_rows(seed, density, rows);
+    printf("x = %d, y = %d, rule = %s\n", SOUP_SIZE, SOUP_SIZE, rule->name);
+
+    char line[80];
+    size_t len = 0;
+    // the last row written, rows in between are ended right away
+    size_t last = 0;
+    for (size_t y = 0; y < SOUP_SIZE; y++) {
+        if (rows[y] == 0) continue;
+
+        char ends[24] = "";
+        if (y - last > 1) snprintf(ends, sizeof ends, "%zu$", y - last);
+        else if (y - last == 1) snprintf(ends, sizeof ends, "$");
+        last = y;
+
+        char runs[8 * SOUP_SIZE + 24];
+        size_t runs_len = (size_t)snprintf(runs, sizeof runs, "%s", ends);
+        for (size_t x = 0; x < SOUP_SIZE && (rows[y] >> x);) {
+            int alive = (rows[y] >> x) & 1;
+            size_t n = 0;
+            while (x < SOUP_SIZE && (int)((rows[y] >> x) & 1) == alive) {
+                x++;
+                n++;
+            }
+            const char tag = alive ? 'o' : 'b';
+            if (n > 1) runs_len += (size_t)snprintf(runs + runs_len, sizeof runs - runs_len, "%zu%c", n, tag);
+            else runs_len += (size_t)snprintf(runs + runs_len, sizeof runs - runs_len, "%c", tag);
+        }
+
+        // lines of RLE stay within 70 characters, with the closing '!'
+        if (len + runs_len >= 70) {
+            printf("%.*s\n", (int)len, line);
+            len = 0;
+        }
+        memcpy(line + len, runs, runs_len);
+        len += runs_len;
+    }
+    printf("%.*s!\n", (int)len, line);
+}
+
+static void soup_print_census(const SoupCensus* census, const SoupSearch* search) {
+    const double soups = (double)max(census->soups, 1);
+    // the soups that didn't hit the edge, the rest of the report is about them
+    const uint64_t bounded = census->soups - census->outcomes[SoupOutcome_Edge];
+
+    printf("\n%llu soups, %llu generations\n", (unsigned long long)census->soups, (unsigned long long)census->generations);
+    for (int o = 0; o < SoupOutcome_Count; o++) {
+        printf("  %-12s %10llu  %5.1f%%\n", SOUP_OUTCOME_NAMES[o], (unsigned long long)census->outcomes[o], 100.0 * (double)census->outcomes[o] / soups);
+    }
+    printf("  periods:");
+    for (size_t p = 2; p <= GOL_CYCLE_WINDOW; p++) {
+        if (census->periods[p]) printf(" p%zu x %llu", p, (unsigned long long)census->periods[p]);
+    }
+    printf("\n  %.1f live cells left on average, %llu spaceships flew off the board\n",
+        (double)census->population / (double)max(bounded, 1), (unsigned long long)census->escaped
+    );
+
+    printf("\nlifespans of the %llu soups that didn't hit the edge:\n", (unsigned long long)bounded);
+    for (size_t b = 0; b < SOUP_LIFESPAN_BUCKETS; b++) {
+        if (!census->lifespans[b]) continue;
+        printf("  < %-8llu %10llu  %5.1f%%\n",
+            (unsigned long long)(UINT64_C(1) << b), (unsigned long long)census->lifespans[b],
+            100.0 * (double)census->lifespans[b] / (double)max(bounded, 1)
+        );
+    }
+
+    CensusClass top[SOUP_OBJECTS];
+    const size_t shown = census_top(search->objects, top, SOUP_OBJECTS);
+    const double objects = (double)max(search->objects->objects, 1);
+    printf("\n%llu objects left behind:\n", (unsigned long long)search->objects->objects);
+    for (size_t i = 0; i < shown; i++) {
+        char label[64];
+        census_label(top + i, label, sizeof label);
+        printf("  %-28s %10llu  %5.1f%%  %s",
+            label, (unsigned long long)top[i].count, 100.0 * (double)top[i].count / objects, CENSUS_KIND_NAMES[top[i].kind]
+        );
+        if (top[i].kind != CensusKind_Still) printf(" p%u", top[i].period);
+        printf("\n");
+    }
+    printf("  %-28s %10llu  %5.1f%%\n", "unsettled alone", (unsigned long long)search->objects->unsettled,
+        100.0 * (double)search->objects->unsettled / objects
+    );
+    printf("  %-28s %10llu  %5.1f%%\n", "too large to tell", (unsigned long long)search->objects->large,
+        100.0 * (double)search->objects->large / objects
+    );
+
+    printf("\nmethuselahs:\n");
+    for (size_t i = 0; i < census->methuselah_count; i++) {
+        const SoupResult* r = census->methuselahs + i;
+        printf("\n#%zu seed %llu: %u generations, then %u cells", i + 1, (unsigned long long)r->seed, r->lifespan, r->population);
+        if (r->period > 1) printf(" with period %u", r->period);
+        if (r->period == 0) printf(", unsettled");
+        printf("\n");
+        soup_print_rle(r->seed, search->density, &(search->rule));
+    }
+}
+
+static double soup_now(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+int soup_search(int argc, char** argv) {
+    uint64_t soups = (argc > 0) ? strtoull(argv[0], NULL, 10) : 0;
+    SoupSearch search = {
+        .rule = rule_conway(),
+        .density = rng_density(SOUP_DENSITY),
+        .first_seed = (argc > 1) ? strtoull(argv[1], NULL, 10) : (uint64_t)time(NULL),
+    };
+    if (soups == 0 || (argc > 2 && !rule_parse(argv[2], &(search.rule)))) {
+        fprintf(stderr, "usage: --soup <soups> [seed] [rule]\n");
+        return 1;
+    }
+
+    search.results = (SoupResult*)malloc(SOUP_ROUND * sizeof(SoupResult));
+    search.objects = census_alloc();
+    GolPool* pool = gol_pool_new(gol_pool_hardware_threads());
+    if (paniced || !(search.results) || !(search.objects)) {
+        fprintf(stderr, "%s\n", paniced ? panic_msg : "Allocation of soup_search failed");
+        free(search.results);
+        census_free(search.objects);
+        gol_pool_free(pool);
+        return 1;
+    }
+
+    printf(
+        "%llu soups of %d x %d at %.0f%% on %d x %d, %s, seeds from %llu, %zu threads\n",
+        (unsigned long long)soups, SOUP_SIZE, SOUP_SIZE, 100.0 * SOUP_DENSITY, SOUP_BOARD, SOUP_BOARD,
+        search.rule.name, (unsigned long long)(search.first_seed), pool->thread_count
+    );
+
+    SoupCensus census = {0};
+    const double start = soup_now();
+    double last_report = start;
+    for (uint64_t done = 0; done < soups;) {
+        size_t round = (size_t)min(soups - done, SOUP_ROUND);
+        gol_pool_run(pool, soup_job, &search, round);
+        for (size_t i = 0; i < round; i++) soup_census_add(&census, search.results + i);
+        search.first_seed += round;
+        done += round;
+
+        double now = soup_now();
+        if (now - last_report >= 1.0 || done == soups) {
+            last_report = now;
+            printf(
+                "%llu soups, %.0f soups/s, %.2f Mgen/s\n", (unsigned long long)done,
+                (double)done / (now - start), (double)census.generations / (now - start) / 1e6
+            );
+            fflush(stdout);
+        }
+    }
+
+    soup_print_census(&census, &search);
+    free(search.results);
+    census_free(search.objects);
+    gol_pool_free(pool);
+    return 0;
+}
+
+#endif
@@ -0,0 +1,355 @@
+#ifndef GOL_SPARSE_C_
+#define GOL_SPARSE_C_
+
+//! An unbounded universe made of 64x64 tiles, stored in a hash map keyed by tile coordinate.
+//! Only the tiles that changed in the last generation and their neighbours are stepped,
+//! and tiles that are empty and settled are freed, so dead or still space costs nothing.
+//! A tile is 64 row words in the layout of `PackedGrid`, bit `i` is the cell at x = tx * 64 + i.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cell.c"
+#include "packed.c"
+#include "universe.c"
+#include "../const.h"
+#include "../panic.h"
+
+#define SPARSE_TILE_LOG2 6
+#define SPARSE_TILE (1 << SPARSE_TILE_LOG2)
+
+typedef struct SparseTile {
+    uint64_t rows[SPARSE_TILE];
+    uint64_t next[SPARSE_TILE];
+    int32_t tx, ty;
+    /// the generation this tile was last scheduled to be stepped in
+    uint64_t scheduled;
+    /// changed in the last generation (or edited since), and listed in `SparseLife.changed`
+    bool changed;
+} SparseTile;
+
+/// A growable array of tile pointers.
+typedef struct SparseTileList {
+    SparseTile** items;
+    size_t len, cap;
+} SparseTileList;
+
+typedef struct SparseLife {
+    // open addressing table with linear probing, NULL marks a free slot
+    SparseTile** slots;
+    size_t slot_count;
+    size_t tile_count;
+
+    SparseTileList changed;
+    SparseTileList schedule;
+
+    GolRule rule;
+
+    uint64_t generation;
+} SparseLife;
+
+static const uint64_t SPARSE_EMPTY_ROWS[SPARSE_TILE] = {0};
+
+static void sparse_list_push(SparseTileList* list, SparseTile* t) {
+    if (list->len == list->cap) {
+        size_t cap = list->cap ? list->cap * 2 : 64;
+        SparseTile** items = (SparseTile**)realloc(list->items, cap * sizeof(SparseTile*));
+        if (!items) {
+            panic("Growing a sparse tile list failed");
+            return;
+        }
+        list->items = items;
+        list->cap = cap;
+    }
+    list->items[list->len++] = t;
+}
+
+static inline size_t sparse_hash(int32_t tx, int32_t ty) {
+    uint64_t h = ((uint64_t)(uint32_t)tx << 32) | (uint32_t)ty;
+    h *= 0x9E3779B97F4A7C15ull;
+    return (size_t)(h ^ (h >> 32));
+}
+
+SparseLife* sparse_alloc(void) {
+    SparseLife* sl = (SparseLife*)calloc(1, sizeof(SparseLife));
+    if (!sl) {
+        panic("Allocation of sparse_alloc failed");
+        return NULL;
+    }
+
+    sl->rule = rule_conway();
+    sl->slot_count = 1024;
+    sl->slots = (SparseTile**)calloc(sl->slot_count, sizeof(SparseTile*));
+    if (!(sl->slots)) panic("Allocation of the sparse tile table failed");
+    return sl;
+}
+
+/// Free every tile, leaving an empty world.
+void sparse_clear(SparseLife* sl) {
+    for (size_t i = 0; i < sl->slot_count; i++) {
+        free(sl->slots[i]);
+        sl->slots[i] = NULL;
+    }
+    sl->tile_count = 0;
+    sl->changed.len = 0;
+    sl->schedule.len = 0;
+}
+
+void sparse_free(SparseLife* sl) {
+    sparse_clear(sl);
+    free(sl->slots);
+    free(sl->changed.items);
+    free(sl->schedule.items);
+    free(sl);
+}
+
+/// The live cells of the whole world.
+uint64_t sparse_population(const SparseLife* sl) {
+    uint64_t population = 0;
+    for (size_t i = 0; i < sl->slot_count; i++) {
+        if (!(sl->slots[i])) continue;
+        for (int r = 0; r < SPARSE_TILE; r++) population += (uint64_t)__builtin_popcountll(sl->slots[i]->rows[r]);
+    }
+    return population;
+}
+
+static SparseTile* sparse_find(const SparseLife* sl, int32_t tx, int32_t ty) {
+    size_t mask = sl->slot_count - 1;
+
+    for (size_t i = sparse_hash(tx, ty) & mask; sl->slots[i]; i = (i + 1) & mask) {
+        if (sl->slots[i]->tx == tx && sl->slots[i]->ty == ty) return sl->slots[i];
+    }
+    return NULL;
+}
+
+static void sparse_insert_slot(SparseTile** slots, size_t slot_count, SparseTile* t) {
+    size_t mask = slot_count - 1;
+    size_t i = sparse_hash(t->tx, t->ty) & mask;
+
+    while (slots[i]) i = (i + 1) & mask;
+    slots[i] = t;
+}
+
+/// Create an empty tile, which must not exist yet.
+static SparseTile* sparse_create(SparseLife* sl, int32_t tx, int32_t ty) {
+    if ((sl->tile_count + 1) * 2 > sl->slot_count) {
+        size_t slot_count = sl->slot_count * 2;
+        SparseTile** slots = (SparseTile**)calloc(slot_count, sizeof(SparseTile*));
+        if (!slots) {
+            panic("Growing the sparse tile table failed");
+            return NULL;
+        }
+        for (size_t i = 0; i < sl->slot_count; i++) {
+            if (sl->slots[i]) sparse_insert_slot(slots, slot_count, sl->slots[i]);
+        }
+        free(sl->slots);
+        sl->slots = slots;
+        sl->slot_count = slot_count;
+    }
+
+    SparseTile* t = (SparseTile*)calloc(1, sizeof(SparseTile));
+    if (!t) {
+        panic("Allocation of a sparse tile failed");
+        return NULL;
+    }
+    t->tx = tx;
+    t->ty = ty;
+
+    sparse_insert_slot(sl->slots, sl->slot_count, t);
+    sl->tile_count++;
+    return t;
+}
+
+/// Remove and free a tile, shifting back the probe chain behind it.
+static void sparse_remove(SparseLife* sl, SparseTile* t) {
+    size_t mask = sl->slot_count - 1;
+    size_t i = sparse_hash(t->tx, t->ty) & mask;
+
+    while (sl->slots[i] != t) i = (i + 1) & mask;
+
+    for (size_t j = (i + 1) & mask; sl->slots[j]; j = (j + 1) & mask) {
+        size_t home = sparse_hash(sl->slots[j]->tx, sl->slots[j]->ty) & mask;
+        // the entry at j can stay if its home slot lies cyclically in (i, j]
+        bool stays = (i <= j) ? (i < home && home <= j) : (i < home || home <= j);
+        if (stays) continue;
+        sl->slots[i] = sl->slots[j];
+        i = j;
+    }
+    sl->slots[i] = NULL;
+    sl->tile_count--;
+    free(t);
+}
+
+static inline void sparse_mark_changed(SparseLife* sl, SparseTile* t) {
+    if (t->changed) return;
+    t->changed = true;
+    sparse_list_push(&(sl->changed), t);
+}
+
+GolCell sparse_get(const SparseLife* sl, int64_t x, int64_t y) {
+    SparseTile* t = sparse_find(sl, (int32_t)(x >> SPARSE_TILE_LOG2), (int32_t)(y >> SPARSE_TILE_LOG2));
+    if (!t) return Dead;
+    return (t->rows[y & (SPARSE_TILE - 1)] >> (x & (SPARSE_TILE - 1))) & 1;
+}
+
+void sparse_set(SparseLife* sl, int64_t x, int64_t y, GolCell to) {
+    int32_t tx = (int32_t)(x >> SPARSE_TILE_LOG2);
+    int32_t ty = (int32_t)(y >> SPARSE_TILE_LOG2);
+    SparseTile* t = sparse_find(sl, tx, ty);
+
+    if (!t) {
+        if (!to) return;
+        t = sparse_create(sl, tx, ty);
+    }
+
+    uint64_t* row = &(t->rows[y & (SPARSE_TILE - 1)]);
+    uint64_t bit = UINT64_C(1) << (x & (SPARSE_TILE - 1));
+    *row = to ? (*row | bit) : (*row & ~bit);
+    sparse_mark_changed(sl, t);
+}
+
+/// Switch to another rule. Settled tiles are only stepped again when something near them
+/// changes, so every tile is marked as changed for the new rule to reach them.
+void sparse_set_rule(SparseLife* sl, const GolRule* rule) {
+    sl->rule = *rule;
+    for (size_t i = 0; i < sl->slot_count; i++) {
+        if (sl->slots[i]) sparse_mark_changed(sl, sl->slots[i]);
+    }
+}
+
+/// Whether `t` has live cells on the edge or corner facing its neighbour at (dx, dy).
+static bool sparse_edge_alive(const SparseTile* t, int dx, int dy) {
+    uint64_t column = (dx < 0) ? UINT64_C(1) : (dx > 0) ? UINT64_C(1) << 63 : ~UINT64_C(0);
+
+    if (dy < 0) return t->rows[0] & column;
+    if (dy > 0) return t->rows[SPARSE_TILE - 1] & column;
+
+    for (int r = 0; r < SPARSE_TILE; r++) {
+        if (t->rows[r] & column) return true;
+    }
+    return false;
+}
+
+/// Whether any cell around the missing tile at (tx, ty) is alive, which is the only way
+/// it can get a birth. Those cells may lie in any of the tiles next to it, not only in the
+/// one that changed: a corner cell that dies can leave three live cells in the others.
+static bool sparse_border_alive(const SparseLife* sl, int32_t tx, int32_t ty) {
+    for (int dy = -1; dy <= 1; dy++) {
+        for (int dx = -1; dx <= 1; dx++) {
+            if (!dx && !dy) continue;
+            SparseTile* nb = sparse_find(sl, tx + dx, ty + dy);
+            if (nb && sparse_edge_alive(nb, -dx, -dy)) return true;
+        }
+    }
+    return false;
+}
+
+static void sparse_step_tile(const SparseLife* sl, SparseTile* t) {
+    // rows of the 3x3 tiles around t, indexed [dy + 1][dx + 1]
+    const uint64_t* n[3][3];
+    for (int dy = -1; dy <= 1; dy++) {
+        for (int dx = -1; dx <= 1; dx++) {
+            SparseTile* nb = (dx || dy) ? sparse_find(sl, t->tx + dx, t->ty + dy) : t;
+            n[dy + 1][dx + 1] = nb ? nb->rows : SPARSE_EMPTY_ROWS;
+        }
+    }
+
+    for (int r = 0; r < SPARSE_TILE; r++) {
+        // the tile row (0, 1 or 2) and row index of the rows above and below r
+        int at = (r == 0) ? 0 : 1, ar = (r == 0) ? SPARSE_TILE - 1 : r - 1;
+        int ct = (r == SPARSE_TILE - 1) ? 2 : 1, cr = (r == SPARSE_TILE - 1) ? 0 : r + 1;
+
+        t->next[r] = packed_step_word(
+            &(sl->rule),
+            n[at][0][ar], n[at][1][ar], n[at][2][ar],
+            n[1][0][r], n[1][1][r], n[1][2][r],
+            n[ct][0][cr], n[ct][1][cr], n[ct][2][cr]
+        );
+    }
+}
+
+/// Advance the world one generation.
+void sparse_step(SparseLife* sl) {
+    uint64_t stamp = ++(sl->generation);
+
+    // schedule the changed tiles and their neighbours, creating the neighbours
+    // that can receive births from live cells around them
+    sl->schedule.len = 0;
+    for (size_t i = 0; i < sl->changed.len; i++) {
+        SparseTile* t = sl->changed.items[i];
+
+        for (int dy = -1; dy <= 1; dy++) {
+            for (int dx = -1; dx <= 1; dx++) {
+                SparseTile* nb = (dx || dy) ? sparse_find(sl, t->tx + dx, t->ty + dy) : t;
+                if (!nb) {
+                    if (!sparse_border_alive(sl, t->tx + dx, t->ty + dy)) continue;
+                    nb = sparse_create(sl, t->tx + dx, t->ty + dy);
+                }
+                if (nb->scheduled != stamp) {
+                    nb->scheduled = stamp;
+                    sparse_list_push(&(sl->schedule), nb);
+                }
+            }
+        }
+    }
+
+    // every tile reads its neighbours' current rows, so all are stepped before any swaps
+    for (size_t i = 0; i < sl->schedule.len; i++) {
+        sparse_step_tile(sl, sl->schedule.items[i]);
+    }
+
+    sl->changed.len = 0;
+    for (size_t i = 0; i < sl->schedule.len; i++) {
+        SparseTile* t = sl->schedule.items[i];
+
+        t->changed = memcmp(t->rows, t->next, sizeof(t->rows)) != 0;
+        if (t->changed) {
+            memcpy(t->rows, t->next, sizeof(t->rows));
+            sparse_list_push(&(sl->changed), t);
+        }
+        else if (memcmp(t->rows, SPARSE_EMPTY_ROWS, sizeof(t->rows)) == 0) {
+            sparse_remove(sl, t);
+        }
+    }
+    sl->schedule.len = 0;
+}
+
+/// Replace the whole world with the cells of `uvs`, placed at [0, width) x [0, height).
+void sparse_load_universe(SparseLife* sl, Universe* uvs) {
+    sparse_clear(sl);
+
+    for (size_t y = 0; y < uvs->height; y++) {
+        for (size_t x = 0; x < uvs->width; x++) {
+            if (universe_get(uvs, x, y)) sparse_set(sl, (int64_t)x, (int64_t)y, Alive);
+        }
+    }
+}
+
+/// Copy the part of the world at [0, width) x [0, height) into `uvs`.
+void sparse_store_universe(const SparseLife* sl, Universe* uvs) {
+    universe_fill(uvs, Dead);
+
+    int32_t tiles_w = (int32_t)((uvs->width + SPARSE_TILE - 1) >> SPARSE_TILE_LOG2);
+    int32_t tiles_h = (int32_t)((uvs->height + SPARSE_TILE - 1) >> SPARSE_TILE_LOG2);
+
+    for (int32_t ty = 0; ty < tiles_h; ty++) {
+        for (int32_t tx = 0; tx < tiles_w; tx++) {
+            SparseTile* t = sparse_find(sl, tx, ty);
+            if (!t) continue;
+
+            for (int r = 0; r < SPARSE_TILE; r++) {
+                size_t y = ((size_t)ty << SPARSE_TILE_LOG2) + r;
+                if (y >= uvs->height) break;
+
+                for (uint64_t bits = t->rows[r]; bits; bits &= bits - 1) {
+                    size_t x = ((size_t)tx << SPARSE_TILE_LOG2) + __builtin_ctzll(bits);
+                    if (x < uvs->width) universe_set(uvs, x, y, Alive);
+                }
+            }
+        }
+    }
+}
+
+#endif
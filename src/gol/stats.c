@@ -0,0 +1,143 @@
+#ifndef GOL_STATS_C_
+#define GOL_STATS_C_
+
+//! Streams the statistics of every generation to a CSV file, for offline analysis.
+//! The simulation thread only copies a row into a ring, a writer thread formats the
+//! rows and writes them through a large stdio buffer, so stepping doesn't wait on the
+//! disk unless the writer falls a whole ring behind.
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "universe.c"
+
+// rows, must be a power of two
+#define STATS_LOG_RING_SIZE 65536
+#define STATS_LOG_FILE_BUFFER (1 << 20)
+
+typedef struct StatsRow {
+    uint64_t iterations;
+    UniverseStats stats;
+} StatsRow;
+
+typedef struct StatsLog {
+    FILE* file;
+    char* file_buffer;
+    char path[64];
+    StatsRow* ring;
+    // next row to write, written by the writer thread
+    atomic_size_t head;
+    // next row to fill, written by the simulation thread
+    atomic_size_t tail;
+    atomic_bool stop;
+    pthread_t thread;
+    bool started;
+} StatsLog;
+
+static inline void stats_log_nap(void) {
+    struct timespec nap = { .tv_sec = 0, .tv_nsec = 1000000 };
+    nanosleep(&nap, NULL);
+}
+
+static void* stats_log_thread(void* arg) {
+    StatsLog* log = (StatsLog*)arg;
+
+    for (;;) {
+        size_t head = atomic_load_explicit(&(log->head), memory_order_relaxed);
+        size_t tail = atomic_load_explicit(&(log->tail), memory_order_acquire);
+
+        if (head == tail) {
+            // everything pushed before the stop is written
+            if (atomic_load_explicit(&(log->stop), memory_order_acquire) &&
+                atomic_load_explicit(&(log->tail), memory_order_acquire) == head) break;
+            stats_log_nap();
+            continue;
+        }
+
+        for (; head != tail; atomic_store_explicit(&(log->head), ++head, memory_order_release)) {
+            const StatsRow* row = &(log->ring[head & (STATS_LOG_RING_SIZE - 1)]);
+            const UniverseStats* s = &(row->stats);
+
+            if (s->population) {
+                fprintf(
+                    log->file, "%llu,%llu,%llu,%llu,%zu,%zu,%zu,%zu\n",
+                    (unsigned long long)row->iterations, (unsigned long long)s->population,
+                    (unsigned long long)s->births, (unsigned long long)s->deaths,
+                    s->min_x, s->min_y, s->max_x, s->max_y
+                );
+            }
+            else {
+                fprintf(
+                    log->file, "%llu,0,%llu,%llu,,,,\n",
+                    (unsigned long long)row->iterations, (unsigned long long)s->births, (unsigned long long)s->deaths
+                );
+            }
+        }
+    }
+    return NULL;
+}
+
+static void stats_log_release(StatsLog* log) {
+    if (log->file) fclose(log->file);
+    free(log->file_buffer);
+    free(log->ring);
+    log->file = NULL;
+    log->file_buffer = NULL;
+    log->ring = NULL;
+}
+
+/// Start writing rows to a new file at `path`, false when the file or the writer can't be started.
+bool stats_log_start(StatsLog* log, const char* path) {
+    if (log->started) return true;
+
+    log->ring = (StatsRow*)malloc(STATS_LOG_RING_SIZE * sizeof(StatsRow));
+    log->file_buffer = (char*)malloc(STATS_LOG_FILE_BUFFER);
+    log->file = fopen(path, "w");
+    if (!(log->ring) || !(log->file_buffer) || !(log->file)) {
+        stats_log_release(log);
+        return false;
+    }
+    setvbuf(log->file, log->file_buffer, _IOFBF, STATS_LOG_FILE_BUFFER);
+    fputs("generation,population,births,deaths,min_x,min_y,max_x,max_y\n", log->file);
+
+    snprintf(log->path, sizeof log->path, "%s", path);
+    atomic_store(&(log->head), 0);
+    atomic_store(&(log->tail), 0);
+    atomic_store(&(log->stop), false);
+    if (pthread_create(&(log->thread), NULL, stats_log_thread, log) != 0) {
+        stats_log_release(log);
+        return false;
+    }
+    log->started = true;
+    return true;
+}
+
+static inline bool stats_log_active(const StatsLog* log) {
+    return log->started;
+}
+
+/// Queue a row, from the one thread that steps. Waits for the writer when the ring is full.
+void stats_log_push(StatsLog* log, uint64_t iterations, const UniverseStats* stats) {
+    size_t tail = atomic_load_explicit(&(log->tail), memory_order_relaxed);
+    while (tail - atomic_load_explicit(&(log->head), memory_order_acquire) == STATS_LOG_RING_SIZE) stats_log_nap();
+
+    log->ring[tail & (STATS_LOG_RING_SIZE - 1)] = (StatsRow){ .iterations = iterations, .stats = *stats };
+    atomic_store_explicit(&(log->tail), tail + 1, memory_order_release);
+}
+
+/// Write the queued rows and close the file. Nothing may push while it stops.
+void stats_log_stop(StatsLog* log) {
+    if (!(log->started)) return;
+
+    atomic_store_explicit(&(log->stop), true, memory_order_release);
+    pthread_join(log->thread, NULL);
+    stats_log_release(log);
+    log->started = false;
+}
+
+#endif
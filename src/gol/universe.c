@@ -3,11 +3,20 @@
 
 //! Implementation of the 'universe' of cells.
 //! AKA a dynamically sized flat array that stores the state of all the cells.
+//! The byte backend pads the grid with a one cell ghost border (the halo), which is
+//! filled once per generation according to the edge mode, and steps from the front
+//! buffer `cells` into the back buffer `cells_next` before swapping the two.
 //! NOTE sizeof(Cell) is omitted in pointer arithmetic because it is of type bool,
 //! which has a size of 1 byte.
 
 #include "raylib.h"
 #include "cell.c"
+#include "packed.c"
+#include "pool.c"
+#include "simd.c"
+#include "block.c"
+#include "events.c"
+#include "rng.c"
 #include "../gamestate.h"
 #include "../const.h"
 
@@ -16,122 +25,729 @@
 
 #include <stdlib.h>
 #include <memory.h>
+#include <stdatomic.h>
 
 #define Cell GolCell
 
+// rows stepped before they are scanned for the hash and statistics
+#define UNIVERSE_SCAN_ROWS 16
+
+/// How the cells are stored, see `universe_set_backend`.
+typedef enum UniverseBackend {
+    /// one byte per cell in `cells`
+    UniverseBackend_Bytes = 0,
+    /// 64 cells per word in `packed`
+    UniverseBackend_Packed,
+} UniverseBackend;
+
+static const char* UNIVERSE_BACKEND_NAMES[] = {
+    [UniverseBackend_Bytes] = "bytes",
+    [UniverseBackend_Packed] = "bit-packed",
+};
+
+/// What lies past the edges of the grid.
+typedef enum UniverseEdge {
+    /// dead cells
+    UniverseEdge_Dead = 0,
+    /// the opposite edge, making the grid a torus
+    UniverseEdge_Wrap,
+} UniverseEdge;
+
+/// How the byte backend steps its cells.
+typedef enum UniverseKernel {
+    /// a row at a time with the widest row kernel of the CPU, see simd.c
+    UniverseKernel_Rows = 0,
+    /// a 2x2 block at a time with a lookup table, see block.c
+    UniverseKernel_Blocks,
+    /// only the cells around those that changed, or the row kernel when many do, see events.c
+    UniverseKernel_Events,
+    UniverseKernel_Count,
+} UniverseKernel;
+
+static const char* UNIVERSE_KERNEL_NAMES[] = {
+    [UniverseKernel_Rows] = "row",
+    [UniverseKernel_Blocks] = "2x2 block lookup",
+    [UniverseKernel_Events] = "changed cells",
+};
+
+static const char* UNIVERSE_EDGE_NAMES[] = {
+    [UniverseEdge_Dead] = "dead",
+    [UniverseEdge_Wrap] = "wrap around",
+};
+
+/// What a generation looks like and how it came about, counted while stepping.
+typedef struct UniverseStats {
+    uint64_t population;
+    // cells that came alive and died in the step to this generation
+    uint64_t births;
+    uint64_t deaths;
+    // the live cells lie within [min_x, max_x] x [min_y, max_y], if there are any
+    size_t min_x, max_x, min_y, max_y;
+} UniverseStats;
+
 typedef struct Universe {
+    UniverseBackend backend;
+    UniverseEdge edge;
+    // UniverseBackend_Bytes, NULL otherwise. (width + 2) * (height + 2) cells including the halo
     Cell* cells;
-    Cell* cells_copy;
+    Cell* cells_next;
+    // UniverseBackend_Packed, empty otherwise
+    PackedGrid packed;
     size_t width, height, size;
+    // the cells allocated, which `universe_resize` grows the width and height into in place
+    size_t capacity_width, capacity_height;
+    // distance between two rows of `cells`
+    size_t stride;
+    UniverseKernel kernel;
+    // the row kernel of the byte backend
+    SimdLevel simd;
+    // UniverseKernel_Blocks, compiled on the first step with it
+    BlockTable* blocks;
+    // UniverseKernel_Events, allocated on the first step with it
+    EventKernel* events;
+    GolRule rule;
+    // worker threads for universe_update_cells, NULL when single threaded
+    GolPool* pool;
+    // generations of the pass being stepped, see `universe_update_generations`
+    size_t pass_generations;
+    // the bit-packed grid lives in a file mapping, see mapped.c: it is always stepped a tile at a
+    // time like `pass_generations` > 1, which leaves the halo alone, and every tile is handed to
+    // `release` once it is stepped and scanned, with the universe as the context
+    bool streaming;
+    GolPoolJob release;
+    // update `hash` while stepping, it has to be set with `universe_hash` before
+    bool hashing;
+    uint64_t hash;
+    // count `stats` while stepping
+    bool counting;
+    // `stats` are those of the cells, anything but stepping clears it
+    bool counted;
+    UniverseStats stats;
+    // what the bands of a step add to `hash` and `stats`
+    _Atomic uint64_t hash_changes;
+    _Atomic uint64_t band_population, band_births, band_deaths;
+    _Atomic size_t band_min_x, band_max_x, band_min_y, band_max_y;
 } Universe;
 
+/// pointer to the first cell of row `Y` in a padded byte buffer
+#define UNIVERSE_ROW(U, BUF, Y) ((BUF) + ((Y) + 1) * (U)->stride + 1)
+
+static inline size_t universe_threads(const Universe* uvs) {
+    return uvs->pool ? uvs->pool->thread_count : 1;
+}
+
+/// The cells changed other than by stepping or `universe_set`, so the statistics and the
+/// counts of the event kernel are no longer theirs.
+static inline void universe_changed(Universe* uvs) {
+    uvs->counted = false;
+    if (uvs->events) uvs->events->active = false;
+}
+
+/// Allocate both padded byte buffers for the capacity.
+static void universe_alloc_bytes(Universe* uvs) {
+    uvs->stride = uvs->capacity_width + 2;
+
+    size_t padded_size = uvs->stride * (uvs->capacity_height + 2);
+    uvs->cells = (Cell*)calloc(padded_size, sizeof(Cell));
+    uvs->cells_next = (Cell*)calloc(padded_size, sizeof(Cell));
+
+    if (!(uvs->cells) || !(uvs->cells_next)) {
+        panic("Allocation of the universe cells failed");
+    }
+}
+
 Universe universe_new(size_t init_width, size_t init_height) {
-    Universe uvs;
+    Universe uvs = {0};
+    uvs.backend = UniverseBackend_Bytes;
+    uvs.edge = UniverseEdge_Dead;
+    uvs.simd = simd_detect();
+    // without SIMD the lookup table beats counting the neighbours of every cell
+    uvs.kernel = (uvs.simd == SimdLevel_Scalar) ? UniverseKernel_Blocks : UniverseKernel_Rows;
+    uvs.rule = rule_conway();
+    uvs.counting = true;
     uvs.width = init_width;
     uvs.height = init_height;
     uvs.size = uvs.width * uvs.height;
-    uvs.cells = (Cell*)calloc(uvs.size, sizeof(Cell));
-    uvs.cells_copy = (Cell*)calloc(uvs.size, sizeof(Cell));
-
-    if (!(uvs.cells) || !(uvs.cells_copy)) {
-        panic("Initial allocation of universe_new failed");
-    }
+    uvs.capacity_width = uvs.width;
+    uvs.capacity_height = uvs.height;
+    universe_alloc_bytes(&uvs);
 
     return uvs;
 }
 
 void universe_deinit(Universe* uvs) {
     free(uvs->cells);
-    free(uvs->cells_copy);
+    free(uvs->cells_next);
+    packed_deinit(&(uvs->packed));
+    free(uvs->blocks);
+    uvs->blocks = NULL;
+    events_free(uvs->events);
+    uvs->events = NULL;
+    gol_pool_free(uvs->pool);
+    uvs->pool = NULL;
+}
+
+/// Convert the cells to another storage backend, keeping their state.
+void universe_set_backend(Universe* uvs, UniverseBackend backend) {
+    if (backend == uvs->backend) return;
+    universe_changed(uvs);
+
+    switch (backend) {
+    case UniverseBackend_Packed: {
+        uvs->packed = packed_new_capacity(uvs->width, uvs->height, uvs->capacity_width, uvs->capacity_height);
+        packed_load_bytes(&(uvs->packed), UNIVERSE_ROW(uvs, uvs->cells, 0), uvs->stride);
+
+        free(uvs->cells);
+        free(uvs->cells_next);
+        uvs->cells = uvs->cells_next = NULL;
+    } break;
+    case UniverseBackend_Bytes: {
+        universe_alloc_bytes(uvs);
+        packed_store_bytes(&(uvs->packed), UNIVERSE_ROW(uvs, uvs->cells, 0), uvs->stride);
+        packed_deinit(&(uvs->packed));
+    } break;
+    }
+    uvs->backend = backend;
 }
 
 void universe_set(Universe* uvs, size_t x, size_t y, Cell to) {
-    uvs->cells[min(y, uvs->height - 1) * uvs->width + min(x, uvs->width - 1)] = to;
+    x = min(x, uvs->width - 1);
+    y = min(y, uvs->height - 1);
+    uvs->counted = false;
+
+    switch (uvs->backend) {
+    case UniverseBackend_Bytes: {
+        Cell* cell = UNIVERSE_ROW(uvs, uvs->cells, y) + x;
+        if (*cell == to) break;
+        // the event kernel keeps counting, and steps the cells around it next
+        if (uvs->events && uvs->events->active) {
+            events_flip(uvs->events, UNIVERSE_ROW(uvs, uvs->cells, 0), uvs->stride, (uint32_t)(y * uvs->width + x));
+            events_settle(uvs->events);
+        }
+        else *cell = to;
+    } break;
+    case UniverseBackend_Packed: packed_set(&(uvs->packed), x, y, to); break;
+    }
 }
 
 Cell universe_get(Universe* uvs, size_t x, size_t y) {
-    return uvs->cells[y * uvs->width + x];
+    switch (uvs->backend) {
+    case UniverseBackend_Packed: return packed_get(&(uvs->packed), x, y);
+    default: return UNIVERSE_ROW(uvs, uvs->cells, y)[x];
+    }
 }
 
 void universe_fill(Universe* uvs, Cell with) {
-    memset(uvs->cells, with, uvs->size);
+    universe_changed(uvs);
+    switch (uvs->backend) {
+    // the halo is refilled before every step, so it can be overwritten too
+    case UniverseBackend_Bytes: memset(uvs->cells, with, uvs->stride * (uvs->height + 2)); break;
+    case UniverseBackend_Packed: packed_fill(&(uvs->packed), with); break;
+    }
 }
 
 void universe_invert(Universe* uvs) {
-    for (size_t i = 0; i < uvs->size; i++) uvs->cells[i] = !(uvs->cells[i]);
+    universe_changed(uvs);
+    switch (uvs->backend) {
+    case UniverseBackend_Bytes: {
+        for (size_t i = 0; i < uvs->stride * (uvs->height + 2); i++) uvs->cells[i] = !(uvs->cells[i]);
+    } break;
+    case UniverseBackend_Packed: packed_invert(&(uvs->packed)); break;
+    }
 }
 
-void universe_fill_random(Universe* uvs) {
-    for (size_t i = 0; i < uvs->size; i++) {
-        int n = GetRandomValue(0, INT_MAX);
-        uvs->cells[i] = n % 3 == 0 || n % 7 == 0;
+/// Fill the universe with a random soup, each cell alive with a probability of `density`.
+/// The soup only depends on `seed`, `density` and the size, not on the backend.
+void universe_fill_random(Universe* uvs, uint64_t seed, float density) {
+    GolRng rng = rng_new(seed);
+    const uint32_t steps = rng_density(density);
+    universe_changed(uvs);
+
+    for (size_t y = 0; y < uvs->height; y++) {
+        switch (uvs->backend) {
+        case UniverseBackend_Bytes: {
+            Cell* row = UNIVERSE_ROW(uvs, uvs->cells, y);
+            for (size_t x = 0; x < uvs->width; x += 64) {
+                uint64_t cells = rng_cells(&rng, steps);
+                size_t n = min(uvs->width - x, 64);
+                for (size_t i = 0; i < n; i++) row[x + i] = (cells >> i) & 1;
+            }
+        } break;
+        case UniverseBackend_Packed: {
+            PackedGrid* g = &(uvs->packed);
+            uint64_t* row = PACKED_ROW(g, g->words, y);
+            for (size_t i = 0; i < g->row_words; i++) row[i] = rng_cells(&rng, steps);
+            row[g->row_words - 1] &= g->tail_mask;
+        } break;
+        }
     }
 }
 
+/// Room for `needed`, with half again as much so that a growing window reallocates rarely.
+static inline size_t universe_grow_capacity(size_t capacity, size_t needed) {
+    return (needed <= capacity) ? capacity : max(needed, capacity + capacity / 2);
+}
+
+/// Grow the universe to at least `new_width` x `new_height`, rounded up to whole multiples of
+/// GOL_SCALE. It never shrinks and the cells stay anchored at the top left corner, so every cell
+/// stays where it is on screen. Within the capacity only the cells coming into view are cleared,
+/// past it the capacity grows geometrically and the rows are copied once.
 void universe_resize(Universe* uvs, size_t new_width, size_t new_height) {
-    if (new_width <= uvs->width && new_height <= uvs->height)
+    new_width = max(uvs->width, (new_width + GOL_SCALE - 1) / GOL_SCALE * GOL_SCALE);
+    new_height = max(uvs->height, (new_height + GOL_SCALE - 1) / GOL_SCALE * GOL_SCALE);
+    if (new_width == uvs->width && new_height == uvs->height) return;
+    universe_changed(uvs);
+
+    bool fits = new_width <= uvs->capacity_width && new_height <= uvs->capacity_height;
+    size_t capacity_width = universe_grow_capacity(uvs->capacity_width, new_width);
+    size_t capacity_height = universe_grow_capacity(uvs->capacity_height, new_height);
+
+    switch (uvs->backend) {
+    case UniverseBackend_Packed: {
+        packed_resize(&(uvs->packed), new_width, new_height, capacity_width, capacity_height);
+    } break;
+    case UniverseBackend_Bytes: {
+        if (fits) {
+            // the cells past the old width, including the halo cell that was there
+            for (size_t y = 0; y < uvs->height; y++) {
+                memset(UNIVERSE_ROW(uvs, uvs->cells, y) + uvs->width, Dead, new_width - uvs->width);
+            }
+            // the rows below, starting with the old bottom halo
+            memset(UNIVERSE_ROW(uvs, uvs->cells, uvs->height) - 1, Dead, (new_height - uvs->height) * uvs->stride);
+            break;
+        }
+
+        Universe to = *uvs;
+        to.capacity_width = capacity_width;
+        to.capacity_height = capacity_height;
+        universe_alloc_bytes(&to);
+
+        for (size_t y = 0; y < uvs->height; y++) {
+            memcpy(UNIVERSE_ROW(&to, to.cells, y), UNIVERSE_ROW(uvs, uvs->cells, y), uvs->width);
+        }
+
+        free(uvs->cells);
+        free(uvs->cells_next);
+        *uvs = to;
+    } break;
+    }
+
+    uvs->capacity_width = capacity_width;
+    uvs->capacity_height = capacity_height;
+    uvs->width = new_width;
+    uvs->height = new_height;
+    uvs->size = new_width * new_height;
+}
+
+/// Fill the halo of the front buffer according to the edge mode.
+static void universe_fill_halo(Universe* uvs) {
+    if (uvs->backend == UniverseBackend_Packed) {
+        packed_fill_halo(&(uvs->packed), uvs->edge == UniverseEdge_Wrap);
         return;
+    }
 
-    size_t to_width = (new_width + GOL_SCALE - 1) / GOL_SCALE * GOL_SCALE;
-    size_t to_height = (new_height + GOL_SCALE - 1) / GOL_SCALE * GOL_SCALE;
-    size_t to_size = to_width * to_height;
+    const size_t w = uvs->width, h = uvs->height, stride = uvs->stride;
+    Cell* top = uvs->cells;
+    Cell* bottom = uvs->cells + (h + 1) * stride;
 
-    free(uvs->cells_copy);
-    uvs->cells_copy = (Cell*)calloc(to_size, sizeof(Cell));
-    if (uvs->cells_copy == NULL) {
-        panic("Allocating cells_copy in universe_resize failed.");
+    switch (uvs->edge) {
+    case UniverseEdge_Dead: {
+        memset(top, Dead, stride);
+        memset(bottom, Dead, stride);
+        for (size_t y = 0; y < h; y++) {
+            Cell* row = UNIVERSE_ROW(uvs, uvs->cells, y);
+            row[-1] = Dead;
+            row[w] = Dead;
+        }
+    } break;
+    case UniverseEdge_Wrap: {
+        for (size_t y = 0; y < h; y++) {
+            Cell* row = UNIVERSE_ROW(uvs, uvs->cells, y);
+            row[-1] = row[w - 1];
+            row[w] = row[0];
+        }
+        // whole rows including their halo cells, that also covers the corners
+        memcpy(top, uvs->cells + h * stride, stride);
+        memcpy(bottom, uvs->cells + stride, stride);
+    } break;
     }
+}
 
-    memcpy(uvs->cells_copy, uvs->cells, uvs->size);
+/// Step the rows [y0, y1) of the byte backend from `cells` into `cells_next`.
+/// The halo has to be filled, the row kernels read it like any other cell.
+static void universe_step_rows(Universe* uvs, size_t y0, size_t y1) {
+    const size_t stride = uvs->stride;
 
-    free(uvs->cells);
-    uvs->cells = (Cell*)calloc(to_size, sizeof(Cell));
+    if (uvs->kernel == UniverseKernel_Blocks) {
+        size_t y = y0;
+        for (; y + 2 <= y1; y += 2) {
+            const Cell* b = UNIVERSE_ROW(uvs, uvs->cells, y);
+            Cell* out = UNIVERSE_ROW(uvs, uvs->cells_next, y);
+            block_step_pair(uvs->blocks, b - stride, b, b + stride, b + stride * 2, out, out + stride, uvs->width);
+        }
+        // a band of odd height ends with a single row, the row below the halo must not be read
+        if (y < y1) {
+            const Cell* b = UNIVERSE_ROW(uvs, uvs->cells, y);
+            block_step_pair(
+                uvs->blocks, b - stride, b, b + stride, b + stride,
+                UNIVERSE_ROW(uvs, uvs->cells_next, y), NULL, uvs->width
+            );
+        }
+        return;
+    }
+
+    const GolRowKernel kernel = simd_row_kernel(uvs->simd);
 
-    if (uvs->cells == NULL) {
-        panic("Allocating cells in universe_resize failed.");
+    for (size_t y = y0; y < y1; y++) {
+        const Cell* b = UNIVERSE_ROW(uvs, uvs->cells, y);
+        kernel(&(uvs->rule), b - stride, b, b + stride, UNIVERSE_ROW(uvs, uvs->cells_next, y), uvs->width);
     }
+}
 
-    for (size_t y = 0; y < min(to_height, new_height); y++) {
-        for (size_t x = 0; x < min(to_width, new_width); x++) {
-            uvs->cells[y * uvs->width + x] = uvs->cells_copy[y * to_width + x];
+/// 64 cells of the byte backend as the bits of a word, like the packed backend stores them.
+static inline uint64_t universe_pack_word(const Cell* cells, size_t n) {
+    uint64_t word = 0;
+    if (n == 64) {
+#if defined(GOL_SIMD_X86) && defined(__SSE2__)
+        // the low bit of every byte moved to the top bit, which movemask gathers
+        for (size_t b = 0; b < 64; b += 16) {
+            __m128i bytes = _mm_slli_epi16(_mm_loadu_si128((const __m128i*)(cells + b)), 7);
+            word |= (uint64_t)(uint16_t)_mm_movemask_epi8(bytes) << b;
+        }
+        return word;
+#endif
+        for (size_t b = 0; b < 64; b += 8) {
+            uint64_t bytes;
+            memcpy(&bytes, cells + b, 8);
+            // gathers the low bit of every byte into the top byte
+            word |= ((bytes * UINT64_C(0x0102040810204080)) >> 56) << b;
         }
+        return word;
     }
-    uvs->width = to_width;
-    uvs->height = to_height;
-    uvs->size = to_size;
+    for (size_t b = 0; b < n; b++) word |= (uint64_t)(cells[b]) << b;
+    return word;
 }
 
-void universe_update_cells(Universe* uvs) {
-    memcpy(uvs->cells_copy, uvs->cells, uvs->size);
+/// The bits of a word as `n` cells of the byte backend, the reverse of `universe_pack_word`.
+static inline void universe_unpack_word(Cell* cells, uint64_t word, size_t n) {
+    if (n == 64) {
+        for (size_t b = 0; b < 64; b += 8) {
+            // bit i of the byte into byte i, then every nonzero byte to 1
+            uint64_t bytes = (((word >> b) & 0xFF) * UINT64_C(0x0101010101010101)) & UINT64_C(0x8040201008040201);
+            bytes = ((bytes + UINT64_C(0x7F7F7F7F7F7F7F7F)) >> 7) & UINT64_C(0x0101010101010101);
+            memcpy(cells + b, &bytes, 8);
+        }
+        return;
+    }
+    for (size_t b = 0; b < n; b++) cells[b] = (word >> b) & 1;
+}
+
+/// What word `i` of the cells adds to the hash, nothing when they are all dead.
+/// Like Zobrist hashing, the hash is the XOR of these, so a word that changes
+/// updates it with two keys.
+static inline uint64_t universe_hash_key(uint64_t i, uint64_t word) {
+    if (!word) return 0;
+
+    uint64_t z = word ^ ((i + 1) * UINT64_C(0x9E3779B97F4A7C15));
+    z = (z ^ (z >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+    z = (z ^ (z >> 27)) * UINT64_C(0x94D049BB133111EB);
+    z ^= z >> 31;
+    return z ? z : 1;
+}
+
+/// Word `k` of row `y` of the front buffer, or of the back buffer if `next`.
+/// Rows are cut into words of 64 cells, which are the same for both backends.
+static inline uint64_t universe_word(const Universe* uvs, bool next, size_t y, size_t k) {
+    switch (uvs->backend) {
+    case UniverseBackend_Bytes: {
+        const Cell* row = UNIVERSE_ROW(uvs, next ? uvs->cells_next : uvs->cells, y);
+        return universe_pack_word(row + k * 64, min(uvs->width - k * 64, 64));
+    }
+    case UniverseBackend_Packed: {
+        const PackedGrid* g = &(uvs->packed);
+        uint64_t mask = (k + 1 == g->row_words) ? g->tail_mask : ~UINT64_C(0);
+        return PACKED_ROW(g, next ? g->words_next : g->words, y)[k] & mask;
+    }
+    default: return 0;
+    }
+}
+
+/// A hash of the cells, the same for both backends.
+uint64_t universe_hash(const Universe* uvs) {
+    const size_t row_words = (uvs->width + 63) / 64;
+    uint64_t hash = 0;
 
-    static u8 neighbours;
-    static Cell cell_state;
     for (size_t y = 0; y < uvs->height; y++) {
-        for (size_t x = 0; x < uvs->width; x++) {
-            neighbours = 0;
-            cell_state = universe_get(uvs, x, y);
-
-            for (i8 dx = -1; dx <= 1; dx++) {
-                for (i8 dy = -1; dy <= 1; dy++) {
-                    if (dx == 0 && dy == 0) continue;
-
-                    int nx = x + dx;
-                    int ny = y + dy;
-
-                    if (
-                        nx >= 0 &&
-                        nx < (int)uvs->width &&
-                        ny >= 0 &&
-                        ny < (int)uvs->height &&
-                        universe_get(uvs, nx, ny)
-                        ) neighbours += 1;
+        for (size_t k = 0; k < row_words; k++) hash ^= universe_hash_key(y * row_words + k, universe_word(uvs, false, y, k));
+    }
+    return hash;
+}
+
+static inline void universe_atomic_min(_Atomic size_t* to, size_t value) {
+    size_t old = atomic_load_explicit(to, memory_order_relaxed);
+    while (value < old && !atomic_compare_exchange_weak_explicit(to, &old, value, memory_order_relaxed, memory_order_relaxed)) {}
+}
+
+static inline void universe_atomic_max(_Atomic size_t* to, size_t value) {
+    size_t old = atomic_load_explicit(to, memory_order_relaxed);
+    while (value > old && !atomic_compare_exchange_weak_explicit(to, &old, value, memory_order_relaxed, memory_order_relaxed)) {}
+}
+
+/// Compare rows [y0, y1) of the back buffer, just stepped, with the front buffer: add what
+/// they change in the hash to `hash`, and what they count to `stats`. A word at a time, with popcounts.
+static void universe_scan_rows(const Universe* uvs, size_t y0, size_t y1, uint64_t* hash, UniverseStats* stats) {
+    const size_t row_words = (uvs->width + 63) / 64;
+    const bool hashing = uvs->hashing;
+    const uint64_t tail_mask = (uvs->width % 64) ? (UINT64_C(1) << (uvs->width % 64)) - 1 : ~UINT64_C(0);
+
+    for (size_t y = y0; y < y1; y++) {
+        const uint64_t* packed_before = NULL;
+        const uint64_t* packed_after = NULL;
+        if (uvs->backend == UniverseBackend_Packed) {
+            packed_before = PACKED_ROW(&(uvs->packed), uvs->packed.words, y);
+            packed_after = PACKED_ROW(&(uvs->packed), uvs->packed.words_next, y);
+        }
+        // the first and last words with live cells
+        size_t first = SIZE_MAX, last = 0;
+        uint64_t first_word = 0, last_word = 0;
+
+        for (size_t k = 0; k < row_words; k++) {
+            uint64_t before, after;
+            if (packed_after) {
+                before = packed_before[k];
+                after = packed_after[k];
+            }
+            else {
+                before = universe_word(uvs, false, y, k);
+                after = universe_word(uvs, true, y, k);
+            }
+            if (k + 1 == row_words) {
+                before &= tail_mask;
+                after &= tail_mask;
+            }
+            uint64_t changed = before ^ after;
+
+            if (hashing && changed) {
+                *hash ^= universe_hash_key(y * row_words + k, before) ^ universe_hash_key(y * row_words + k, after);
+            }
+            stats->population += (uint64_t)__builtin_popcountll(after);
+            stats->births += (uint64_t)__builtin_popcountll(after & changed);
+            stats->deaths += (uint64_t)__builtin_popcountll(before & changed);
+            if (after) {
+                if (first == SIZE_MAX) {
+                    first = k;
+                    first_word = after;
                 }
+                last = k;
+                last_word = after;
             }
-            uvs->cells_copy[y * uvs->width + x] = cell_next_iteration(cell_state, neighbours);
         }
+
+        if (first != SIZE_MAX) {
+            stats->min_x = min(stats->min_x, first * 64 + (size_t)__builtin_ctzll(first_word));
+            stats->max_x = max(stats->max_x, last * 64 + 63 - (size_t)__builtin_clzll(last_word));
+            stats->min_y = min(stats->min_y, y);
+            stats->max_y = y;
+        }
+    }
+}
+
+/// GolPoolJob that steps a band of rows with the active backend.
+static void universe_step_band(void* ctx, size_t y0, size_t y1) {
+    Universe* uvs = (Universe*)ctx;
+
+    const bool scanning = uvs->hashing || uvs->counting;
+    uint64_t hash = 0;
+    UniverseStats stats = { .min_x = SIZE_MAX, .min_y = SIZE_MAX };
+
+    if (uvs->pass_generations > 1 || uvs->streaming) {
+        // a tile at a time, which is scanned while it is still in the cache
+        const size_t k = uvs->pass_generations;
+        const size_t tile = min(packed_tile_rows(&(uvs->packed), k), y1 - y0);
+        uint64_t* scratch = packed_tile_alloc(&(uvs->packed), tile, k);
+        // packed_tile_alloc panicked, the back buffer misses this band and isn't swapped in
+        if (!scratch) return;
+
+        for (size_t y = y0, end; y < y1; y = end) {
+            end = min(y + tile, y1);
+            packed_step_blocked(&(uvs->packed), &(uvs->rule), uvs->edge == UniverseEdge_Wrap, k, y, end, scratch);
+            if (scanning) universe_scan_rows(uvs, y, end, &hash, &stats);
+            if (uvs->release) uvs->release(uvs, y, end);
+        }
+        free(scratch);
     }
-    memcpy(uvs->cells, uvs->cells_copy, uvs->size);
+    // scanned a slice at a time, while the rows are still in the cache
+    else for (size_t y = y0, end; y < y1; y = end) {
+        end = scanning ? min(y + UNIVERSE_SCAN_ROWS, y1) : y1;
+
+        switch (uvs->backend) {
+        case UniverseBackend_Bytes: universe_step_rows(uvs, y, end); break;
+        case UniverseBackend_Packed: packed_step_rows(&(uvs->packed), &(uvs->rule), y, end); break;
+        }
+        if (scanning) universe_scan_rows(uvs, y, end, &hash, &stats);
+    }
+
+    if (uvs->hashing) atomic_fetch_xor_explicit(&(uvs->hash_changes), hash, memory_order_relaxed);
+    if (uvs->counting) {
+        atomic_fetch_add_explicit(&(uvs->band_population), stats.population, memory_order_relaxed);
+        atomic_fetch_add_explicit(&(uvs->band_births), stats.births, memory_order_relaxed);
+        atomic_fetch_add_explicit(&(uvs->band_deaths), stats.deaths, memory_order_relaxed);
+        if (stats.population) {
+            universe_atomic_min(&(uvs->band_min_x), stats.min_x);
+            universe_atomic_max(&(uvs->band_max_x), stats.max_x);
+            universe_atomic_min(&(uvs->band_min_y), stats.min_y);
+            universe_atomic_max(&(uvs->band_max_y), stats.max_y);
+        }
+    }
+}
+
+/// Set the number of threads `universe_update_cells` splits the grid over.
+/// The worker threads persist until the count changes or the universe is deinitialized.
+void universe_set_threads(Universe* uvs, size_t threads) {
+    if (threads == universe_threads(uvs)) return;
+
+    gol_pool_free(uvs->pool);
+    uvs->pool = (threads > 1) ? gol_pool_new(threads) : NULL;
+}
+
+/// Step every band from the front into the back buffer, and swap them.
+static void universe_run_bands(Universe* uvs) {
+    if (uvs->counting) {
+        atomic_store_explicit(&(uvs->band_population), 0, memory_order_relaxed);
+        atomic_store_explicit(&(uvs->band_births), 0, memory_order_relaxed);
+        atomic_store_explicit(&(uvs->band_deaths), 0, memory_order_relaxed);
+        atomic_store_explicit(&(uvs->band_min_x), SIZE_MAX, memory_order_relaxed);
+        atomic_store_explicit(&(uvs->band_max_x), 0, memory_order_relaxed);
+        atomic_store_explicit(&(uvs->band_min_y), SIZE_MAX, memory_order_relaxed);
+        atomic_store_explicit(&(uvs->band_max_y), 0, memory_order_relaxed);
+    }
+
+    if (uvs->pool) {
+        gol_pool_run(uvs->pool, universe_step_band, uvs, uvs->height);
+    }
+    else {
+        universe_step_band(uvs, 0, uvs->height);
+    }
+    // a band that couldn't be stepped left the back buffer incomplete, the front one stays
+    if (paniced) return;
+    if (uvs->hashing) uvs->hash ^= atomic_exchange_explicit(&(uvs->hash_changes), 0, memory_order_relaxed);
+    if (uvs->counting) {
+        uvs->stats = (UniverseStats){
+            .population = atomic_load_explicit(&(uvs->band_population), memory_order_relaxed),
+            .births = atomic_load_explicit(&(uvs->band_births), memory_order_relaxed),
+            .deaths = atomic_load_explicit(&(uvs->band_deaths), memory_order_relaxed),
+            .min_x = atomic_load_explicit(&(uvs->band_min_x), memory_order_relaxed),
+            .max_x = atomic_load_explicit(&(uvs->band_max_x), memory_order_relaxed),
+            .min_y = atomic_load_explicit(&(uvs->band_min_y), memory_order_relaxed),
+            .max_y = atomic_load_explicit(&(uvs->band_max_y), memory_order_relaxed),
+        };
+        uvs->counted = true;
+    }
+    else uvs->counted = false;
+
+    switch (uvs->backend) {
+    case UniverseBackend_Bytes: {
+        Cell* front = uvs->cells_next;
+        uvs->cells_next = uvs->cells;
+        uvs->cells = front;
+    } break;
+    case UniverseBackend_Packed: packed_swap(&(uvs->packed)); break;
+    }
+}
+
+/// Step with the event kernel while it tracks the cells, false when the dense kernel has to.
+static bool universe_step_events(Universe* uvs) {
+    if (!(uvs->events)) uvs->events = events_alloc();
+    EventKernel* ek = uvs->events;
+    if (!ek) return false;
+    if (ek->wrap != (uvs->edge == UniverseEdge_Wrap)) ek->active = false;
+    // only the cells around the last changes are looked at, a new rule needs a dense step
+    if (ek->birth != uvs->rule.birth || ek->survive != uvs->rule.survive) ek->active = false;
+    if (!(ek->active)) return false;
+
+    Cell* cells = UNIVERSE_ROW(uvs, uvs->cells, 0);
+    const size_t row_words = (uvs->width + 63) / 64;
+    events_find_flips(ek, cells, uvs->stride, &(uvs->rule));
+
+    for (size_t f = 0; f < ek->flips.len; f++) {
+        const uint32_t i = ek->flips.items[f];
+        // the flips of a word one after another, which adds up to its change
+        if (uvs->hashing) {
+            const size_t x = i % uvs->width, y = i / uvs->width;
+            uint64_t before = universe_word(uvs, false, y, x / 64);
+            uint64_t after = before ^ (UINT64_C(1) << (x % 64));
+            uvs->hash ^= universe_hash_key(y * row_words + x / 64, before) ^ universe_hash_key(y * row_words + x / 64, after);
+        }
+        events_flip(ek, cells, uvs->stride, i);
+    }
+    events_settle(ek);
+
+    uvs->stats = (UniverseStats){
+        .population = ek->population,
+        .births = ek->births,
+        .deaths = ek->deaths,
+        .min_x = ek->min_x,
+        .max_x = ek->max_x,
+        .min_y = ek->min_y,
+        .max_y = ek->max_y,
+    };
+    uvs->counted = true;
+
+    // too busy, the next generation steps dense
+    if (ek->changed.len > uvs->size / EVENTS_DENSE_RATIO) ek->active = false;
+    return true;
+}
+
+/// After a dense step with the event kernel selected, start tracking the cells again once few
+/// of them change. Only at half the activity it stops at, so that it doesn't flap.
+static void universe_resume_events(Universe* uvs) {
+    EventKernel* ek = uvs->events;
+    if (!ek) return;
+    const size_t max_changed = uvs->size / (EVENTS_DENSE_RATIO * 2);
+
+    // the statistics tell for free, without them the generations are compared every so often
+    if (uvs->counting) {
+        if (uvs->stats.births + uvs->stats.deaths > max_changed) return;
+    }
+    else if ((ek->dense_steps)++ % EVENTS_PROBE_INTERVAL != 0) return;
+
+    universe_fill_halo(uvs);
+    events_start(
+        ek, UNIVERSE_ROW(uvs, uvs->cells, 0), UNIVERSE_ROW(uvs, uvs->cells_next, 0), uvs->stride,
+        uvs->width, uvs->height, uvs->edge == UniverseEdge_Wrap, &(uvs->rule), max_changed
+    );
+}
+
+void universe_update_cells(Universe* uvs) {
+    const bool events = uvs->backend == UniverseBackend_Bytes && uvs->kernel == UniverseKernel_Events;
+    if (events && universe_step_events(uvs)) return;
+    // the dense kernels don't keep the counts
+    if (!events && uvs->events) uvs->events->active = false;
+
+    universe_fill_halo(uvs);
+
+    if (uvs->backend == UniverseBackend_Bytes && uvs->kernel == UniverseKernel_Blocks) {
+        uvs->blocks = block_table_for(uvs->blocks, &(uvs->rule));
+    }
+    universe_run_bands(uvs);
+
+    if (events) universe_resume_events(uvs);
+}
+
+/// Step `k` generations. The bit-packed backend steps them in one pass with temporal
+/// blocking, see `packed_step_blocked`, the byte backend one generation at a time.
+/// The hash and statistics compare the first generation with the last, so births and
+/// deaths are those of all `k` together. A streaming universe has to be stepped with this.
+void universe_update_generations(Universe* uvs, size_t k) {
+    if (uvs->backend != UniverseBackend_Packed || (k <= 1 && !(uvs->streaming))) {
+        for (size_t i = 0; i < k; i++) universe_update_cells(uvs);
+        return;
+    }
+
+    uvs->pass_generations = max(k, 1);
+    universe_run_bands(uvs);
+    uvs->pass_generations = 1;
 }
 
 #undef Cell
-#endif
\ No newline at end of file
+#endif
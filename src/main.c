@@ -16,6 +16,8 @@
 #include <string.h>
 
 #include "ui/selector.c"
+#include "gol/bench.c"
+#include "gol/soup.c"
 #include "ui/windowicon.c"
 #include "ui/splashtext.c"
 
@@ -82,7 +84,14 @@ void sigint_handler(int) {
     exit(0);
 }
 
-int main(void) {
+int main(int argc, char** argv) {
+    // benchmark the Game of Life kernel without a window
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0) return gol_bench(argc - 2, argv + 2);
+    // step the file-backed Game of Life world without a window
+    if (argc > 1 && strcmp(argv[1], "--world") == 0) return mapped_run(argc - 2, argv + 2);
+    // search random Game of Life soups without a window
+    if (argc > 1 && strcmp(argv[1], "--soup") == 0) return soup_search(argc - 2, argv + 2);
+
     // seed random
     SetRandomSeed(time(NULL));
 